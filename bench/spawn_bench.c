@@ -0,0 +1,163 @@
+/**
+ * @file spawn_bench.c
+ * @author Daniel Calabria
+ *
+ * Measures how long the server's main loop is held up starting a job, with
+ * fork() and with spawn(), as the heap of the server grows. Each sample is the
+ * time from starting a child which execs /bin/true until the caller may go on,
+ * and the median of each set of samples is reported.
+ *
+ * Usage: spawn_bench [-n samples] [heap MiB ...]
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "common.h"
+#include "spawn.h"
+
+#define BENCH_TRUE      "/bin/true"
+#define BENCH_SAMPLES   200
+
+volatile sig_atomic_t debug_enabled = 0;
+
+/**
+ * int bench_child(void *)
+ *
+ * @brief  What each child runs: exec /bin/true.
+ **/
+static int bench_child(void *arg)
+{
+    char *argv[] = { "true", NULL };
+
+    execv(BENCH_TRUE, argv);
+    _exit(127);
+}
+
+/**
+ * pid_t bench_fork()
+ *
+ * @brief  Starts a child the way the server used to, with fork().
+ **/
+static pid_t bench_fork()
+{
+    pid_t pid = fork();
+    if(pid == 0)
+        bench_child(NULL);
+
+    return pid;
+}
+
+/**
+ * int bench_cmp(const void *, const void *)
+ *
+ * @brief  qsort() comparator for samples.
+ **/
+static int bench_cmp(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+/**
+ * double bench_run(int, int)
+ *
+ * @brief  Starts n children, one at a time.
+ *
+ * @param use_spawn  1 to start them with spawn(), 0 with fork()
+ * @param n  The number of children
+ *
+ * @return  The median time, in microseconds, until the caller could go on.
+ **/
+static double bench_run(int use_spawn, int n)
+{
+    double *samples = NULL;
+    MALLOC(samples, sizeof(double) * n);
+
+    for(int i = 0; i < n; i++)
+    {
+        struct timespec t0, t1;
+
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        pid_t pid = (use_spawn ? spawn(bench_child, NULL, 0) : bench_fork());
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+
+        if(pid < 0)
+            PERROR_EXIT("spawn()");
+        waitpid(pid, NULL, 0);
+
+        samples[i] = (t1.tv_sec - t0.tv_sec) * 1e6 +
+                     (t1.tv_nsec - t0.tv_nsec) / 1e3;
+    }
+
+    qsort(samples, n, sizeof(double), bench_cmp);
+    double retval = samples[n / 2];
+    FREE(samples);
+    return retval;
+}
+
+int main(int argc, char *argv[])
+{
+    int n = BENCH_SAMPLES;
+    long defaults[] = { 0, 64, 256, 1024 };
+    long *sizes = defaults;
+    int nsizes = sizeof(defaults) / sizeof(defaults[0]);
+    int opt;
+
+    while((opt = getopt(argc, argv, "n:h")) != -1)
+    {
+        switch(opt)
+        {
+            case 'n':
+                n = atoi(optarg);
+                break;
+
+            default:
+                printf("Usage: %s [-n samples] [heap MiB ...]\n", argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+
+    if(n < 1)
+        n = 1;
+    if(optind < argc)
+    {
+        nsizes = argc - optind;
+        MALLOC(sizes, sizeof(long) * nsizes);
+        for(int i = 0; i < nsizes; i++)
+            sizes[i] = atol(argv[optind + i]);
+    }
+
+    printf("%10s %14s %14s\n", "heap MiB", "fork() usec", "spawn() usec");
+
+    /* touch every page, as the server does with its job records */
+    char *heap = NULL;
+    for(int i = 0; i < nsizes; i++)
+    {
+        size_t size = (size_t)sizes[i] * 1024 * 1024;
+        if(size > 0)
+        {
+            char *h = realloc(heap, size);
+            if(!h)
+                PERROR_EXIT("realloc()");
+            heap = h;
+            memset(heap, i + 1, size);
+        }
+
+        printf("%10ld %14.1f %14.1f\n", sizes[i], bench_run(0, n),
+                bench_run(1, n));
+        fflush(stdout);
+    }
+
+    free(heap);
+    if(sizes != defaults)
+        FREE(sizes);
+    spawn_free();
+    return 0;
+}
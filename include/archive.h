@@ -0,0 +1,77 @@
+/**
+ * @file archive.h
+ * @author Daniel Calabria
+ *
+ * Header file for archive.c
+ *
+ * Once a job has EXITED or been ABORTED, the server no longer needs most of
+ * what a job_t holds. The archive keeps just enough about each finished job to
+ * answer JOB_STATUS, JOB_LIST_ALL, JOB_GET_STDOUT, JOB_GET_STDERR and
+ * JOB_GET_LINES requests, stored as a struct of arrays kept sorted by jobid.
+ **/
+
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <stdint.h>
+#include <time.h>
+#include <sys/time.h>
+
+typedef struct job_s job_t;
+typedef struct status_s status_t;
+
+/* Finished jobs belonging to a single client */
+typedef struct archive_s
+{
+    uint32_t count;
+    uint32_t cap;
+
+    uint32_t *jobid;
+    uint8_t *status;
+    int32_t *exitcode;
+    uint32_t *maxcpu;
+    uint32_t *maxmem;
+    int32_t *priority;
+
+    struct timeval *utime;  /* from the rusage collected when reaped */
+    struct timeval *stime;
+    long *maxrss;
+
+    struct timeval *stamp;  /* time of submission, names the output files */
+    uint32_t *cmdoff;       /* offset of the command line within pool */
+    struct output_s **output;/* captured output, see output.c, or NULL */
+    struct lineidx_s **lines;/* line indexes of stdout and stderr, see
+                             * lines.c, or NULL until lines are asked for */
+    struct search_s *search;/* index over the output of all of them, see
+                             * search.c, or NULL */
+    uint8_t *indexed;       /* bit k set once stream k is in the index */
+
+    time_t *finished;       /* when the job was archived */
+    uint64_t *bytes;        /* size of the job's output files, and output
+                             * kept in memory */
+    uint64_t totalbytes;    /* sum of bytes[] */
+    uint32_t gcpos;         /* where the collector's age scan resumes */
+    uint32_t *order;        /* jobids in the order they were archived, a
+                             * ring which may still hold removed ones */
+    uint32_t orderhead;
+    uint32_t orderlen;
+    uint32_t ordercap;
+
+    char *pool;             /* command lines, NUL terminated */
+    uint32_t poolused;
+    uint32_t poolcap;
+    uint32_t poolgarbage;   /* bytes of pool belonging to removed entries */
+} archive_t;
+
+/* fxn prototypes for archive.c */
+int archive_insert(archive_t *a, job_t *job);
+int archive_find(archive_t *a, uint32_t jobid);
+int archive_remove(archive_t *a, int idx, const char *owner);
+int archive_remove_range(archive_t *a, int idx, int n, const char *owner);
+int archive_oldest(archive_t *a);
+int archive_oldest_run(archive_t *a, int idx, time_t before, int max);
+void archive_free(archive_t *a, const char *owner);
+const char* archive_cmdline(archive_t *a, int idx);
+void archive_status(archive_t *a, int idx, status_t *s);
+
+#endif // ARCHIVE_H
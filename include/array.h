@@ -0,0 +1,56 @@
+/**
+ * @file array.h
+ * @author Daniel Calabria
+ *
+ * Header file for array.c
+ **/
+
+#ifndef ARRAY_H
+#define ARRAY_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "jobs.h"
+#include "proto.h"
+
+#define ARRAY_ENV       "SMASH_ARRAY_TASK_ID"   /* the index of a task */
+#define ARRAY_MAXTASKS  65536                   /* tasks in one array */
+
+/* A job array: one submission standing for the tasks lo..hi */
+typedef struct array_s
+{
+    uint32_t jobid;         /* jobid of the array, its tasks follow it */
+    uint32_t lo;            /* first index */
+    uint32_t hi;            /* last index */
+    uint32_t cap;           /* tasks alive at once, 0 for no limit */
+
+    job_t *tmpl;            /* limits, command line and environment */
+    uint32_t next;          /* index of the next task to create */
+    uint32_t live;          /* tasks created which have not finished */
+    job_t *pending;         /* the created task which has not started */
+
+    uint32_t succeeded;     /* tasks which exited with status 0 */
+    uint32_t failed;        /* tasks which did not */
+    uint32_t canceled;      /* tasks which will never be created */
+    int stopped;            /* no more tasks get created */
+
+    struct array_s *next_array;
+} array_t;
+
+/* fxn prototypes for array.c */
+array_t* array_create(client_t *c, job_t *tmpl, uint32_t lo, uint32_t hi,
+        uint32_t cap);
+array_t* array_find(client_t *c, uint32_t jobid);
+array_t* array_of_task(client_t *c, uint32_t jobid);
+int array_feed(array_t *a);
+void array_started(job_t *task);
+void array_finished(job_t *task);
+int array_signal(array_t *a, int sig);
+void array_cancel(array_t *a);
+int array_remove(client_t *c, array_t *a);
+void array_free_all(client_t *c);
+void array_status(array_t *a, status_t *s);
+int array_describe(array_t *a, char *buf, size_t size);
+
+#endif // ARRAY_H
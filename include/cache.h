@@ -0,0 +1,36 @@
+/**
+ * @file cache.h
+ * @author Daniel Calabria
+ *
+ * Header file for cache.c
+ **/
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdint.h>
+
+#include "jobs.h"
+
+#define CACHE_ENTRIES   128             /* results kept, least recent go */
+#define CACHE_PREFIX    ".smash_cache_" /* names the kept output files */
+
+/* The kept result of a successful cacheable job */
+typedef struct cache_s
+{
+    uint64_t key;
+    char *blob;                 /* what was hashed, to rule out collisions */
+    uint32_t len;
+    char *outfile;              /* links to the job's output files */
+    char *errfile;
+    struct cache_s *next;       /* most recently used first */
+} cache_t;
+
+/* fxn prototypes for cache.c */
+int cache_prepare(job_t *job, const char *fingerprint);
+int cache_submit(job_t *job);
+void cache_finished(job_t *job);
+void cache_detach(job_t *job);
+void cache_free();
+
+#endif // CACHE_H
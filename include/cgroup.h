@@ -0,0 +1,29 @@
+/**
+ * @file cgroup.h
+ * @author Daniel Calabria
+ *
+ * Header file for cgroup.c
+ **/
+
+#ifndef CGROUP_H
+#define CGROUP_H
+
+#include <time.h>
+
+#include "jobs.h"
+
+#define CGROUP_POLL     1       /* seconds between checks of cpu usage */
+#define CGROUP_PERIOD   100000  /* cpu.max period, in microseconds */
+
+/* fxn prototypes for cgroup.c */
+int cgroup_init(const char *root);
+int cgroup_create(job_t *job);
+int cgroup_enter(job_t *job);
+int cgroup_collect(job_t *job);
+int cgroup_kill(job_t *job);
+void cgroup_destroy(job_t *job);
+int cgroup_poll();
+struct timespec* cgroup_timeout(struct timespec *ts);
+void cgroup_shutdown();
+
+#endif // CGROUP_H
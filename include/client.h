@@ -9,6 +9,8 @@
 #define CLIENT_H
 
 #include "jobs.h"
+#include "archive.h"
+#include "proto.h"
 
 /* Represents a client */
 typedef struct client_s
@@ -20,6 +22,17 @@ typedef struct client_s
     job_t *jobs;
     int numjobs;
 
+    archive_t archive;  /* jobs which have finished */
+    struct array_s *arrays; /* job arrays, see array.c */
+
+    job_t *queue;       /* queued jobs, under the fair-share policy */
+    job_t *queue_tail;
+    double weight;      /* fair-share weight */
+    double usage;       /* decayed cpu seconds used by finished jobs */
+    time_t usage_stamp; /* when usage was last decayed */
+
+    uint8_t *spooldirs; /* bitmap of its spool directories, see spool.c */
+
     struct client_s *next;
 } client_t;
 
@@ -34,5 +47,10 @@ int client_kill(client_t *c, int jobid, int signum);
 int client_expunge(client_t *c, int jobid);
 int client_stdout(client_t *c, int jobid);
 int client_stderr(client_t *c, int jobid);
+int client_lines(client_t *c, int jobid, int stream, uint64_t first,
+        uint64_t count);
+int client_grep(client_t *c, grep_t *req);
+int client_search(client_t *c, query_t *req);
+int client_input(client_t *c, int jobid, char *path);
 
 #endif // CLIENT_H
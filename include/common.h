@@ -64,17 +64,22 @@ extern volatile sig_atomic_t debug_enabled;
 
 #define READ(fd, msg, len) \
 { \
-    int r = 0; \
-    while((r = read((fd), (msg), (len))) < 0) \
+    ssize_t r = 0; \
+    size_t got = 0; \
+    while(got < (size_t)(len)) \
     { \
-        if(errno == EINTR) continue; \
-        if(errno == EBADF) return -1; \
-        PERROR_EXIT("read()"); \
-    } \
-    if(r == 0) \
-    { \
-        perror("read()");\
-        return -1;\
+        if((r = read((fd), (char *)(msg) + got, (len) - got)) < 0) \
+        { \
+            if(errno == EINTR) continue; \
+            if(errno == EBADF) return -1; \
+            PERROR_EXIT("read()"); \
+        } \
+        if(r == 0) \
+        { \
+            perror("read()");\
+            return -1;\
+        } \
+        got += r; \
     } \
 }
 
@@ -15,6 +15,12 @@ typedef struct conn_s
 
     client_t *client;
 
+    /* a JOB_INPUT chunk being forwarded, see feed.c */
+    uint32_t in_left;       /* bytes of it still on the socket */
+    job_t *in_job;          /* the job it is for, NULL if it went away */
+    int in_full;            /* waiting for room in the job's stdin */
+    int in_failed;          /* some of it could not be forwarded */
+
     struct conn_s *next;
 } conn_t;
 
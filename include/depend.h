@@ -0,0 +1,30 @@
+/**
+ * @file depend.h
+ * @author Daniel Calabria
+ *
+ * Header file for depend.c
+ **/
+
+#ifndef DEPEND_H
+#define DEPEND_H
+
+#include "jobs.h"
+#include "proto.h"
+
+/* An edge of the dependency graph: post may not start before pre finishes */
+typedef struct dep_s
+{
+    job_t *pre;
+    job_t *post;
+    uint32_t cond;          /* DEP_AFTEROK or DEP_AFTERANY */
+    struct dep_s *next_out; /* next edge in pre->dependents */
+    struct dep_s *next_in;  /* next edge in post->prereqs */
+} dep_t;
+
+/* fxn prototypes for depend.c */
+int depend_check(client_t *c, dependency_t *deps, uint32_t ndeps);
+int depend_attach(client_t *c, job_t *job, dependency_t *deps, uint32_t ndeps);
+void depend_detach(job_t *job);
+void depend_release(job_t *job);
+
+#endif // DEPEND_H
@@ -0,0 +1,23 @@
+/**
+ * @file feed.h
+ * @author Daniel Calabria
+ *
+ * Header file for feed.c
+ **/
+
+#ifndef FEED_H
+#define FEED_H
+
+#include "jobs.h"
+#include "conn.h"
+#include "proto.h"
+
+/* fxn prototypes for feed.c */
+int feed_open(job_t *job);
+void feed_started(job_t *job);
+void feed_close(job_t *job);
+int feed_begin(conn_t *conn, input_t *in);
+int feed_forward(conn_t *conn);
+int feed_waitfd(conn_t *conn);
+
+#endif // FEED_H
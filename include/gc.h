@@ -0,0 +1,22 @@
+/**
+ * @file gc.h
+ * @author Daniel Calabria
+ *
+ * Header file for gc.c
+ **/
+
+#ifndef GC_H
+#define GC_H
+
+#include <time.h>
+
+#define GC_INTERVAL     1       /* seconds between collector runs */
+#define GC_SLICE_USEC   2000    /* time budget of a single collector run */
+#define GC_BATCH        32      /* entries handled between clock checks */
+
+/* fxn prototypes for gc.c */
+int gc_enabled();
+int gc_run();
+struct timespec* gc_timeout(struct timespec *ts);
+
+#endif // GC_H
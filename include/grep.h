@@ -0,0 +1,19 @@
+/**
+ * @file grep.h
+ * @author Daniel Calabria
+ *
+ * Header file for grep.c
+ **/
+
+#ifndef GREP_H
+#define GREP_H
+
+#include "conn.h"
+#include "proto.h"
+
+#define GREP_MAXRESULTS (16 * 1024 * 1024) /* most bytes of lines sent back */
+
+/* fxn prototypes for grep.c */
+int grep_serve(conn_t *conn, grep_t *req);
+
+#endif // GREP_H
@@ -9,12 +9,16 @@
 #define JOBS_H
 
 #include <stdint.h>
+#include <stddef.h>
+#include <sys/time.h>
 #include <sys/resource.h>
 
 #include "client.h"
 #include "parse.h"
 
 typedef struct client_s client_t;
+typedef struct dep_s dep_t;
+typedef struct array_s array_t;
 
 /* The various states that our jobs can be in */
 #define NEW         0
@@ -23,6 +27,17 @@ typedef struct client_s client_t;
 #define EXITED      3
 #define ABORTED     4
 #define CANCELED    5
+#define BLOCKED     6   /* waiting on other jobs to finish, see depend.c */
+#define ARRAY       7   /* a job array, reported for its jobid, see array.c */
+#define QUOTA       8   /* killed (or never started) for its output size */
+
+/* the job has not started (and may never) */
+#define JOB_PENDING(s)  ((s) == NEW || (s) == BLOCKED)
+
+/* the job is done, for good */
+#define JOB_FINISHED(s) ((s) == EXITED || (s) == ABORTED || (s) == QUOTA)
+
+#define JOBS_PIPE_SIZE  (1024 * 1024)   /* buffer between pipeline stages */
 
 
 /**
@@ -45,21 +60,84 @@ typedef struct job_s
     uint32_t usedcpu;
 
     int32_t priority;
-    
+    uint32_t cores;         /* cpu cores requested at submission */
+    uint32_t walltime;      /* estimated run time, see sched_estimate() */
+    time_t started;         /* when it was started */
+    int admitted;           /* holds its share of the memory/core budgets */
+    int *cpus;              /* cpus it was placed on, see place.c */
+    int node;               /* NUMA node of those cpus, -1 if several */
+    char *cgpath;           /* its cgroup, see cgroup.c */
+
+    uint32_t nwait;         /* unfinished jobs it depends on */
+    dep_t *prereqs;         /* edges to the jobs it depends on */
+    dep_t *dependents;      /* edges to the jobs depending on it */
+
+    array_t *array;         /* the array it is a task of, see array.c */
+
+    char *cacheblob;        /* identifies a cacheable job, see cache.c */
+    uint32_t cachelen;
+    uint64_t cachekey;      /* hash of cacheblob */
+    struct job_s *leader;   /* identical job whose result it waits for */
+    struct job_s *followers;/* identical jobs waiting for its result */
+    struct job_s *fnext;
+
+    uint32_t launchseq;     /* launcher request awaiting its pid, or 0 */
+    int pendsig;            /* signal to send once that pid is known */
+    struct job_s *lnext;    /* next job being launched, see launcher.c */
+
+    int infd;           /* its stdin pipe, until it starts, see feed.c */
+    int inwfd;          /* where the client's data goes, -1 if no pipe */
+
+    uint32_t outmode;   /* where its output goes, see output.h */
+    uint64_t maxout;    /* bytes of output it may write, 0 for no limit */
+    int overquota;      /* it wrote more, and was killed for it */
+    int outfd[2];       /* its stdout/stderr pipes, until it starts */
+    struct output_s *output;/* its captured output, see output.c */
+
+    char *launch;       /* argv + envp (and their strings), in one block */
+    char **argv;        /* each stage's argv, one after the other */
+    uint32_t nstages;   /* commands in its pipeline */
     uint32_t envpc;
     char **envp;
 
+    struct timeval stamp;   /* time of submission, names the output files */
     char *stdoutfile;
     char *stderrfile;
 
+    int queued;             /* on the scheduler's ready queue */
+    struct job_s *qnext;
+    struct job_s *qprev;
+    int heapidx;            /* position in the priority heap */
+    int64_t qkey;           /* heap key, see sched_key() */
+    int preempted;          /* suspended to make room for a more urgent job */
+    struct job_s *pnext;
+    int running;            /* holds one of the maxjobs slots */
+    struct job_s *rnext;    /* running jobs, least urgent first */
+    struct job_s *rprev;
+    struct job_s *enext;    /* running jobs, soonest expected to end first */
+    struct job_s *eprev;
+
     struct job_s *next;
     struct job_s *snext;
 } job_t;
 
+/* What the child of exec_job() is handed, see launch_child() */
+typedef struct launch_s
+{
+    job_t *job;
+    int err;            /* errno of the step which failed, if one did */
+    const char *what;   /* the step which failed */
+    int errfd;          /* where err and what are written, see launch_spawn() */
+} launch_t;
+
 /* fxn prototypes for jobs.c */
 job_t* jobs_create(user_input_t *ui);
+int jobs_build_launch(job_t *job, char **envp, uint32_t envpc);
 int jobs_insert(client_t *, job_t *);
 int jobs_remove(client_t *, job_t *);
+int jobs_archive(client_t *, job_t *);
+int jobs_output_path(char *buf, size_t size, const char *owner,
+        const struct timeval *stamp, const char *ext);
 int jobs_list(client_t *);
 job_t* jobs_lookup_by_jobid(client_t *, int jobid);
 job_t* jobs_lookup_by_pid(job_t *joblist, int pid);
@@ -67,10 +145,15 @@ char* jobs_status_as_char(int);
 void free_jobs(client_t *);
 int free_job(job_t *);
 int exec_job(client_t *, job_t *job);
+int jobs_kill(job_t *job, int sig);
+int jobs_abort(job_t *job, int sig);
 int cancel_all_jobs(client_t *);
 int wait_for_all(client_t *);
 int job_update_status(job_t *job, int status);
+int jobs_notify(job_t *job);
 int print_job(job_t *j);
 int run_in_background(job_t *job, int cont);
+int launch_child(void *arg);
+pid_t launch_spawn(launch_t *l, int flags);
 
 #endif // JOBS_H
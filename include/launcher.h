@@ -0,0 +1,74 @@
+/**
+ * @file launcher.h
+ * @author Daniel Calabria
+ *
+ * Header file for launcher.c
+ **/
+
+#ifndef LAUNCHER_H
+#define LAUNCHER_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/resource.h>
+
+#include "jobs.h"
+
+#define LAUNCHER_MAXMSG (64 * 1024) /* largest request, bigger ones spawn() */
+#define LAUNCHER_WHAT   32          /* room for the name of a failed step */
+#define LAUNCHER_HASH   64          /* buckets of jobs being launched */
+
+/* A request to launch a job, followed by the job's cpus (if it was placed),
+ * then its cgroup (if it has one), output files, argv and envp, each string
+ * nul terminated. The argv of every stage of a pipeline is sent, with an
+ * empty string between two stages. */
+typedef struct lreq_s
+{
+    uint32_t seq;
+    uint32_t maxcpu;
+    uint32_t maxmem;
+    uint64_t maxout;
+    int32_t priority;
+    uint32_t cores;
+    int32_t node;
+    uint32_t argc;              /* counting the empty strings */
+    uint32_t envc;
+    uint32_t flags;
+} lreq_t;
+
+#define LREQ_CPUS       0x1     /* the job's cpus follow */
+#define LREQ_CGROUP     0x2     /* the job's cgroup follows */
+#define LREQ_STDIN      0x4     /* the job's stdin comes with SCM_RIGHTS */
+#define LREQ_CAPTURE    0x8     /* its stdout and stderr pipes come after it */
+#define LREQ_DISCARD    0x10    /* its output goes to /dev/null */
+
+#define LAUNCHER_MAXFDS 3       /* fds which come with a request */
+
+/* The launcher's answer to a request */
+typedef struct lrep_s
+{
+    uint32_t seq;
+    int32_t pid;                /* the job's pid, -errno if none was made */
+    int32_t err;                /* errno of the step which failed */
+    char what[LAUNCHER_WHAT];   /* the step which failed */
+} lrep_t;
+
+/* A wait4() status for a pid the launcher has not reported yet */
+typedef struct lstash_s
+{
+    pid_t pid;
+    int status;
+    struct rusage ru;
+    struct lstash_s *next;
+} lstash_t;
+
+/* fxn prototypes for launcher.c */
+int launcher_init();
+int launcher_socket();
+int launcher_launch(job_t *job);
+int launcher_poll();
+int launcher_reaped(pid_t pid, int status, struct rusage *ru);
+void launcher_drop(job_t *job);
+void launcher_shutdown();
+
+#endif // LAUNCHER_H
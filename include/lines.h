@@ -0,0 +1,31 @@
+/**
+ * @file lines.h
+ * @author Daniel Calabria
+ *
+ * Header file for lines.c
+ **/
+
+#ifndef LINES_H
+#define LINES_H
+
+#include <stdint.h>
+
+#include "conn.h"
+#include "proto.h"
+
+#define LINES_STRIDE    64      /* lines between two marks of an index */
+
+/* Where the lines of one stream of a finished job's output start */
+typedef struct lineidx_s
+{
+    uint64_t size;          /* of the output indexed, 0 if none was built */
+    uint64_t nlines;        /* counting an unterminated last line */
+    uint64_t nmarks;
+    uint64_t *marks;        /* offset of every LINES_STRIDE'th line */
+} lineidx_t;
+
+/* fxn prototypes for lines.c */
+int lines_serve(conn_t *conn, lines_t *req);
+void lines_free(lineidx_t *idx);
+
+#endif // LINES_H
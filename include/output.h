@@ -0,0 +1,64 @@
+/**
+ * @file output.h
+ * @author Daniel Calabria
+ *
+ * Header file for output.c
+ **/
+
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <stdint.h>
+#include <sys/select.h>
+
+#include "jobs.h"
+#include "client.h"
+#include "proto.h"
+
+#define OUTPUT_SPILL    (64 * 1024) /* default bytes kept before spilling */
+#define OUTPUT_BURST    (1024 * 1024) /* most read from a pipe in one go */
+
+/* One of a captured job's streams */
+typedef struct outbuf_s
+{
+    int fd;                 /* read end of its pipe, -1 once closed */
+    int filefd;             /* its output file while spilling into it */
+    int spilled;            /* its output is in its file, not in data */
+    int discard;            /* it failed to spill, the rest of it is dropped */
+    char *data;
+    uint32_t len;
+    uint32_t cap;
+} outbuf_t;
+
+/* What the server collected of a job's output. Once the job is archived, the
+ * archive holds on to it (without the job). */
+typedef struct output_s
+{
+    job_t *job;             /* NULL once archived */
+    outbuf_t buf[2];        /* stdout, stderr */
+    uint64_t written;       /* by the job, counted against its maxout */
+    struct output_s *next;  /* the outputs still being collected */
+} output_t;
+
+/* One stream of a finished job's output, wherever it is kept */
+typedef struct outmap_s
+{
+    const char *data;
+    uint64_t size;
+    void *mapped;           /* the mmap()ed output file, NULL if in memory */
+} outmap_t;
+
+/* fxn prototypes for output.c */
+int output_open(job_t *job);
+void output_started(job_t *job);
+void output_finished(job_t *job);
+void output_close(job_t *job);
+void output_free(output_t *o);
+uint64_t output_bytes(output_t *o);
+int output_fds(fd_set *fds, int nfds);
+void output_poll(fd_set *fds);
+int output_quota(client_t *c);
+int output_map(client_t *c, int idx, int k, outmap_t *m);
+void output_unmap(outmap_t *m);
+
+#endif // OUTPUT_H
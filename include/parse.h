@@ -13,12 +13,23 @@
  * It will contain a list of 2 commands -> `ls -l` and `sort`.
  * Each command will be broken into individual components, separated by
  * whitespace; (`ls -l` -> `ls`, `-l`) and (`sort` -> `sort`).
+ *
+ * The commands form a pipeline: each one's standard output is connected to
+ * the standard input of the next.
+ *
+ * The whole parsed structure lives in a single arena allocation, laid out as:
+ *
+ *   [user_input_t][command_t ...][component_t ...][argv pointers ...]
+ *   [copy of the input][copy split into commands][token bytes]
+ *
+ * so a user_input_t is created with one malloc() and released with one free().
  **/
 
 #ifndef PARSE_H
 #define PARSE_H
 
 #define COMPONENT_DELIMS    "\t\r\n "   /* Delimiters for components */
+#define COMMAND_DELIMS      "|"         /* Delimiters between commands */
 
 /**
  * The component structure is used to maintain a list of individual tokens
@@ -42,6 +53,8 @@ typedef struct command_s
     int out_fd;
 
     component_t *components;    /* each command is composed of 1+ components */
+    int argc;                   /* number of components */
+    char **argv;                /* NULL terminated, points at the components */
     struct command_s *next;     /* next command */
 } command_t;
 
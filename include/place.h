@@ -0,0 +1,27 @@
+/**
+ * @file place.h
+ * @author Daniel Calabria
+ *
+ * Header file for place.c
+ **/
+
+#ifndef PLACE_H
+#define PLACE_H
+
+#include <stddef.h>
+
+#include "jobs.h"
+
+#define PLACE_SYSFS     "/sys/devices/system/node"
+#define PLACE_MAXNODES  1024    /* bits in the node mask for set_mempolicy */
+
+/* fxn prototypes for place.c */
+int place_init();
+int place_acquire(job_t *job);
+void place_release(job_t *job);
+int place_apply(job_t *job);
+int place_move(job_t *job);
+int place_format(job_t *job, char *buf, size_t size);
+void place_free();
+
+#endif // PLACE_H
@@ -20,6 +20,12 @@
  *  JOB_GET_STDERR      - client wants toe standard err of a job
  *  JOB_LIST_ALL        - client wants a list of all their jobs (+ status)
  *  JOB_EXPUNGE         - client wants to remove a job from their joblist
+ *  JOB_INPUT           - client sends data for the stdin of a job
+ *  JOB_GET_LINES       - client wants some lines of the output of a job
+ *  JOB_GREP            - client wants the lines of a job's output matching
+ *                        a pattern
+ *  JOB_SEARCH          - client wants to know which of its jobs' output
+ *                        contains a string
  *
  * SERVER specific:
  *  JOB_UPDATE          - sent by server to client when status a job changes
@@ -50,6 +56,37 @@
 #define JOB_LIST_ALL_RESP   15 /* response packet for a listing of all client jobs */
 #define JOB_RESULTS         16 /* results packet containing output of a job */
 
+/* CLIENT specific, added later */
+#define JOB_INPUT           17 /* data for the stdin of a job */
+#define JOB_GET_LINES       18 /* retrieve a range of LINES of a job's output */
+#define JOB_GREP            19 /* search the output of a job */
+#define JOB_SEARCH          20 /* search the output of all finished jobs */
+
+#define INPUT_CHUNK     (64 * 1024) /* most data the client sends at once */
+
+/* conditions on which a job depends on another */
+#define DEP_AFTEROK     0   /* the other job exited with status 0 */
+#define DEP_AFTERANY    1   /* the other job finished, in any way */
+
+/* where a job's stdout and stderr go, see output.c */
+#define OUTPUT_DEFAULT  0   /* whatever the server was started with */
+#define OUTPUT_FILES    1   /* straight into its output files */
+#define OUTPUT_CAPTURE  2   /* through pipes into the server's memory */
+#define OUTPUT_DISCARD  3   /* to /dev/null */
+
+/* how the pattern of a JOB_GREP request is matched */
+#define GREP_REGEX      0x1 /* an extended regular expression, not a string */
+#define GREP_ICASE      0x2 /* ignoring case */
+
+/**
+ * job dependency structure
+ **/
+typedef struct dependency_s
+{
+    uint32_t jobid;
+    uint32_t cond;
+} dependency_t;
+
 /**
  * job submission structure
  **/
@@ -58,6 +95,22 @@ typedef struct submission_s
     uint32_t maxcpu;
     uint32_t maxmem;
     int32_t priority;
+    uint32_t cores;
+    uint32_t walltime;      /* estimated run time in seconds, 0 if unknown */
+
+    uint32_t ndeps;
+    dependency_t *deps;
+
+    uint32_t ntasks;        /* tasks in a job array, 0 for a single job */
+    uint32_t array_lo;      /* index of the first task */
+    uint32_t array_cap;     /* tasks running at once, 0 for no limit */
+
+    uint32_t fplen;         /* fingerprint of a cacheable job's inputs, */
+    char *fingerprint;      /* NULL if the job is not cacheable */
+
+    uint32_t input;         /* 1 if its stdin is fed with JOB_INPUT */
+    uint32_t output;        /* where its output goes, see output.h */
+    uint64_t maxout;        /* bytes of output it may write, 0 for no limit */
 
     uint32_t cmdlen;
     char *cmdline;
@@ -66,6 +119,8 @@ typedef struct submission_s
     char **envp;
 } submission_t;
 
+#define STATUS_CPULEN   64
+
 /**
  * job status structure 
  **/
@@ -78,6 +133,15 @@ typedef struct status_s
     uint32_t maxmem;
     int32_t priority;
 
+    int32_t node;                   /* NUMA node the job runs on, or -1 */
+    char cpus[STATUS_CPULEN];       /* cpus the job runs on, if placed */
+
+    uint32_t ntasks;                /* for a job array, how its tasks fare */
+    uint32_t npending;
+    uint32_t nrunning;
+    uint32_t nsucceeded;
+    uint32_t nfailed;               /* including those canceled */
+
     struct rusage ru;
 } status_t;
 
@@ -123,6 +187,56 @@ typedef struct signal_s
     uint32_t signal;
 } signal_t;
 
+/**
+ * job input structure. the data follows the header, and is left on the
+ * socket by recv_pkt() for the receiver to forward.
+ **/
+typedef struct input_s
+{
+    uint32_t jobid;
+    uint32_t length;        /* 0 to close the job's stdin */
+    char *data;
+} input_t;
+
+/**
+ * job output lines request structure, answered with JOB_RESULTS
+ **/
+typedef struct lines_s
+{
+    uint32_t jobid;
+    uint32_t stream;        /* 0 for stdout, 1 for stderr */
+    uint64_t first;         /* first line, counting from 1, or 0 for the
+                             * last count lines */
+    uint64_t count;
+} lines_t;
+
+/**
+ * job output search structure, answered with JOB_RESULTS holding the matching
+ * lines (and those around them), each prefixed with its line number
+ **/
+typedef struct grep_s
+{
+    uint32_t jobid;
+    uint32_t stream;        /* 0 for stdout, 1 for stderr */
+    uint32_t flags;         /* GREP_REGEX, GREP_ICASE */
+    uint32_t before;        /* lines of context before each match */
+    uint32_t after;         /* lines of context after each match */
+    uint32_t maxcount;      /* matching lines to send, 0 for all */
+    uint32_t patlen;
+    char *pattern;
+} grep_t;
+
+/**
+ * search structure, answered with JOB_RESULTS holding a line for each match:
+ * the jobid, out or err, the line number and the offset of the line
+ **/
+typedef struct query_s
+{
+    uint32_t maxcount;      /* matching lines to send, 0 for all */
+    uint32_t patlen;
+    char *pattern;          /* a fixed string */
+} query_t;
+
 /**
  * job results structure
  **/
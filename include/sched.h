@@ -0,0 +1,45 @@
+/**
+ * @file sched.h
+ * @author Daniel Calabria
+ *
+ * Header file for sched.c
+ **/
+
+#ifndef SCHED_H
+#define SCHED_H
+
+#include "jobs.h"
+
+/* scheduling policies for queued jobs */
+#define POLICY_FIFO     0   /* first come, first served */
+#define POLICY_FAIR     1   /* fair-share across clients */
+#define POLICY_PRIO     2   /* by priority level, with aging */
+
+#define PRIO_AGING      60      /* default seconds per level of aging */
+
+#define FAIR_HALFLIFE   300.0   /* seconds for recorded usage to halve */
+
+#define SCHED_SCAN      64      /* queued jobs looked at per dispatch */
+
+/* fxn prototypes for sched.c */
+int sched_submit(job_t *job);
+int sched_enqueue(job_t *job);
+job_t* sched_dequeue();
+int sched_remove(job_t *job);
+int sched_dispatch();
+int sched_refuse(job_t *job);
+int sched_set_priority(job_t *job, int priority);
+int sched_preempt(job_t *job);
+int sched_resume(int priority);
+void sched_continued(job_t *job);
+void sched_occupy(job_t *job);
+void sched_vacate(job_t *job);
+int sched_admissible(job_t *job);
+int sched_fits(job_t *job);
+void sched_acquire(job_t *job);
+void sched_release(job_t *job);
+void sched_charge(job_t *job);
+int sched_set_weight(const char *spec);
+double sched_weight(const char *name);
+
+#endif // SCHED_H
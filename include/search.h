@@ -0,0 +1,66 @@
+/**
+ * @file search.h
+ * @author Daniel Calabria
+ *
+ * Header file for search.c
+ **/
+
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <stdint.h>
+#include <time.h>
+
+#include "archive.h"
+#include "conn.h"
+#include "proto.h"
+
+#define SEARCH_BURST    (1024 * 1024) /* bytes indexed per turn of the loop */
+#define SEARCH_MINDEAD  64      /* documents of expunged jobs before an index
+                                 * is rebuilt */
+#define SEARCH_MAXRESULTS (1024 * 1024) /* most bytes of matches sent back */
+#define SEARCH_MAXINDEX (64 * 1024 * 1024) /* most bytes the trigram table and
+                                            * lists of one index take up */
+
+/* The documents (streams of jobs) containing one trigram */
+typedef struct posting_s
+{
+    uint32_t tri;           /* the trigram plus one, 0 for an empty slot */
+    uint32_t last;          /* the last document added plus one */
+    uint32_t len;
+    uint32_t cap;
+    uint8_t *data;          /* varint gaps between ascending documents */
+} posting_t;
+
+/* A client's index over the output of its finished jobs. A document is one
+ * stream of one job, named by its key, jobid << 1 | stream. */
+typedef struct search_s
+{
+    posting_t *table;       /* open addressing on the trigram */
+    uint32_t tablecap;
+    uint32_t ntrigrams;
+    uint64_t bytes;         /* taken up by the table and the lists */
+    uint32_t full;          /* jobs archived when the index outgrew
+                             * SEARCH_MAXINDEX and was given up, else 0 */
+
+    uint32_t *docs;         /* key of each document indexed */
+    uint32_t ndocs;
+    uint32_t doccap;
+    uint32_t ndead;         /* documents of jobs expunged since */
+
+    uint32_t *pending;      /* keys of the documents still to be indexed, */
+    uint32_t pendhead;      /* from pending[pendhead] to pending[npending] */
+    uint32_t npending;
+    uint32_t pendcap;
+    uint64_t cursor;        /* how far the first of them was indexed */
+} search_t;
+
+/* fxn prototypes for search.c */
+void search_add(archive_t *a, uint32_t jobid);
+void search_forget(archive_t *a, int idx);
+void search_free(archive_t *a);
+void search_poll();
+struct timespec* search_timeout(struct timespec *ts);
+int search_serve(conn_t *conn, query_t *req);
+
+#endif // SEARCH_H
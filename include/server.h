@@ -9,15 +9,69 @@
 #include "client.h"
 #include "conn.h"
 
+/* Fair-share weight for a client, given with -w */
+typedef struct weight_s
+{
+    char *name;
+    double weight;
+    struct weight_s *next;
+} weight_t;
+
 /* Server representation */
 typedef struct server_s
 {
     int maxjobs;
     int numjobs;
 
+    /* retention policy for finished jobs, 0 means unlimited */
+    long retain_age;                /* seconds a finished job is kept */
+    int retain_count;               /* finished jobs kept per client */
+    unsigned long long retain_bytes;/* total size of kept output */
+    client_t *gc_cursor;            /* client the collector resumes at */
+    int gc_more;                    /* collector ran out of time last run */
+
     client_t *clientlist;
     conn_t *connlist;
     job_t *joblist;
+    int policy;                 /* how queued jobs are picked, see sched.h */
+    int nqueued;                /* NEW jobs waiting for a free slot */
+    job_t *queue;               /* the queue, unless it is kept per client */
+    job_t *queue_tail;
+    job_t **heap;               /* the queue, under the priority policy */
+    int heapsize;
+    int heapcap;
+    long aging;                 /* seconds for a queued job to gain a level */
+    int preempt;                /* suspend running jobs for more urgent ones */
+    int backfill;               /* only backfill around a reservation */
+    job_t *preempted;           /* jobs suspended to make room, see sched.c */
+    job_t *running;             /* running jobs, least urgent first */
+    job_t *ending;              /* and soonest expected to end first */
+
+    /* resource budgets for running jobs, 0 means unlimited */
+    unsigned long long mem_budget;  /* sum of maxmem */
+    unsigned long long mem_used;
+    uint32_t core_budget;           /* sum of requested cores */
+    uint32_t cores_used;
+
+    /* cpus jobs are placed on, only filled in when placement is enabled */
+    int ncpus;
+    int nnodes;
+    int *cpuid;
+    int *cpunode;                   /* NUMA node of each cpu */
+    job_t **cpuowner;               /* running job holding each cpu */
+    int membind;                    /* bind job memory to its node */
+
+    /* cgroup v2 enforcement, cgroot is NULL when rlimits are used */
+    char *cgroot;                   /* the server's own cgroup */
+    int cg_memory;                  /* memory controller is available */
+    int cg_cpu;                     /* cpu controller is available */
+    weight_t *weights;
+
+    /* job output, see output.c */
+    uint32_t outmode;               /* for jobs which do not pick one */
+    uint32_t spill;                 /* bytes of a stream kept in memory */
+    unsigned long long quota;       /* kept output per client, 0 for none */
+    int search_index;               /* index output for JOB_SEARCH */
 
     char *socket_file;
 } server_t;
@@ -31,6 +85,7 @@ int server_remove_client(client_t *c);
 client_t* server_login_client(char *name);
 int server_handle_client(conn_t *conn);
 void handle_all_signals();
+void server_reap(job_t *j, int status, struct rusage *ru);
 void server_handler(int sig);
 int server_init();
 conn_t* server_register_conn(int fd);
@@ -0,0 +1,21 @@
+/**
+ * @file spawn.h
+ * @author Daniel Calabria
+ *
+ * Header file for spawn.c
+ **/
+
+#ifndef SPAWN_H
+#define SPAWN_H
+
+#include <sys/types.h>
+
+#define SPAWN_STACK     (256 * 1024)    /* stack of a child until it execs */
+
+/* fxn prototypes for spawn.c */
+pid_t spawn(int (*fn)(void *), void *arg, int flags);
+pid_t spawn_copy(int (*fn)(void *), void *arg, int flags);
+void spawn_signals();
+void spawn_free();
+
+#endif // SPAWN_H
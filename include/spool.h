@@ -0,0 +1,27 @@
+/**
+ * @file spool.h
+ * @author Daniel Calabria
+ *
+ * Header file for spool.c
+ **/
+
+#ifndef SPOOL_H
+#define SPOOL_H
+
+#include <stdint.h>
+#include <sys/time.h>
+
+#include "client.h"
+
+#define SPOOL_SHARDS    256     /* directories per user within a spool root */
+#define SPOOL_MAXROOTS  16      /* spool roots output files are striped over */
+
+/* fxn prototypes for spool.c */
+int spool_init(char *roots);
+uint32_t spool_hash(const struct timeval *stamp);
+const char* spool_root(uint32_t hash);
+int spool_prepare(client_t *c, const struct timeval *stamp);
+int spool_copy(const char *from, const char *to);
+void spool_free();
+
+#endif // SPOOL_H
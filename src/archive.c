@@ -0,0 +1,490 @@
+/**
+ * @file archive.c
+ * @author Daniel Calabria
+ *
+ * Compact storage for finished jobs.
+ *
+ * When a job is reaped for the last time, jobs_archive() copies the handful of
+ * fields that remain visible to the client into the owner's archive and frees
+ * the job_t along with its parsed input, launch block and file names. Each
+ * field is kept in its own array, indexed by position, and the arrays are
+ * kept sorted by jobid so lookups are a binary search and listings can be
+ * merged with the (also jobid ordered) list of live jobs.
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "common.h"
+#include "debug.h"
+#include "archive.h"
+#include "jobs.h"
+#include "proto.h"
+#include "output.h"
+#include "lines.h"
+#include "search.h"
+
+/* every array in the archive, so growing and shifting can be done in one go */
+#define ARCHIVE_FIELDS(X) \
+    X(jobid) X(status) X(exitcode) X(maxcpu) X(maxmem) X(priority) \
+    X(utime) X(stime) X(maxrss) X(stamp) X(cmdoff) X(finished) X(bytes) \
+    X(output) X(lines) X(indexed)
+
+/**
+ * int archive_grow(archive_t *)
+ *
+ * @brief  Doubles the capacity of every array within the archive.
+ *
+ * @param a  The archive to grow
+ *
+ * @return  0 on success, -errno on failure
+ **/
+static int archive_grow(archive_t *a)
+{
+    uint32_t cap = a->cap ? a->cap * 2 : 16;
+
+#define GROW(f) \
+    { \
+        void *p = realloc(a->f, sizeof(*a->f) * cap); \
+        if(!p) \
+            return -ENOMEM; \
+        a->f = p; \
+    }
+    ARCHIVE_FIELDS(GROW)
+#undef GROW
+
+    a->cap = cap;
+    return 0;
+}
+
+/**
+ * int archive_pool_add(archive_t *, const char *)
+ *
+ * @brief  Appends a string to the archive's string pool, compacting the pool
+ *         first if most of it belongs to entries which have been removed.
+ *
+ * @param a  The archive
+ * @param str  The string to append
+ *
+ * @return  The offset of the string within the pool, or -errno on failure.
+ **/
+static long archive_pool_add(archive_t *a, const char *str)
+{
+    size_t len = strlen(str) + 1;
+
+    if(a->poolgarbage > 4096 && a->poolgarbage > a->poolused / 2)
+    {
+        char *pool = malloc(a->poolcap);
+        if(!pool)
+            return -ENOMEM;
+
+        uint32_t used = 0;
+        for(uint32_t i = 0; i < a->count; i++)
+        {
+            size_t l = strlen(a->pool + a->cmdoff[i]) + 1;
+            memcpy(pool + used, a->pool + a->cmdoff[i], l);
+            a->cmdoff[i] = used;
+            used += l;
+        }
+
+        FREE(a->pool);
+        a->pool = pool;
+        a->poolused = used;
+        a->poolgarbage = 0;
+    }
+
+    if(a->poolused + len > a->poolcap)
+    {
+        uint32_t cap = a->poolcap ? a->poolcap : 1024;
+        while(a->poolused + len > cap)
+            cap *= 2;
+
+        char *pool = realloc(a->pool, cap);
+        if(!pool)
+            return -ENOMEM;
+        a->pool = pool;
+        a->poolcap = cap;
+    }
+
+    long off = a->poolused;
+    memcpy(a->pool + off, str, len);
+    a->poolused += len;
+    return off;
+}
+
+/**
+ * int archive_order_add(archive_t *, uint32_t)
+ *
+ * @brief  Records that a job was archived, after every job archived before
+ *         it. Jobids of entries which have been removed since are dropped
+ *         once they make up most of the ring.
+ *
+ * @param a  The archive
+ * @param jobid  The jobid of the job
+ *
+ * @return  0 on success, -errno on failure
+ **/
+static int archive_order_add(archive_t *a, uint32_t jobid)
+{
+    if(a->orderlen > 2 * a->count + 16)
+    {
+        uint32_t n = 0;
+        for(uint32_t i = 0; i < a->orderlen; i++)
+        {
+            uint32_t id = a->order[(a->orderhead + i) % a->ordercap];
+            if(archive_find(a, id) >= 0)
+                a->order[(a->orderhead + n++) % a->ordercap] = id;
+        }
+        a->orderlen = n;
+    }
+
+    if(a->orderlen == a->ordercap)
+    {
+        uint32_t cap = a->ordercap ? a->ordercap * 2 : 16;
+        uint32_t *order = malloc(sizeof(uint32_t) * cap);
+        if(!order)
+            return -ENOMEM;
+
+        for(uint32_t i = 0; i < a->orderlen; i++)
+            order[i] = a->order[(a->orderhead + i) % a->ordercap];
+        FREE(a->order);
+        a->order = order;
+        a->orderhead = 0;
+        a->ordercap = cap;
+    }
+
+    a->order[(a->orderhead + a->orderlen++) % a->ordercap] = jobid;
+    return 0;
+}
+
+/**
+ * int archive_find(archive_t *, uint32_t)
+ *
+ * @brief  Finds the archived job with the specified jobid.
+ *
+ * @param a  The archive to search
+ * @param jobid  The jobid to find
+ *
+ * @return  The index of the job within the archive, or -1 if not found.
+ **/
+int archive_find(archive_t *a, uint32_t jobid)
+{
+    int lo = 0, hi = (a ? (int)a->count : 0) - 1;
+
+    while(lo <= hi)
+    {
+        int mid = lo + (hi - lo) / 2;
+        if(a->jobid[mid] == jobid)
+            return mid;
+        if(a->jobid[mid] < jobid)
+            lo = mid + 1;
+        else
+            hi = mid - 1;
+    }
+
+    return -1;
+}
+
+/**
+ * int archive_insert(archive_t *, job_t *)
+ *
+ * @brief  Records a finished job within the archive. The job itself is left
+ *         untouched; the caller is responsible for freeing it, once it no
+ *         longer points to the output the archive took over.
+ *
+ * @param a  The archive to insert into
+ * @param job  The finished job
+ *
+ * @return  The index the job was stored at, or -errno on failure.
+ **/
+int archive_insert(archive_t *a, job_t *job)
+{
+    debug("archive_insert() - ENTER [job @ %p]", job);
+    int retval = 0;
+
+    VALIDATE(a && job, "archive and job must be non NULL", -EINVAL,
+            archive_insert_end);
+
+    if(a->count == a->cap)
+    {
+        VALIDATE(archive_grow(a) == 0, "failed to grow archive", -ENOMEM,
+                archive_insert_end);
+    }
+
+    VALIDATE(archive_order_add(a, job->jobid) == 0,
+            "failed to record archive order", -ENOMEM, archive_insert_end);
+
+    long off = archive_pool_add(a, job->ui ? job->ui->input : "");
+    VALIDATE(off >= 0, "failed to store command line", -ENOMEM,
+            archive_insert_end);
+
+    /* jobs usually finish in roughly the order they were submitted, so the
+     * insertion point is almost always at (or near) the end */
+    int idx = a->count;
+    while(idx > 0 && a->jobid[idx-1] > job->jobid)
+        idx--;
+
+    if(idx < a->count)
+    {
+#define SHIFT(f) \
+        memmove(&a->f[idx+1], &a->f[idx], sizeof(*a->f) * (a->count - idx));
+        ARCHIVE_FIELDS(SHIFT)
+#undef SHIFT
+    }
+
+    a->jobid[idx] = job->jobid;
+    a->status[idx] = job->status;
+    a->exitcode[idx] = job->exitcode;
+    a->maxcpu[idx] = job->maxcpu;
+    a->maxmem[idx] = job->maxmem;
+    a->priority[idx] = job->priority;
+    a->utime[idx] = job->ru.ru_utime;
+    a->stime[idx] = job->ru.ru_stime;
+    a->maxrss[idx] = job->ru.ru_maxrss;
+    a->stamp[idx] = job->stamp;
+    a->cmdoff[idx] = off;
+    a->finished[idx] = time(NULL);
+
+    /* what it captured stays in memory, the caller drops the job's pointer */
+    a->output[idx] = job->output;
+    a->lines[idx] = NULL;
+    a->indexed[idx] = 0;
+    if(job->output)
+        job->output->job = NULL;
+
+    /* remember how much spool space (and memory) the job's output takes up */
+    struct stat st;
+    a->bytes[idx] = output_bytes(job->output);
+    if(job->stdoutfile && stat(job->stdoutfile, &st) == 0)
+        a->bytes[idx] += st.st_size;
+    if(job->stderrfile && stat(job->stderrfile, &st) == 0)
+        a->bytes[idx] += st.st_size;
+    a->totalbytes += a->bytes[idx];
+
+    if(idx < a->gcpos)
+        a->gcpos++;
+    a->count++;
+    search_add(a, job->jobid);
+
+    retval = idx;
+
+archive_insert_end:
+    debug("archive_insert() - EXIT [%d]", retval);
+    return retval;
+}
+
+/**
+ * int archive_remove(archive_t *, int, const char *)
+ *
+ * @brief  Removes an entry from the archive, deleting its output files.
+ *
+ * @param a  The archive
+ * @param idx  The index of the entry to remove
+ * @param owner  The name of the client owning the archive
+ *
+ * @return  0 on success, -errno on failure
+ **/
+int archive_remove(archive_t *a, int idx, const char *owner)
+{
+    return archive_remove_range(a, idx, 1, owner);
+}
+
+/**
+ * int archive_remove_range(archive_t *, int, int, const char *)
+ *
+ * @brief  Removes n consecutive entries from the archive, deleting their
+ *         output files. The entries after them are shifted down once, for
+ *         all n of them.
+ *
+ * @param a  The archive
+ * @param idx  The index of the first entry to remove
+ * @param n  The number of entries to remove
+ * @param owner  The name of the client owning the archive
+ *
+ * @return  0 on success, -errno on failure
+ **/
+int archive_remove_range(archive_t *a, int idx, int n, const char *owner)
+{
+    debug("archive_remove_range() - ENTER [idx=%d, n=%d]", idx, n);
+    int retval = 0;
+
+    VALIDATE(a && idx >= 0 && n > 0 && idx + n <= a->count,
+            "invalid archive index", -EINVAL, archive_remove_range_end);
+
+    for(int i = idx; i < idx + n; i++)
+    {
+        char path[PATH_MAX];
+        if(jobs_output_path(path, sizeof(path), owner, &a->stamp[i],
+                    "out") == 0)
+            unlink(path);
+        if(jobs_output_path(path, sizeof(path), owner, &a->stamp[i],
+                    "err") == 0)
+            unlink(path);
+        output_free(a->output[i]);
+        lines_free(a->lines[i]);
+        search_forget(a, i);
+
+        a->poolgarbage += strlen(a->pool + a->cmdoff[i]) + 1;
+        a->totalbytes -= a->bytes[i];
+    }
+
+    if(idx + n <= a->gcpos)
+        a->gcpos -= n;
+    else if(idx < a->gcpos)
+        a->gcpos = idx;
+
+    a->count -= n;
+    if(idx < a->count)
+    {
+#define SHIFT(f) \
+        memmove(&a->f[idx], &a->f[idx+n], sizeof(*a->f) * (a->count - idx));
+        ARCHIVE_FIELDS(SHIFT)
+#undef SHIFT
+    }
+
+    if(a->count == 0)
+    {
+        a->poolused = a->poolgarbage = 0;
+        a->orderhead = a->orderlen = 0;
+    }
+
+archive_remove_range_end:
+    debug("archive_remove_range() - EXIT [%d]", retval);
+    return retval;
+}
+
+/**
+ * int archive_oldest(archive_t *)
+ *
+ * @brief  Finds the entry which finished first, that is, the one archived
+ *         first. Jobids of entries removed since are dropped from the front
+ *         of the archive order on the way.
+ *
+ * @param a  The archive
+ *
+ * @return  The index of the entry, or -1 if the archive is empty.
+ **/
+int archive_oldest(archive_t *a)
+{
+    if(!a)
+        return -1;
+
+    while(a->orderlen > 0)
+    {
+        int idx = archive_find(a, a->order[a->orderhead]);
+        if(idx >= 0)
+            return idx;
+
+        a->orderhead = (a->orderhead + 1) % a->ordercap;
+        a->orderlen--;
+    }
+
+    return -1;
+}
+
+/**
+ * int archive_oldest_run(archive_t *, int, time_t, int)
+ *
+ * @brief  Counts the entries from the oldest one on which are next in the
+ *         archive order as well as in jobid order, so that they can be
+ *         removed together, oldest first.
+ *
+ * @param a  The archive
+ * @param idx  The index of the oldest entry, from archive_oldest()
+ * @param before  Only count entries which finished before this time
+ * @param max  The most entries to count
+ *
+ * @return  The number of entries, at least 1.
+ **/
+int archive_oldest_run(archive_t *a, int idx, time_t before, int max)
+{
+    int n = 1;
+
+    for(uint32_t i = 1; i < a->orderlen && n < max && idx + n < a->count; i++)
+    {
+        uint32_t id = a->order[(a->orderhead + i) % a->ordercap];
+        if(id == a->jobid[idx + n])
+        {
+            if(a->finished[idx + n] >= before)
+                break;
+            n++;
+        }
+        else if(archive_find(a, id) >= 0)
+            break;
+    }
+
+    return n;
+}
+
+/**
+ * void archive_free(archive_t *, const char *)
+ *
+ * @brief  Removes every entry from the archive, deleting their output files,
+ *         and releases the memory held by the archive.
+ *
+ * @param a  The archive
+ * @param owner  The name of the client owning the archive
+ **/
+void archive_free(archive_t *a, const char *owner)
+{
+    debug("archive_free() - ENTER");
+    if(!a)
+        return;
+
+    if(a->count > 0)
+        archive_remove_range(a, 0, a->count, owner);
+    search_free(a);
+
+#define RELEASE(f) FREE(a->f);
+    ARCHIVE_FIELDS(RELEASE)
+#undef RELEASE
+    FREE(a->pool);
+    FREE(a->order);
+
+    memset(a, 0, sizeof(archive_t));
+    debug("archive_free() - EXIT");
+}
+
+/**
+ * const char* archive_cmdline(archive_t *, int)
+ *
+ * @brief  Retrieves the command line of an archived job.
+ *
+ * @param a  The archive
+ * @param idx  The index of the entry
+ *
+ * @return  The command line.
+ **/
+const char* archive_cmdline(archive_t *a, int idx)
+{
+    return a->pool + a->cmdoff[idx];
+}
+
+/**
+ * void archive_status(archive_t *, int, status_t *)
+ *
+ * @brief  Fills in a status_t for an archived job. Only the cpu times and
+ *         maximum rss survive from the job's rusage.
+ *
+ * @param a  The archive
+ * @param idx  The index of the entry
+ * @param s  The status structure to fill in
+ **/
+void archive_status(archive_t *a, int idx, status_t *s)
+{
+    memset(s, 0, sizeof(status_t));
+    s->status = a->status[idx];
+    s->exitcode = a->exitcode[idx];
+    s->maxcpu = a->maxcpu[idx];
+    s->maxmem = a->maxmem[idx];
+    s->priority = a->priority[idx];
+    s->node = -1;
+    s->ru.ru_utime = a->utime[idx];
+    s->ru.ru_stime = a->stime[idx];
+    s->ru.ru_maxrss = a->maxrss[idx];
+}
@@ -0,0 +1,407 @@
+/**
+ * @file array.c
+ * @author Daniel Calabria
+ *
+ * Job arrays.
+ *
+ * An array submission stands for one task per index in lo..hi, which only
+ * differ by the value of ARRAY_ENV in their environment. The server keeps a
+ * single record for it: a template job holding the limits, parsed command line
+ * and environment, and a handful of counters. The array takes the jobid it was
+ * submitted under, and the jobids after it are reserved for its tasks, so task
+ * i of an array submitted as jobid n is jobid n + 1 + (i - lo).
+ *
+ * Tasks are created lazily. At most one task of an array is waiting on the
+ * ready queue at any time; when it starts, the next one is created behind it,
+ * as long as fewer than cap tasks are alive. A task which finishes makes room
+ * for another. Once created, a task is an ordinary job, which can be queried,
+ * signaled and archived on its own.
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+
+#include "common.h"
+#include "debug.h"
+#include "server.h"
+#include "client.h"
+#include "jobs.h"
+#include "parse.h"
+#include "sched.h"
+#include "array.h"
+
+/**
+ * array_t* array_create(client_t *, job_t *, uint32_t, uint32_t, uint32_t)
+ *
+ * @brief  Records a new job array, reserving jobids for all of its tasks.
+ *         No task is created yet; see array_feed().
+ *
+ * @param c  The client submitting the array
+ * @param tmpl  The template job, with its launch block built. The array takes
+ *              ownership of it.
+ * @param lo  The first index
+ * @param hi  The last index
+ * @param cap  How many tasks may be alive at once, 0 for no limit
+ *
+ * @return  The new array, or NULL on failure.
+ **/
+array_t* array_create(client_t *c, job_t *tmpl, uint32_t lo, uint32_t hi,
+        uint32_t cap)
+{
+    debug("array_create() - ENTER [%u-%u%%%u]", lo, hi, cap);
+    array_t *retval = NULL;
+
+    VALIDATE(c && tmpl && lo <= hi, "invalid array", NULL, array_create_end);
+
+    MALLOC(retval, sizeof(array_t));
+    retval->jobid = c->numjobs;
+    retval->lo = lo;
+    retval->hi = hi;
+    retval->cap = cap;
+    retval->tmpl = tmpl;
+    retval->next = lo;
+
+    tmpl->owner = c;
+    tmpl->jobid = retval->jobid;
+    c->numjobs += 1 + (hi - lo + 1);
+
+    /* keep the list in jobid order, like the client's jobs */
+    array_t **a = &c->arrays;
+    while(*a)
+        a = &(*a)->next_array;
+    *a = retval;
+
+array_create_end:
+    debug("array_create() - EXIT [%p]", retval);
+    return retval;
+}
+
+/**
+ * array_t* array_find(client_t *, uint32_t)
+ *
+ * @brief  Finds the array submitted under the specified jobid.
+ *
+ * @return  The array, or NULL if there is none.
+ **/
+array_t* array_find(client_t *c, uint32_t jobid)
+{
+    for(array_t *a = (c ? c->arrays : NULL); a; a = a->next_array)
+    {
+        if(a->jobid == jobid)
+            return a;
+    }
+
+    return NULL;
+}
+
+/**
+ * array_t* array_of_task(client_t *, uint32_t)
+ *
+ * @brief  Finds the array which a jobid was reserved for as a task, if that
+ *         task was not created (yet).
+ *
+ * @return  The array, or NULL if the jobid does not belong to such a task.
+ **/
+array_t* array_of_task(client_t *c, uint32_t jobid)
+{
+    for(array_t *a = (c ? c->arrays : NULL); a; a = a->next_array)
+    {
+        if(jobid >= a->jobid + 1 + (a->next - a->lo) &&
+           jobid <= a->jobid + 1 + (a->hi - a->lo))
+            return a;
+    }
+
+    return NULL;
+}
+
+/**
+ * job_t* array_task(array_t *, uint32_t)
+ *
+ * @brief  Creates a task of an array, with the task index added to the
+ *         template's environment.
+ *
+ * @param a  The array
+ * @param idx  The index of the task
+ *
+ * @return  The new task, already inserted into the joblists.
+ **/
+static job_t* array_task(array_t *a, uint32_t idx)
+{
+    job_t *tmpl = a->tmpl;
+    job_t *task = jobs_create(parse_input(tmpl->ui->input));
+    if(!task)
+        return NULL;
+
+    task->maxmem = tmpl->maxmem;
+    task->maxcpu = tmpl->maxcpu;
+    task->priority = tmpl->priority;
+    task->cores = tmpl->cores;
+    task->walltime = tmpl->walltime;
+    task->outmode = tmpl->outmode;
+    task->maxout = tmpl->maxout;
+    task->array = a;
+    task->jobid = a->jobid + 1 + (idx - a->lo);
+
+    /* the template's environment, plus the task index */
+    char var[64];
+    char **envp = NULL;
+    MALLOC(envp, sizeof(char *) * (tmpl->envpc + 1));
+    memcpy(envp, tmpl->envp, sizeof(char *) * tmpl->envpc);
+    snprintf(var, sizeof(var), "%s=%u", ARRAY_ENV, idx);
+    envp[tmpl->envpc] = var;
+
+    int res = jobs_build_launch(task, envp, tmpl->envpc + 1);
+    FREE(envp);
+    if(res < 0 || jobs_insert(tmpl->owner, task) < 0)
+    {
+        /* it was never counted as live, so array_finished() must not see
+         * it, lest it count it and try to create it again */
+        task->array = NULL;
+        free_job(task);
+        return NULL;
+    }
+
+    return task;
+}
+
+/**
+ * int array_feed(array_t *)
+ *
+ * @brief  Creates the next task of an array and puts it on the ready queue,
+ *         unless a task is already waiting there, the array is at its cap or
+ *         every task has been created. If the task cannot be created, the
+ *         rest of the array is canceled, that task included, rather than left
+ *         pending with nothing to create it later. The caller is responsible
+ *         for calling sched_dispatch() afterwards, unless it is dispatching
+ *         already.
+ *
+ * @param a  The array
+ *
+ * @return  1 if a task was queued, 0 if not.
+ **/
+int array_feed(array_t *a)
+{
+    if(!a || a->stopped || a->pending || a->next > a->hi ||
+       (a->cap > 0 && a->live >= a->cap))
+        return 0;
+
+    job_t *task = array_task(a, a->next);
+    if(!task)
+    {
+        error("failed to create task %u of array %u, canceling the rest",
+                a->next, a->jobid);
+        array_cancel(a);
+        return 0;
+    }
+
+    a->next++;
+    a->live++;
+    a->pending = task;
+    if(sched_enqueue(task) < 0)
+        error("failed to queue task of array %u", a->jobid);
+
+    return 1;
+}
+
+/**
+ * void array_started(job_t *)
+ *
+ * @brief  Notes that a task has started, queueing the next one behind it.
+ *
+ * @param task  The task which started
+ **/
+void array_started(job_t *task)
+{
+    array_t *a = task->array;
+    if(!a || a->pending != task)
+        return;
+
+    a->pending = NULL;
+    array_feed(a);
+}
+
+/**
+ * void array_finished(job_t *)
+ *
+ * @brief  Counts a task which finished (or is being removed), and makes room
+ *         for the next one. Called once for each task, from free_job().
+ *
+ * @param task  The task
+ **/
+void array_finished(job_t *task)
+{
+    array_t *a = task->array;
+    if(!a)
+        return;
+
+    debug("task %u of array %u is done", task->jobid, a->jobid);
+    task->array = NULL;
+    if(a->pending == task)
+        a->pending = NULL;
+    a->live--;
+
+    if(task->status == EXITED && task->exitcode == 0)
+        a->succeeded++;
+    else
+        a->failed++;
+
+    if(array_feed(a))
+        sched_dispatch();
+}
+
+/**
+ * void array_cancel(array_t *)
+ *
+ * @brief  Makes sure no more tasks of an array are created.
+ *
+ * @param a  The array
+ **/
+void array_cancel(array_t *a)
+{
+    if(!a || a->stopped)
+        return;
+
+    a->canceled = a->hi - a->next + 1;
+    a->stopped = 1;
+}
+
+/**
+ * int array_signal(array_t *, int)
+ *
+ * @brief  Signals every running task of an array. SIGKILL also cancels the
+ *         tasks which have not started yet.
+ *
+ * @param a  The array
+ * @param sig  The signal
+ *
+ * @return  The number of tasks signaled.
+ **/
+int array_signal(array_t *a, int sig)
+{
+    int retval = 0;
+
+    if(sig == SIGKILL)
+    {
+        array_cancel(a);
+        if(a->pending)
+            jobs_abort(a->pending, SIGKILL);
+    }
+
+    for(job_t *j = a->tmpl->owner->jobs; j; j = j->next)
+    {
+        if(j->array == a && !JOB_PENDING(j->status) && jobs_kill(j, sig) == 0)
+            retval++;
+    }
+
+    return retval;
+}
+
+/**
+ * int array_remove(client_t *, array_t *)
+ *
+ * @brief  Removes an array, killing its tasks. Tasks which already finished
+ *         stay in the archive.
+ *
+ * @param c  The client owning the array
+ * @param a  The array
+ *
+ * @return  0 on success, -errno on failure
+ **/
+int array_remove(client_t *c, array_t *a)
+{
+    debug("array_remove() - ENTER [array %u]", a ? a->jobid : 0);
+    int retval = 0;
+
+    VALIDATE(c && a, "client and array must be non NULL", -EINVAL,
+            array_remove_end);
+
+    array_signal(a, SIGKILL);
+
+    /* the killed tasks are reaped as plain jobs */
+    for(job_t *j = c->jobs; j; j = j->next)
+    {
+        if(j->array == a)
+            j->array = NULL;
+    }
+
+    array_t **p = &c->arrays;
+    while(*p && *p != a)
+        p = &(*p)->next_array;
+    if(*p)
+        *p = a->next_array;
+
+    free_job(a->tmpl);
+    FREE(a);
+
+array_remove_end:
+    debug("array_remove() - EXIT [%d]", retval);
+    return retval;
+}
+
+/**
+ * void array_free_all(client_t *)
+ *
+ * @brief  Frees every array of a client. Its jobs must be freed already.
+ *
+ * @param c  The client
+ **/
+void array_free_all(client_t *c)
+{
+    while(c->arrays)
+    {
+        array_t *a = c->arrays;
+        c->arrays = a->next_array;
+        free_job(a->tmpl);
+        FREE(a);
+    }
+}
+
+/**
+ * void array_status(array_t *, status_t *)
+ *
+ * @brief  Fills in a status_t summing up the tasks of an array.
+ *
+ * @param a  The array
+ * @param s  The status structure to fill in
+ **/
+void array_status(array_t *a, status_t *s)
+{
+    memset(s, 0, sizeof(status_t));
+    s->status = ARRAY;
+    s->maxcpu = a->tmpl->maxcpu;
+    s->maxmem = a->tmpl->maxmem;
+    s->priority = a->tmpl->priority;
+    s->node = -1;
+
+    s->ntasks = a->hi - a->lo + 1;
+    s->npending = (a->stopped ? 0 : a->hi + 1 - a->next) +
+            (a->pending ? 1 : 0);
+    s->nrunning = a->live - (a->pending ? 1 : 0);
+    s->nsucceeded = a->succeeded;
+    s->nfailed = a->failed + a->canceled;
+}
+
+/**
+ * int array_describe(array_t *, char *, size_t)
+ *
+ * @brief  Writes the line describing an array in a job listing: its command
+ *         line, index range and how its tasks are doing.
+ *
+ * @param a  The array
+ * @param buf  Where to write the description
+ * @param size  The size of buf
+ *
+ * @return  The return value of snprintf().
+ **/
+int array_describe(array_t *a, char *buf, size_t size)
+{
+    status_t s;
+    array_status(a, &s);
+
+    return snprintf(buf, size, "%s [%u-%u%%%u: %u pending, %u running, "
+            "%u succeeded, %u failed]", a->tmpl->ui->input, a->lo, a->hi,
+            a->cap, s.npending, s.nrunning, s.nsucceeded, s.nfailed);
+}
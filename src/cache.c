@@ -0,0 +1,485 @@
+/**
+ * @file cache.c
+ * @author Daniel Calabria
+ *
+ * Memoization of the results of identical jobs.
+ *
+ * A job submitted with cache=<fingerprint> is identified by its command line,
+ * environment and limits (its output limit included, since a run without one
+ * may have written more than it allows), along with the fingerprint, which
+ * the user picks to describe whatever input files the job reads. When such a
+ * job becomes runnable (as it is submitted, or once the jobs it waits on are
+ * done), cache_submit() looks for an identical job:
+ *
+ *   - if one finished successfully before, its output files are linked to the
+ *     new job's, which is finished right away without being started.
+ *   - if one is queued or running, the new job follows it instead of taking a
+ *     slot of its own, and is finished along with it by cache_finished().
+ *
+ * The results of the last CACHE_ENTRIES successful jobs are kept, as hard
+ * links to their output files, so that expunging the job does not lose them.
+ * With several spool roots, a kept result is copied to a job whose files are
+ * on another filesystem.
+ * Only a successful run is ever reused; should the job being followed fail or
+ * go away, the first of its followers is started in its place.
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "debug.h"
+#include "server.h"
+#include "jobs.h"
+#include "sched.h"
+#include "depend.h"
+#include "cache.h"
+#include "spool.h"
+
+/* the kept results, and how many of them there are */
+static cache_t *cache = NULL;
+static int cache_count = 0;
+static uint32_t cache_serial = 0;   /* tells kept files with one key apart */
+
+/**
+ * uint64_t cache_hash(const char *, size_t)
+ *
+ * @brief  Computes the 64-bit FNV-1a hash of a buffer.
+ *
+ * @param buf  The buffer
+ * @param len  The length of the buffer
+ *
+ * @return  The hash.
+ **/
+static uint64_t cache_hash(const char *buf, size_t len)
+{
+    uint64_t h = 14695981039346656037ULL;
+
+    for(size_t i = 0; i < len; i++)
+    {
+        h ^= (unsigned char)buf[i];
+        h *= 1099511628211ULL;
+    }
+
+    return h;
+}
+
+/**
+ * int cache_prepare(job_t *, const char *)
+ *
+ * @brief  Makes a job cacheable, recording what identifies it. The job's
+ *         limits, command line and environment must be set already.
+ *
+ * @param job  The job
+ * @param fingerprint  The user's description of the job's inputs
+ *
+ * @return  0 on success, -errno on failure
+ **/
+int cache_prepare(job_t *job, const char *fingerprint)
+{
+    debug("cache_prepare() - ENTER [job @ %p]", job);
+    int retval = 0;
+    char limits[64];
+
+    VALIDATE(job && job->ui && fingerprint, "job must be complete", -EINVAL,
+            cache_prepare_end);
+
+    /* every part is nul terminated, so none can run into the next */
+    snprintf(limits, sizeof(limits), "%u %u %llu", job->maxcpu, job->maxmem,
+            (unsigned long long)job->maxout);
+    size_t len = strlen(limits) + 1 + strlen(fingerprint) + 1 +
+            strlen(job->ui->input) + 1;
+    for(uint32_t i = 0; i < job->envpc; i++)
+        len += strlen(job->envp[i]) + 1;
+
+    MALLOC(job->cacheblob, len);
+    char *p = job->cacheblob;
+#define PUT(s) \
+    { \
+        size_t l = strlen(s) + 1; \
+        memcpy(p, (s), l); \
+        p += l; \
+    }
+    PUT(limits);
+    PUT(fingerprint);
+    PUT(job->ui->input);
+    for(uint32_t i = 0; i < job->envpc; i++)
+        PUT(job->envp[i]);
+#undef PUT
+
+    job->cachelen = len;
+    job->cachekey = cache_hash(job->cacheblob, len);
+    debug("job is cacheable, key %016llx", (unsigned long long)job->cachekey);
+
+cache_prepare_end:
+    debug("cache_prepare() - EXIT [%d]", retval);
+    return retval;
+}
+
+/**
+ * int cache_same(job_t *, uint64_t, const char *, uint32_t)
+ *
+ * @brief  Determines whether a job is identified by the given key and blob.
+ *
+ * @return  1 if it is, 0 otherwise.
+ **/
+static int cache_same(job_t *job, uint64_t key, const char *blob, uint32_t len)
+{
+    return job->cacheblob && job->cachekey == key && job->cachelen == len &&
+           memcmp(job->cacheblob, blob, len) == 0;
+}
+
+/**
+ * int cache_link_one(const char *, const char *)
+ *
+ * @brief  Links a file to another name, copying it instead if the two are in
+ *         spool roots on different filesystems.
+ *
+ * @param from  The existing file
+ * @param to  The new name
+ *
+ * @return  0 on success, -errno on failure
+ **/
+static int cache_link_one(const char *from, const char *to)
+{
+    if(link(from, to) == 0)
+        return 0;
+
+    return errno == EXDEV ? spool_copy(from, to) : -errno;
+}
+
+/**
+ * int cache_link(const char *, const char *, const char *, const char *)
+ *
+ * @brief  Links a pair of output files to another pair of names. Either both
+ *         links are made, or neither is.
+ *
+ * @param out  The existing stdout file
+ * @param err  The existing stderr file
+ * @param newout  The new name for the stdout file
+ * @param newerr  The new name for the stderr file
+ *
+ * @return  0 on success, -errno on failure
+ **/
+static int cache_link(const char *out, const char *err, const char *newout,
+        const char *newerr)
+{
+    int res = cache_link_one(out, newout);
+    if(res < 0)
+        return res;
+
+    if((res = cache_link_one(err, newerr)) < 0)
+    {
+        unlink(newout);
+        return res;
+    }
+
+    return 0;
+}
+
+/**
+ * void cache_drop(cache_t **)
+ *
+ * @brief  Removes a kept result, along with its files.
+ *
+ * @param cp  The link to the entry within the list
+ **/
+static void cache_drop(cache_t **cp)
+{
+    cache_t *e = *cp;
+
+    *cp = e->next;
+    unlink(e->outfile);
+    unlink(e->errfile);
+    FREE(e->outfile);
+    FREE(e->errfile);
+    FREE(e->blob);
+    FREE(e);
+    cache_count--;
+}
+
+/**
+ * void cache_store(job_t *)
+ *
+ * @brief  Keeps the result of a job which finished successfully, forgetting
+ *         the least recently used result if there are too many.
+ *
+ * @param job  The job, whose output files have not been archived yet
+ **/
+static void cache_store(job_t *job)
+{
+    char out[PATH_MAX], err[PATH_MAX];
+    const char *root = spool_root(spool_hash(&job->stamp));
+
+    /* a result for it may have been kept while it ran */
+    for(cache_t *e = cache; e; e = e->next)
+    {
+        if(cache_same(job, e->key, e->blob, e->len))
+            return;
+    }
+
+    /* kept next to the job's own files, so that they can be linked */
+    uint32_t serial = cache_serial++;
+    snprintf(out, sizeof(out), "%s%s" CACHE_PREFIX "%016llx_%u.out",
+            (root ? root : ""), (root ? "/" : ""),
+            (unsigned long long)job->cachekey, serial);
+    snprintf(err, sizeof(err), "%s%s" CACHE_PREFIX "%016llx_%u.err",
+            (root ? root : ""), (root ? "/" : ""),
+            (unsigned long long)job->cachekey, serial);
+    int res = cache_link(job->stdoutfile, job->stderrfile, out, err);
+    if(res < 0)
+    {
+        error("failed to keep the result of job %d: %s", job->jobid,
+                strerror(-res));
+        return;
+    }
+
+    cache_t *e = NULL;
+    MALLOC(e, sizeof(cache_t));
+    e->key = job->cachekey;
+    e->len = job->cachelen;
+    MALLOC(e->blob, e->len);
+    memcpy(e->blob, job->cacheblob, e->len);
+    e->outfile = strdup(out);
+    e->errfile = strdup(err);
+    e->next = cache;
+    cache = e;
+    cache_count++;
+
+    if(cache_count > CACHE_ENTRIES)
+    {
+        cache_t **cp = &cache;
+        while((*cp)->next)
+            cp = &(*cp)->next;
+        cache_drop(cp);
+    }
+}
+
+/**
+ * void cache_answer(job_t *)
+ *
+ * @brief  Finishes a job which was not started, as if it had exited
+ *         successfully, once its output files are in place. The job is
+ *         archived, and thus freed.
+ *
+ * @param job  The job
+ **/
+static void cache_answer(job_t *job)
+{
+    job->status = EXITED;
+    job->exitcode = 0;
+    jobs_notify(job);
+
+    /* start (or fail) the jobs which were waiting on it */
+    depend_release(job);
+    if(jobs_archive(job->owner, job) < 0)
+        error("failed to archive finished job");
+}
+
+/**
+ * int cache_submit(job_t *)
+ *
+ * @brief  Called for a cacheable job as it becomes runnable: answers it from
+ *         a kept result, or has it follow an identical job which has not
+ *         finished yet.
+ *
+ * @param job  The job
+ *
+ * @return  1 if the job was answered or follows another, 0 if it has to be
+ *          submitted to the scheduler.
+ **/
+int cache_submit(job_t *job)
+{
+    debug("cache_submit() - ENTER [job @ %p]", job);
+    int retval = 0;
+
+    VALIDATE(job && job->cacheblob, "job is not cacheable", 0,
+            cache_submit_end);
+
+    for(cache_t **cp = &cache; *cp; cp = &(*cp)->next)
+    {
+        cache_t *e = *cp;
+        if(!cache_same(job, e->key, e->blob, e->len))
+            continue;
+
+        /* the kept files were removed from under us */
+        int res = cache_link(e->outfile, e->errfile, job->stdoutfile,
+                job->stderrfile);
+        if(res < 0)
+        {
+            debug("failed to link kept result: %s", strerror(-res));
+            cache_drop(cp);
+            break;
+        }
+
+        /* most recently used first */
+        *cp = e->next;
+        e->next = cache;
+        cache = e;
+
+        debug("job %d answered from a kept result", job->jobid);
+        cache_answer(job);
+        retval = 1;
+        goto cache_submit_end;
+    }
+
+    for(job_t *j = server->joblist; j; j = j->snext)
+    {
+        if(j == job || j->leader ||
+           (j->status != NEW && j->status != RUNNING && j->status != SUSPENDED))
+            continue;
+        if(!cache_same(job, j->cachekey, j->cacheblob, j->cachelen))
+            continue;
+
+        debug("job %d follows job %d", job->jobid, j->jobid);
+        job->leader = j;
+        job->fnext = j->followers;
+        j->followers = job;
+        retval = 1;
+        goto cache_submit_end;
+    }
+
+cache_submit_end:
+    debug("cache_submit() - EXIT [%d]", retval);
+    return retval;
+}
+
+/**
+ * void cache_promote(job_t *)
+ *
+ * @brief  The job others follow did not succeed. The first of its followers
+ *         which is still waiting is started in its place, and the rest
+ *         follow that one instead.
+ *
+ * @param job  The job
+ **/
+static void cache_promote(job_t *job)
+{
+    job_t *f = job->followers, *leader = NULL;
+
+    job->followers = NULL;
+    while(f)
+    {
+        job_t *next = f->fnext;
+        f->fnext = NULL;
+        f->leader = NULL;
+
+        /* those being torn down along with their client wait no more */
+        if(f->status == NEW)
+        {
+            if(!leader)
+                leader = f;
+            else
+            {
+                f->leader = leader;
+                f->fnext = leader->followers;
+                leader->followers = f;
+            }
+        }
+
+        f = next;
+    }
+
+    if(leader)
+    {
+        debug("job %d runs in place of job %d", leader->jobid, job->jobid);
+        sched_submit(leader);
+    }
+}
+
+/**
+ * void cache_finished(job_t *)
+ *
+ * @brief  Called when a cacheable job finishes, before it is archived. If it
+ *         succeeded, its result is kept and handed to the jobs following it.
+ *
+ * @param job  The job
+ **/
+void cache_finished(job_t *job)
+{
+    debug("cache_finished() - ENTER [job @ %p]", job);
+
+    if(!job || !job->cacheblob)
+        goto cache_finished_end;
+
+    if(job->status != EXITED || job->exitcode != 0)
+    {
+        cache_promote(job);
+        goto cache_finished_end;
+    }
+
+    cache_store(job);
+
+    while(job->followers)
+    {
+        job_t *f = job->followers;
+        job->followers = f->fnext;
+        f->fnext = NULL;
+        f->leader = NULL;
+
+        if(f->status != NEW)
+            continue;
+
+        int res = cache_link(job->stdoutfile, job->stderrfile, f->stdoutfile,
+                f->stderrfile);
+        if(res < 0)
+        {
+            /* it will have to find out for itself */
+            error("failed to link the output of job %d: %s", job->jobid,
+                    strerror(-res));
+            if(cache_submit(f) == 0)
+                sched_submit(f);
+            continue;
+        }
+
+        cache_answer(f);
+    }
+
+cache_finished_end:
+    debug("cache_finished() - EXIT");
+}
+
+/**
+ * void cache_detach(job_t *)
+ *
+ * @brief  Called as a job is freed: it stops following, and whatever follows
+ *         it is started in its place.
+ *
+ * @param job  The job
+ **/
+void cache_detach(job_t *job)
+{
+    if(!job)
+        return;
+
+    if(job->leader)
+    {
+        job_t **fp = &job->leader->followers;
+        while(*fp && *fp != job)
+            fp = &(*fp)->fnext;
+        if(*fp)
+            *fp = job->fnext;
+        job->leader = NULL;
+        job->fnext = NULL;
+    }
+
+    if(job->followers)
+        cache_promote(job);
+
+    FREE(job->cacheblob);
+}
+
+/**
+ * void cache_free()
+ *
+ * @brief  Removes every kept result, along with its files.
+ **/
+void cache_free()
+{
+    while(cache)
+        cache_drop(&cache);
+}
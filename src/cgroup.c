@@ -0,0 +1,474 @@
+/**
+ * @file cgroup.c
+ * @author Daniel Calabria
+ *
+ * cgroup v2 enforcement of job limits.
+ *
+ * setrlimit() limits apply to each process on its own, so a job which forks
+ * escapes them, and RLIMIT_AS counts address space rather than memory used.
+ * When the server is given a delegated cgroup v2 subtree, every job instead
+ * runs in a cgroup of its own beneath it:
+ *
+ *   <root>/smash.<server pid>/<client>.<jobid>
+ *
+ * memory.max is set to the job's maxmem, cpu.max to the cores it requested
+ * and cpu.weight from its priority. The cpu time of the whole job is checked
+ * every CGROUP_POLL seconds against maxcpu from cpu.stat, and when the job
+ * finishes its rusage is replaced with the totals of the cgroup. Jobs are
+ * killed as a whole with cgroup.kill.
+ *
+ * Controllers which cannot be enabled (or a cgroup which cannot be created)
+ * leave the job with the matching rlimits instead.
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
+#include <linux/magic.h>
+
+#include "common.h"
+#include "debug.h"
+#include "server.h"
+#include "jobs.h"
+#include "cgroup.h"
+
+/* cgroups of finished jobs which still had processes in them */
+typedef struct cgdead_s
+{
+    char *path;
+    struct cgdead_s *next;
+} cgdead_t;
+
+static cgdead_t *cgroup_dead = NULL;
+
+/**
+ * int cgroup_write(const char *, const char *, const char *)
+ *
+ * @brief  Writes a value to one of the files of a cgroup.
+ *
+ * @param dir  The cgroup's directory
+ * @param file  The name of the file within it
+ * @param val  The value to write
+ *
+ * @return  0 on success, -errno on failure
+ **/
+static int cgroup_write(const char *dir, const char *file, const char *val)
+{
+    int retval = 0;
+    int fd = -1;
+    char path[PATH_MAX];
+
+    snprintf(path, sizeof(path), "%s/%s", dir, file);
+    VALIDATE((fd = open(path, O_WRONLY | O_CLOEXEC)) >= 0, "open() failed",
+            -errno, cgroup_write_end);
+    VALIDATE(write(fd, val, strlen(val)) == strlen(val), "write() failed",
+            -errno, cgroup_write_end);
+
+cgroup_write_end:
+    if(retval < 0)
+        debug("failed to write \'%s\' to %s/%s: %s", val, dir, file,
+                strerror(-retval));
+    if(fd >= 0)
+        close(fd);
+    return retval;
+}
+
+/**
+ * long long cgroup_read_key(const char *, const char *, const char *)
+ *
+ * @brief  Reads a value from a cgroup file. Files holding a single value are
+ *         read by passing a NULL key, flat keyed files such as cpu.stat by
+ *         naming the key.
+ *
+ * @param dir  The cgroup's directory
+ * @param file  The name of the file within it
+ * @param key  The key to look up, or NULL
+ *
+ * @return  The value, or -errno on failure.
+ **/
+static long long cgroup_read_key(const char *dir, const char *file,
+        const char *key)
+{
+    long long retval = -ENOENT;
+    char path[PATH_MAX], line[256];
+    FILE *f = NULL;
+
+    snprintf(path, sizeof(path), "%s/%s", dir, file);
+    if(!(f = fopen(path, "re")))
+        return -errno;
+
+    size_t klen = (key ? strlen(key) : 0);
+    while(fgets(line, sizeof(line), f))
+    {
+        if(!key)
+        {
+            retval = strtoll(line, NULL, 10);
+            break;
+        }
+
+        if(strncmp(line, key, klen) == 0 && line[klen] == ' ')
+        {
+            retval = strtoll(line + klen + 1, NULL, 10);
+            break;
+        }
+    }
+
+    fclose(f);
+    return retval;
+}
+
+/**
+ * int cgroup_has(const char *, const char *)
+ *
+ * @brief  Determines whether a controller is enabled for a cgroup's children.
+ *
+ * @param dir  The cgroup's directory
+ * @param ctrl  The name of the controller
+ *
+ * @return  1 if it is, 0 otherwise.
+ **/
+static int cgroup_has(const char *dir, const char *ctrl)
+{
+    char path[PATH_MAX], buf[512];
+    FILE *f = NULL;
+    int retval = 0;
+
+    snprintf(path, sizeof(path), "%s/cgroup.subtree_control", dir);
+    if(!(f = fopen(path, "re")))
+        return 0;
+
+    if(fgets(buf, sizeof(buf), f))
+    {
+        for(char *tok = strtok(buf, " \n"); tok; tok = strtok(NULL, " \n"))
+        {
+            if(strcmp(tok, ctrl) == 0)
+                retval = 1;
+        }
+    }
+
+    fclose(f);
+    return retval;
+}
+
+/**
+ * int cgroup_init(const char *)
+ *
+ * @brief  Sets up the server's cgroup beneath a delegated cgroup v2 subtree,
+ *         enabling the memory and cpu controllers for jobs where possible.
+ *
+ * @param root  The directory of the delegated subtree
+ *
+ * @return  0 on success, -errno on failure
+ **/
+int cgroup_init(const char *root)
+{
+    debug("cgroup_init() - ENTER [%s]", root);
+    int retval = 0;
+    struct statfs sfs;
+    char path[PATH_MAX];
+
+    VALIDATE(root, "root must be non NULL", -EINVAL, cgroup_init_end);
+    VALIDATE(statfs(root, &sfs) == 0, "statfs() failed", -errno,
+            cgroup_init_end);
+    VALIDATE(sfs.f_type == CGROUP2_SUPER_MAGIC, "not a cgroup v2 hierarchy",
+            -ENOTSUP, cgroup_init_end);
+
+    snprintf(path, sizeof(path), "%s/smash.%d", root, getpid());
+    VALIDATE(mkdir(path, 0755) == 0 || errno == EEXIST, "mkdir() failed",
+            -errno, cgroup_init_end);
+
+    /* the controllers must be enabled at every level down to the jobs. it is
+     * fine if they already were, or if they cannot be. */
+    cgroup_write(root, "cgroup.subtree_control", "+memory");
+    cgroup_write(root, "cgroup.subtree_control", "+cpu");
+    cgroup_write(path, "cgroup.subtree_control", "+memory");
+    cgroup_write(path, "cgroup.subtree_control", "+cpu");
+
+    server->cg_memory = cgroup_has(path, "memory");
+    server->cg_cpu = cgroup_has(path, "cpu");
+    server->cgroot = strdup(path);
+    VALIDATE(server->cgroot, "strdup() failed", -ENOMEM, cgroup_init_end);
+
+cgroup_init_end:
+    debug("cgroup_init() - EXIT [%d, memory=%d cpu=%d]", retval,
+            server->cg_memory, server->cg_cpu);
+    return retval;
+}
+
+/**
+ * int cgroup_create(job_t *)
+ *
+ * @brief  Creates the cgroup of a job which is about to start and applies its
+ *         limits. On failure the job is left to the rlimits.
+ *
+ * @param job  The job
+ *
+ * @return  0 on success, -errno on failure
+ **/
+int cgroup_create(job_t *job)
+{
+    debug("cgroup_create() - ENTER [job @ %p]", job);
+    int retval = 0;
+    char path[PATH_MAX], val[64];
+
+    VALIDATE(job && server->cgroot, "cgroups are not in use", -EINVAL,
+            cgroup_create_end);
+    VALIDATE(!job->cgpath, "job already has a cgroup", 0, cgroup_create_end);
+
+    snprintf(path, sizeof(path), "%s/%s.%u", server->cgroot,
+            job->owner->name, job->jobid);
+    VALIDATE(mkdir(path, 0755) == 0 || errno == EEXIST, "mkdir() failed",
+            -errno, cgroup_create_end);
+
+    if(server->cg_memory)
+    {
+        snprintf(val, sizeof(val), "%u", job->maxmem);
+        cgroup_write(path, "memory.max", val);
+        cgroup_write(path, "memory.swap.max", "0");
+    }
+
+    if(server->cg_cpu)
+    {
+        snprintf(val, sizeof(val), "%u %d",
+                (job->cores ? job->cores : 1) * CGROUP_PERIOD, CGROUP_PERIOD);
+        cgroup_write(path, "cpu.max", val);
+
+        /* the kernel weighs each nice level about 1.25 times the next */
+        double w = 100.0 * pow(1.25, -job->priority);
+        snprintf(val, sizeof(val), "%d",
+                (int)(w < 1 ? 1 : (w > 10000 ? 10000 : w)));
+        cgroup_write(path, "cpu.weight", val);
+    }
+
+    job->cgpath = strdup(path);
+    VALIDATE(job->cgpath, "strdup() failed", -ENOMEM, cgroup_create_end);
+
+cgroup_create_end:
+    debug("cgroup_create() - EXIT [%d]", retval);
+    return retval;
+}
+
+/**
+ * int cgroup_enter(job_t *)
+ *
+ * @brief  Moves the calling process into the cgroup of a job. Called in the
+ *         child before the job is exec'd, so every process of the job is
+ *         accounted for from the start.
+ *
+ * @param job  The job being launched
+ *
+ * @return  0 on success, -errno on failure
+ **/
+int cgroup_enter(job_t *job)
+{
+    char pid[32];
+
+    if(!job->cgpath)
+        return 0;
+
+    snprintf(pid, sizeof(pid), "%d", getpid());
+    return cgroup_write(job->cgpath, "cgroup.procs", pid);
+}
+
+/**
+ * int cgroup_collect(job_t *)
+ *
+ * @brief  Replaces the rusage of a finished job with the cpu time and peak
+ *         memory of its whole cgroup, which includes every process it forked.
+ *
+ * @param job  The job
+ *
+ * @return  0 on success, -errno on failure
+ **/
+int cgroup_collect(job_t *job)
+{
+    int retval = 0;
+    long long usec = 0;
+
+    VALIDATE(job && job->cgpath, "job has no cgroup", -EINVAL,
+            cgroup_collect_end);
+
+    if((usec = cgroup_read_key(job->cgpath, "cpu.stat", "user_usec")) >= 0)
+    {
+        job->ru.ru_utime.tv_sec = usec / 1000000;
+        job->ru.ru_utime.tv_usec = usec % 1000000;
+    }
+    if((usec = cgroup_read_key(job->cgpath, "cpu.stat", "system_usec")) >= 0)
+    {
+        job->ru.ru_stime.tv_sec = usec / 1000000;
+        job->ru.ru_stime.tv_usec = usec % 1000000;
+    }
+
+    /* ru_maxrss is in kilobytes */
+    long long peak = cgroup_read_key(job->cgpath, "memory.peak", NULL);
+    if(peak >= 0)
+        job->ru.ru_maxrss = peak / 1024;
+
+cgroup_collect_end:
+    return retval;
+}
+
+/**
+ * int cgroup_kill(job_t *)
+ *
+ * @brief  Kills every process in a job's cgroup.
+ *
+ * @param job  The job
+ *
+ * @return  0 on success, -errno on failure (in which case the caller should
+ *          fall back to killpg()).
+ **/
+int cgroup_kill(job_t *job)
+{
+    if(!job || !job->cgpath)
+        return -EINVAL;
+
+    return cgroup_write(job->cgpath, "cgroup.kill", "1");
+}
+
+/**
+ * int cgroup_reap_dead()
+ *
+ * @brief  Removes the cgroups of finished jobs which were still emptying out
+ *         when the job was freed.
+ *
+ * @return  The number of cgroups still waiting to be removed.
+ **/
+static int cgroup_reap_dead()
+{
+    int left = 0;
+    cgdead_t **d = &cgroup_dead;
+
+    while(*d)
+    {
+        cgdead_t *cur = *d;
+        if(rmdir(cur->path) == 0 || errno == ENOENT)
+        {
+            *d = cur->next;
+            FREE(cur->path);
+            FREE(cur);
+            continue;
+        }
+
+        left++;
+        d = &cur->next;
+    }
+
+    return left;
+}
+
+/**
+ * void cgroup_destroy(job_t *)
+ *
+ * @brief  Kills anything left in a job's cgroup and removes it. A cgroup only
+ *         goes away once its last process has been reaped by the kernel, so
+ *         one which is still busy is retried from cgroup_poll().
+ *
+ * @param job  The job
+ **/
+void cgroup_destroy(job_t *job)
+{
+    if(!job || !job->cgpath)
+        return;
+
+    if(rmdir(job->cgpath) < 0 && errno == EBUSY)
+    {
+        cgroup_kill(job);
+        if(rmdir(job->cgpath) < 0 && errno == EBUSY)
+        {
+            cgdead_t *d = NULL;
+            MALLOC(d, sizeof(cgdead_t));
+            d->path = job->cgpath;
+            d->next = cgroup_dead;
+            cgroup_dead = d;
+            job->cgpath = NULL;
+            return;
+        }
+    }
+
+    FREE(job->cgpath);
+}
+
+/**
+ * int cgroup_poll()
+ *
+ * @brief  Kills jobs whose processes have used more cpu time between them
+ *         than the job's maxcpu, and retries removing old cgroups.
+ *
+ * @return  The number of jobs killed.
+ **/
+int cgroup_poll()
+{
+    static struct timespec last;
+    struct timespec now;
+    int retval = 0;
+
+    if(!server->cgroot)
+        return 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if(now.tv_sec - last.tv_sec < CGROUP_POLL)
+        return 0;
+    last = now;
+
+    for(job_t *j = server->joblist; j; j = j->snext)
+    {
+        if(!j->cgpath || (j->status != RUNNING && j->status != SUSPENDED))
+            continue;
+
+        long long usec = cgroup_read_key(j->cgpath, "cpu.stat", "usage_usec");
+        if(usec >= (long long)j->maxcpu * 1000000)
+        {
+            debug("job %u used %lldus of cpu, limit is %us", j->jobid, usec,
+                    j->maxcpu);
+            if(cgroup_kill(j) == 0)
+                retval++;
+        }
+    }
+
+    cgroup_reap_dead();
+    return retval;
+}
+
+/**
+ * struct timespec* cgroup_timeout(struct timespec *)
+ *
+ * @brief  Computes how long the main loop may sleep before cgroup_poll()
+ *         needs to run again.
+ *
+ * @param ts  Storage for the timeout
+ *
+ * @return  ts, or NULL if there is nothing to poll.
+ **/
+struct timespec* cgroup_timeout(struct timespec *ts)
+{
+    if(!server->cgroot || (server->numjobs == 0 && !cgroup_dead))
+        return NULL;
+
+    ts->tv_sec = CGROUP_POLL;
+    ts->tv_nsec = 0;
+    return ts;
+}
+
+/**
+ * void cgroup_shutdown()
+ *
+ * @brief  Removes the server's cgroup. Called once every job has been reaped.
+ **/
+void cgroup_shutdown()
+{
+    if(!server->cgroot)
+        return;
+
+    cgroup_reap_dead();
+    if(rmdir(server->cgroot) < 0)
+        debug("failed to remove %s: %s", server->cgroot, strerror(errno));
+    FREE(server->cgroot);
+}
@@ -7,7 +7,9 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/types.h>
+#include <fcntl.h>
 #include <unistd.h>
 #include <sys/socket.h>
 #include <sys/un.h>
@@ -99,25 +101,167 @@ int client_submit_job(client_t *client, char *str)
     MALLOC(job, sizeof(submission_t));
 
     /* the string should be of the format:
-     *    <maxcpu> <maxmem> <priority> <commandline>
+     *    [option=value ...] <maxcpu> <maxmem> <priority> <commandline>
      */
     char *tok = NULL, *saveptr = NULL;
 
-    /* extract maxcpu */
+    /* extract options */
     tok = strtok_r(str, " ", &saveptr);
-    if(!tok) { FREE(job); return -EINVAL; }
+    while(tok && strchr(tok, '='))
+    {
+        char *val = strchr(tok, '=') + 1, *endp = NULL;
+
+        if(strncmp(tok, "cores=", val - tok) == 0)
+        {
+            job->cores = strtol(val, &endp, 10);
+            if(*endp != '\0' || endp == val || job->cores < 1)
+            {
+                printf("Invalid number of cores.\n");
+                FREE(job->deps);
+                FREE(job);
+                return -EINVAL;
+            }
+        }
+        else if(strncmp(tok, "walltime=", val - tok) == 0)
+        {
+            job->walltime = strtol(val, &endp, 10);
+            if(*endp != '\0' || endp == val || job->walltime < 1)
+            {
+                printf("Invalid walltime.\n");
+                FREE(job->deps);
+                FREE(job);
+                return -EINVAL;
+            }
+        }
+        else if(strncmp(tok, "after=", val - tok) == 0 ||
+                strncmp(tok, "afterany=", val - tok) == 0)
+        {
+            /* a comma separated list of jobids */
+            uint32_t cond = (tok[5] == '=' ? DEP_AFTEROK : DEP_AFTERANY);
+            for(char *id = strtok_r(val, ",", &endp); id;
+                    id = strtok_r(NULL, ",", &endp))
+            {
+                char *idend = NULL;
+                long jobid = strtol(id, &idend, 10);
+                if(*idend != '\0' || jobid < 0)
+                {
+                    printf("Invalid jobid \'%s\'.\n", id);
+                    FREE(job->deps);
+                    FREE(job);
+                    return -EINVAL;
+                }
+
+                dependency_t *deps = realloc(job->deps,
+                        sizeof(dependency_t) * (job->ndeps + 1));
+                if(!deps)
+                    PERROR_EXIT("realloc()");
+                job->deps = deps;
+                job->deps[job->ndeps].jobid = jobid;
+                job->deps[job->ndeps].cond = cond;
+                job->ndeps++;
+            }
+        }
+        else if(strncmp(tok, "cache=", val - tok) == 0)
+        {
+            /* anything describing the job's inputs, such as a checksum */
+            if(*val == '\0')
+            {
+                printf("Invalid cache fingerprint.\n");
+                FREE(job->deps);
+                FREE(job);
+                return -EINVAL;
+            }
+
+            job->fingerprint = val;
+            job->fplen = strlen(val);
+        }
+        else if(strncmp(tok, "stdin=", val - tok) == 0)
+        {
+            /* the only source there is, see client_input() */
+            if(strcmp(val, "pipe") != 0)
+            {
+                printf("Invalid stdin '%s', expected pipe.\n", val);
+                FREE(job->deps);
+                FREE(job);
+                return -EINVAL;
+            }
+
+            job->input = 1;
+        }
+        else if(strncmp(tok, "output=", val - tok) == 0)
+        {
+            if(strcmp(val, "files") == 0)
+                job->output = OUTPUT_FILES;
+            else if(strcmp(val, "capture") == 0)
+                job->output = OUTPUT_CAPTURE;
+            else if(strcmp(val, "discard") == 0)
+                job->output = OUTPUT_DISCARD;
+            else
+            {
+                printf("Invalid output '%s', expected files, capture or "
+                       "discard.\n", val);
+                FREE(job->deps);
+                FREE(job);
+                return -EINVAL;
+            }
+        }
+        else if(strncmp(tok, "maxout=", val - tok) == 0)
+        {
+            job->maxout = strtoull(val, &endp, 10);
+            if(*endp != '\0' || endp == val || job->maxout < 1)
+            {
+                printf("Invalid output limit.\n");
+                FREE(job->deps);
+                FREE(job);
+                return -EINVAL;
+            }
+        }
+        else if(strncmp(tok, "array=", val - tok) == 0)
+        {
+            /* lo-hi, optionally followed by %cap */
+            long lo = strtol(val, &endp, 10), hi = -1, cap = 0;
+            if(*endp == '-')
+                hi = strtol(endp + 1, &endp, 10);
+            if(*endp == '%')
+                cap = strtol(endp + 1, &endp, 10);
+            if(*endp != '\0' || lo < 0 || hi < lo || hi > UINT32_MAX - 1 ||
+               cap < 0)
+            {
+                printf("Invalid array \'%s\', expected lo-hi[%%cap].\n", val);
+                FREE(job->deps);
+                FREE(job);
+                return -EINVAL;
+            }
+
+            job->array_lo = lo;
+            job->ntasks = hi - lo + 1;
+            job->array_cap = cap;
+        }
+        else
+        {
+            printf("Unknown submit option \'%s\'.\n", tok);
+            FREE(job->deps);
+            FREE(job);
+            return -EINVAL;
+        }
+
+        tok = strtok_r(NULL, " ", &saveptr);
+    }
+
+    /* extract maxcpu */
+    if(!tok) { FREE(job->deps); FREE(job); return -EINVAL; }
     job->maxcpu = strtol(tok, NULL, 10);
     debug("maxcpu: %d", job->maxcpu);
 
     /* extract maxmem */
     tok = strtok_r(NULL, " ", &saveptr);
-    if(!tok) { FREE(job); return -EINVAL; }
+    if(!tok) { FREE(job->deps); FREE(job); return -EINVAL; }
     job->maxmem = strtol(tok, NULL, 10);
     debug("maxmem: %d", job->maxmem);
 
     /* extract priority */
     tok = strtok_r(NULL, " ", &saveptr);
-    if(!tok) { FREE(job); return -EINVAL; }
+    if(!tok) { FREE(job->deps); FREE(job); return -EINVAL; }
     job->priority = strtol(tok, NULL, 10);
     debug("priority: %d", job->priority);
 
@@ -135,9 +279,11 @@ int client_submit_job(client_t *client, char *str)
 
     if(send_pkt(client->clientfd, JOB_SUBMIT, job) < 0)
     {
+        FREE(job->deps);
         FREE(job);
         PERROR_EXIT("send_pkt()");
     }
+    FREE(job->deps);
     FREE(job);
 
     int *jobid = NULL;
@@ -197,10 +343,18 @@ int client_get_status(client_t *c, char *str)
     if(res == JOB_STATUS_RESP)
     {
         struct timeval result_tv;
-        timeradd(&s->ru.ru_stime, &s->ru.ru_stime, &result_tv);
+        timeradd(&s->ru.ru_utime, &s->ru.ru_stime, &result_tv);
 
         printf("(%s)", jobs_status_as_char(s->status));
 
+        /* an array reports on its tasks */
+        if(s->status == ARRAY)
+        {
+            printf(" <tasks=%u pending=%u running=%u succeeded=%u failed=%u>",
+                    s->ntasks, s->npending, s->nrunning, s->nsucceeded,
+                    s->nfailed);
+        }
+
         /* completed */
         if(s->status == EXITED)
         {
@@ -212,9 +366,9 @@ int client_get_status(client_t *c, char *str)
         }
 
         /* have ran at least some time */
-        if(s->status == EXITED || s->status == ABORTED || s->status == SUSPENDED)
+        if(JOB_FINISHED(s->status) || s->status == SUSPENDED)
         {
-            printf(" <cputime=%ld.%ld> <maxrss=%ld>",
+            printf(" <cputime=%ld.%06ld> <maxrss=%ld>",
                    result_tv.tv_sec,
                    result_tv.tv_usec,
                    s->ru.ru_maxrss);
@@ -222,6 +376,16 @@ int client_get_status(client_t *c, char *str)
         printf(" <priority=%d> (limits: [cpu=%d] [mem=%d])",
                     s->priority, s->maxcpu, s->maxmem);
 
+        /* where the job was placed, if it was */
+        if(s->cpus[0])
+        {
+            s->cpus[STATUS_CPULEN-1] = '\0';
+            if(s->node >= 0)
+                printf(" <cpus=%s node=%d>", s->cpus, s->node);
+            else
+                printf(" <cpus=%s>", s->cpus);
+        }
+
         /* did the process go over resource limits? */
         struct timeval maxtv;
         maxtv.tv_sec = s->maxcpu;
@@ -518,3 +682,233 @@ client_stderr_end:
     debug("client_stderr() - EXIT");
     return retval;
 }
+
+/**
+ * int client_lines(client_t *, int, int, uint64_t, uint64_t)
+ *
+ * @brief  Retrieves a range of lines of the output of a job from the server,
+ *         and prints just those.
+ *
+ * @param c  The client requesting the lines
+ * @param jobid  The job id to get the lines of
+ * @param stream  0 for its stdout, 1 for its stderr
+ * @param first  The first line, counting from 1, or 0 for the last count lines
+ * @param count  The number of lines
+ *
+ * @return  0 on success, -errno on error
+ **/
+int client_lines(client_t *c, int jobid, int stream, uint64_t first,
+        uint64_t count)
+{
+    debug("client_lines() - ENTER");
+    int retval = 0;
+    lines_t req = { jobid, stream, first, count };
+
+    VALIDATE(c, "client must be non NULL", -EINVAL, client_lines_end);
+
+    send_pkt(c->clientfd, JOB_GET_LINES, &req);
+
+    void *payload = NULL;
+    int res = recv_pkt(c->clientfd, &payload);
+    if(res == JOB_RESULTS)
+    {
+        results_t *r = (results_t *)payload;
+        fwrite(r->results, 1, r->length, stdout);
+        FREE(r->results);
+        FREE(r);
+    }
+    else if(res == NACK)
+    {
+        printf("\rServer returned no such lines for job.\n");
+    }
+    else
+    {
+        debug("UNKNOWN PACKET");
+    }
+
+client_lines_end:
+    debug("client_lines() - EXIT");
+    return retval;
+}
+
+/**
+ * int client_grep(client_t *, grep_t *)
+ *
+ * @brief  Asks the server for the lines of the output of a job matching a
+ *         pattern, and prints them.
+ *
+ * @param c  The client searching
+ * @param req  The search
+ *
+ * @return  0 on success, -errno on error
+ **/
+int client_grep(client_t *c, grep_t *req)
+{
+    debug("client_grep() - ENTER");
+    int retval = 0;
+
+    VALIDATE(c && req, "client and request must be non NULL", -EINVAL,
+            client_grep_end);
+
+    send_pkt(c->clientfd, JOB_GREP, req);
+
+    void *payload = NULL;
+    int res = recv_pkt(c->clientfd, &payload);
+    if(res == JOB_RESULTS)
+    {
+        results_t *r = (results_t *)payload;
+        fwrite(r->results, 1, r->length, stdout);
+        FREE(r->results);
+        FREE(r);
+    }
+    else if(res == NACK)
+    {
+        printf("\rServer found no matching lines for job.\n");
+    }
+    else
+    {
+        debug("UNKNOWN PACKET");
+    }
+
+client_grep_end:
+    debug("client_grep() - EXIT");
+    return retval;
+}
+
+/**
+ * int client_search(client_t *, query_t *)
+ *
+ * @brief  Asks the server where in the output of all of the client's finished
+ *         jobs a string is, and prints the lines it is on.
+ *
+ * @param c  The client searching
+ * @param req  The search
+ *
+ * @return  0 on success, -errno on error
+ **/
+int client_search(client_t *c, query_t *req)
+{
+    debug("client_search() - ENTER");
+    int retval = 0;
+
+    VALIDATE(c && req, "client and request must be non NULL", -EINVAL,
+            client_search_end);
+
+    send_pkt(c->clientfd, JOB_SEARCH, req);
+
+    void *payload = NULL;
+    int res = recv_pkt(c->clientfd, &payload);
+    if(res == JOB_RESULTS)
+    {
+        results_t *r = (results_t *)payload;
+        fwrite(r->results, 1, r->length, stdout);
+        FREE(r->results);
+        FREE(r);
+    }
+    else if(res == NACK)
+    {
+        printf("\rServer found no finished job with matching output.\n");
+    }
+    else
+    {
+        debug("UNKNOWN PACKET");
+    }
+
+client_search_end:
+    debug("client_search() - EXIT");
+    return retval;
+}
+
+/**
+ * int client_input_ack(client_t *)
+ *
+ * @brief  Waits for the server to answer a JOB_INPUT packet, printing any
+ *         updates which arrive first.
+ *
+ * @param c  The client
+ *
+ * @return  ACK, NACK, or -1 if the server went away
+ **/
+static int client_input_ack(client_t *c)
+{
+    void *payload = NULL;
+    int res;
+
+    while((res = recv_pkt(c->clientfd, &payload)) == JOB_UPDATE)
+    {
+        update_t *u = (update_t *)payload;
+        printf("\r[%d] Changed state and is now \'%s\'\n",
+                u->jobid, jobs_status_as_char(u->status));
+        FREE(payload);
+    }
+    FREE(payload);
+
+    return res;
+}
+
+/**
+ * int client_input(client_t *c, int jobid, char *path)
+ *
+ * @brief  Sends a file to the stdin of a job submitted with stdin=pipe, in
+ *         chunks of INPUT_CHUNK bytes, then closes the job's stdin. Each
+ *         chunk waits for the server to take the one before.
+ *
+ * @param c  The client
+ * @param jobid  The job
+ * @param path  The file to send, or "-" for our own stdin
+ *
+ * @return  0 on success, -errno on error.
+ **/
+int client_input(client_t *c, int jobid, char *path)
+{
+    debug("client_input() - ENTER");
+    int retval = 0;
+    int fd = -1, res = ACK;
+    char *buf = NULL;
+    size_t total = 0;
+
+    VALIDATE(c && path, "client and path must be non NULL", -EINVAL,
+            client_input_end);
+
+    fd = (strcmp(path, "-") == 0 ? STDIN_FILENO : open(path, O_RDONLY));
+    if(fd < 0)
+    {
+        printf("Cannot open \'%s\': %s\n", path, strerror(errno));
+        retval = -errno;
+        goto client_input_end;
+    }
+
+    MALLOC(buf, INPUT_CHUNK);
+    input_t in = { jobid, 0, buf };
+    while(1)
+    {
+        ssize_t n = read(fd, buf, INPUT_CHUNK);
+        if(n < 0 && errno == EINTR)
+            continue;
+        if(n < 0)
+        {
+            printf("Failed to read \'%s\': %s\n", path, strerror(errno));
+            n = 0;
+        }
+
+        /* an empty chunk closes the job's stdin */
+        in.length = n;
+        if(send_pkt(c->clientfd, JOB_INPUT, &in) < 0)
+            PERROR_EXIT("send_pkt()");
+        if((res = client_input_ack(c)) != ACK || n == 0)
+            break;
+        total += n;
+    }
+
+    if(res == ACK)
+        printf("[%d] Sent %zu bytes of input.\n", jobid, total);
+    else if(res == NACK)
+        printf("Job does not take input (any more).\n");
+
+client_input_end:
+    if(fd > STDIN_FILENO)
+        close(fd);
+    FREE(buf);
+    debug("client_input() - EXIT");
+    return retval;
+}
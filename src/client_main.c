@@ -40,16 +40,61 @@ char *cmdline = NULL;
 void print_help()
 {
     printf( "Commands:\n"
-"    submit [max_cpu] [max_mem] [pri] [cmd] : Submit a new job to the server,\n"
+"    submit [opts] [max_cpu] [max_mem] [pri] [cmd]\n"
+"                                           : Submit a new job to the server,\n"
 "                                             with the specified resource \n"
 "                                             limitations given by max_cpu and\n"
 "                                             max_mem, running at priority pri\n"
-"                                             by max_cpu and max_mem\n"
+"                                             by max_cpu and max_mem. cmd may be\n"
+"                                             a pipeline, cmd | cmd ... opts\n"
+"                                             are any of:\n"
+"                                               cores=N  cpu cores the job needs\n"
+"                                               walltime=N  expected seconds of\n"
+"                                                 run time, for backfill\n"
+"                                               after=id[,id...]  start after\n"
+"                                                 these jobs exited with 0\n"
+"                                               afterany=id[,id...]  start after\n"
+"                                                 these jobs finished\n"
+"                                               array=lo-hi[%%cap]  one task for\n"
+"                                                 each index, cap at once\n"
+"                                               cache=fp  reuse the output of an\n"
+"                                                 identical job with inputs fp\n"
+"                                               stdin=pipe  its stdin is sent\n"
+"                                                 later, with input\n"
+"                                               output=files|capture|discard\n"
+"                                                 where its output goes\n"
+"                                               maxout=N  bytes of output it\n"
+"                                                 may write\n"
 "    list                                   : List all jobs for client\n"
 "    stdout [jobid]                         : Get the standard output results of\n"
 "                                             the specified completed job\n"
 "    stderr [jobid]                         : Get the standard error results of\n"
 "                                             the specified completed job\n"
+"    lines [jobid] [first] [count] [err]    : Get count lines of the standard\n"
+"                                             output (or error) of the specified\n"
+"                                             completed job, from line first on\n"
+"    tail [jobid] [count] [err]             : Get the last count lines of the\n"
+"                                             standard output (or error) of the\n"
+"                                             specified completed job\n"
+"    grep [jobid] [opts] [pattern]          : Get the numbered lines of the\n"
+"                                             standard output of the specified\n"
+"                                             completed job containing pattern\n"
+"                                             (the rest of the command). opts\n"
+"                                             are any of:\n"
+"                                               -E  pattern is a regex\n"
+"                                               -i  ignore case\n"
+"                                               -A N, -B N, -C N  lines of\n"
+"                                                 context after, before, both\n"
+"                                               -m N  at most N matches\n"
+"                                               -2  search standard error\n"
+"    search [-m N] [string]                 : Get the jobid, stream, line number\n"
+"                                             and offset of the lines of output\n"
+"                                             of all completed jobs containing\n"
+"                                             string (the rest of the command),\n"
+"                                             at most N of them with -m\n"
+"    input [jobid] [file]                   : Sends file (- for the client's\n"
+"                                             stdin) to the stdin of the job,\n"
+"                                             then closes it\n"
 "    status [jobid]                         : Get the status of the job with the\n"
 "                                             specified id\n"
 "    kill [jobid]                           : Terminates the job with the\n"
@@ -223,6 +268,134 @@ skip_client_input:
             goto client_handle_input_end;
         }
     }
+    else if(strncmp(cmd, "lines", strlen(cmd)) == 0 ||
+            strncmp(cmd, "tail", strlen(cmd)) == 0)
+    {
+        /* jobid, then first (not for tail) and count, then maybe err */
+        unsigned long long arg[3] = { 0, 0, 0 };
+        int nargs = (cmd[0] == 'l' ? 3 : 2), stream = 0;
+        char *tok = NULL, *endp = NULL;
+
+        for(int i = 0; i < nargs; i++)
+        {
+            tok = strtok_r(NULL, " ", &saveptr);
+            if(!tok) { res = -EINVAL; goto client_handle_input_end; }
+            arg[i] = strtoull(tok, &endp, 10);
+            if(*endp != '\0' || tok[0] == '-')
+            { res = -EINVAL; goto client_handle_input_end; }
+        }
+        if((tok = strtok_r(NULL, " ", &saveptr)) != NULL)
+        {
+            if(strcmp(tok, "err") != 0)
+            { res = -EINVAL; goto client_handle_input_end; }
+            stream = 1;
+        }
+
+        if(nargs == 2)
+            res = client_lines(c, arg[0], stream, 0, arg[1]);
+        else if(arg[1] > 0)
+            res = client_lines(c, arg[0], stream, arg[1], arg[2]);
+        else
+            res = -EINVAL;
+        if(res < 0)
+        {
+            goto client_handle_input_end;
+        }
+    }
+    else if(strncmp(cmd, "grep", strlen(cmd)) == 0)
+    {
+        char *tok = NULL, *endp = NULL;
+        grep_t req;
+        memset(&req, 0, sizeof(grep_t));
+
+        tok = strtok_r(NULL, " ", &saveptr);
+        if(!tok) { res = -EINVAL; goto client_handle_input_end; }
+        req.jobid = strtol(tok, &endp, 10);
+        if(*endp != '\0')
+        { res = -EINVAL; goto client_handle_input_end; }
+
+        /* options, up to the pattern, which is the rest of the line */
+        while(saveptr && saveptr[0] == '-')
+        {
+            tok = strtok_r(NULL, " ", &saveptr);
+            if(strcmp(tok, "-E") == 0)
+                req.flags |= GREP_REGEX;
+            else if(strcmp(tok, "-i") == 0)
+                req.flags |= GREP_ICASE;
+            else if(strcmp(tok, "-2") == 0)
+                req.stream = 1;
+            else if(strcmp(tok, "-A") == 0 || strcmp(tok, "-B") == 0 ||
+                    strcmp(tok, "-C") == 0 || strcmp(tok, "-m") == 0)
+            {
+                char opt = tok[1];
+                tok = strtok_r(NULL, " ", &saveptr);
+                if(!tok) { res = -EINVAL; goto client_handle_input_end; }
+                long n = strtol(tok, &endp, 10);
+                if(*endp != '\0' || n < 0)
+                { res = -EINVAL; goto client_handle_input_end; }
+
+                if(opt == 'A' || opt == 'C')
+                    req.after = n;
+                if(opt == 'B' || opt == 'C')
+                    req.before = n;
+                if(opt == 'm')
+                    req.maxcount = n;
+            }
+            else
+            { res = -EINVAL; goto client_handle_input_end; }
+        }
+        if(!saveptr || saveptr[0] == '\0')
+        { res = -EINVAL; goto client_handle_input_end; }
+
+        req.pattern = saveptr;
+        req.patlen = strlen(saveptr);
+        if((res = client_grep(c, &req)) < 0)
+        {
+            goto client_handle_input_end;
+        }
+    }
+    else if(strncmp(cmd, "search", strlen(cmd)) == 0)
+    {
+        char *tok = NULL, *endp = NULL;
+        query_t req;
+        memset(&req, 0, sizeof(query_t));
+
+        /* -m N, then the string, which is the rest of the line */
+        if(saveptr && strncmp(saveptr, "-m ", 3) == 0)
+        {
+            strtok_r(NULL, " ", &saveptr);
+            tok = strtok_r(NULL, " ", &saveptr);
+            if(!tok) { res = -EINVAL; goto client_handle_input_end; }
+            long n = strtol(tok, &endp, 10);
+            if(*endp != '\0' || n < 0)
+            { res = -EINVAL; goto client_handle_input_end; }
+            req.maxcount = n;
+        }
+        if(!saveptr || saveptr[0] == '\0')
+        { res = -EINVAL; goto client_handle_input_end; }
+
+        req.pattern = saveptr;
+        req.patlen = strlen(saveptr);
+        if((res = client_search(c, &req)) < 0)
+        {
+            goto client_handle_input_end;
+        }
+    }
+    else if(strncmp(cmd, "input", strlen(cmd)) == 0)
+    {
+        char *tok = NULL, *endp = NULL;
+
+        tok = strtok_r(NULL, " ", &saveptr);
+        if(!tok) { res = -EINVAL; goto client_handle_input_end; }
+        int jobid = strtol(tok, &endp, 10);
+        if(*endp != '\0' || saveptr[0] == '\0')
+        { res = -EINVAL; goto client_handle_input_end; }
+
+        if((res = client_input(c, jobid, saveptr)) < 0)
+        {
+            goto client_handle_input_end;
+        }
+    }
     else if(strncmp(cmd, "stderr", strlen(cmd)) == 0)
     {
         char *endp = NULL;
@@ -0,0 +1,249 @@
+/**
+ * @file depend.c
+ * @author Daniel Calabria
+ *
+ * Dependencies between jobs.
+ *
+ * A job may be submitted with a list of jobs (of the same client) which must
+ * finish before it may start, either successfully (DEP_AFTEROK) or in any way
+ * (DEP_AFTERANY). Until then it is BLOCKED, and sits outside of the ready
+ * queue. Each job keeps the edges to the jobs waiting on it, so that when it
+ * finishes depend_release() can hand every dependent its verdict right away:
+ * the last dependency to be satisfied moves a job to NEW and submits it to the
+ * scheduler, and a failed DEP_AFTEROK dependency aborts the job, which in turn
+ * releases the jobs waiting on it.
+ *
+ * Dependencies can only name jobs which already exist, so the graph can never
+ * contain a cycle.
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "common.h"
+#include "debug.h"
+#include "server.h"
+#include "client.h"
+#include "jobs.h"
+#include "archive.h"
+#include "sched.h"
+#include "depend.h"
+#include "cache.h"
+
+/* jobs which failed a dependency, waiting to be archived. these are handled
+ * by the outermost depend_release(), so a long chain of failures does not
+ * recurse through jobs_archive() and free_job(). */
+static job_t *depend_failed = NULL;
+static int depend_releasing = 0;
+
+/**
+ * int depend_satisfied(uint32_t, uint32_t, int32_t)
+ *
+ * @brief  Determines whether a finished job satisfies a dependency on it.
+ *
+ * @param cond  The kind of dependency
+ * @param status  The state the job finished in
+ * @param exitcode  The job's exit code
+ *
+ * @return  1 if it does, 0 otherwise.
+ **/
+static int depend_satisfied(uint32_t cond, uint32_t status, int32_t exitcode)
+{
+    if(cond == DEP_AFTERANY)
+        return 1;
+
+    return (status == EXITED && exitcode == 0);
+}
+
+/**
+ * int depend_check(client_t *, dependency_t *, uint32_t)
+ *
+ * @brief  Verifies that every dependency of a submission names a job of the
+ *         client, either live or archived.
+ *
+ * @param c  The client submitting the job
+ * @param deps  The dependencies
+ * @param ndeps  The number of dependencies
+ *
+ * @return  0 on success, -errno on failure
+ **/
+int depend_check(client_t *c, dependency_t *deps, uint32_t ndeps)
+{
+    int retval = 0;
+
+    for(uint32_t i = 0; i < ndeps; i++)
+    {
+        VALIDATE(deps[i].cond == DEP_AFTEROK || deps[i].cond == DEP_AFTERANY,
+                "unknown dependency condition", -EINVAL, depend_check_end);
+        VALIDATE(jobs_lookup_by_jobid(c, deps[i].jobid) ||
+                 archive_find(&c->archive, deps[i].jobid) >= 0,
+                "dependency on unknown job", -ENOENT, depend_check_end);
+    }
+
+depend_check_end:
+    return retval;
+}
+
+/**
+ * int depend_attach(client_t *, job_t *, dependency_t *, uint32_t)
+ *
+ * @brief  Records the dependencies of a newly submitted job. Dependencies on
+ *         jobs which already finished are resolved on the spot.
+ *
+ * @param c  The client owning the job
+ * @param job  The job
+ * @param deps  The dependencies, already checked with depend_check()
+ * @param ndeps  The number of dependencies
+ *
+ * @return  The number of jobs the job is waiting on, or -1 if one of its
+ *          dependencies can no longer be satisfied.
+ **/
+int depend_attach(client_t *c, job_t *job, dependency_t *deps, uint32_t ndeps)
+{
+    debug("depend_attach() - ENTER [job @ %p, %u deps]", job, ndeps);
+    int retval = 0;
+
+    for(uint32_t i = 0; i < ndeps; i++)
+    {
+        job_t *pre = jobs_lookup_by_jobid(c, deps[i].jobid);
+        if(!pre || JOB_FINISHED(pre->status))
+        {
+            int idx = archive_find(&c->archive, deps[i].jobid);
+            uint32_t status = (pre ? pre->status : c->archive.status[idx]);
+            int32_t code = (pre ? pre->exitcode : c->archive.exitcode[idx]);
+
+            if(!depend_satisfied(deps[i].cond, status, code))
+            {
+                retval = -1;
+                break;
+            }
+            continue;
+        }
+
+        dep_t *d = NULL;
+        MALLOC(d, sizeof(dep_t));
+        d->pre = pre;
+        d->post = job;
+        d->cond = deps[i].cond;
+        d->next_out = pre->dependents;
+        pre->dependents = d;
+        d->next_in = job->prereqs;
+        job->prereqs = d;
+        job->nwait++;
+    }
+
+    if(retval < 0)
+        depend_detach(job);
+    else
+        retval = job->nwait;
+
+    debug("depend_attach() - EXIT [%d]", retval);
+    return retval;
+}
+
+/**
+ * void depend_detach(job_t *)
+ *
+ * @brief  Forgets the jobs a job is waiting on, for a job which will never
+ *         start.
+ *
+ * @param job  The job
+ **/
+void depend_detach(job_t *job)
+{
+    while(job->prereqs)
+    {
+        dep_t *d = job->prereqs;
+        job->prereqs = d->next_in;
+
+        dep_t **e = &d->pre->dependents;
+        while(*e != d)
+            e = &(*e)->next_out;
+        *e = d->next_out;
+
+        FREE(d);
+    }
+
+    job->nwait = 0;
+}
+
+/**
+ * void depend_release(job_t *)
+ *
+ * @brief  Resolves the dependencies on a job which has finished (or is being
+ *         removed; anything short of EXITED with a zero exit code counts as a
+ *         failure). Jobs whose last dependency is satisfied are submitted to
+ *         the scheduler, and jobs with a failed dependency are aborted and
+ *         archived.
+ *
+ * @param job  The job
+ **/
+void depend_release(job_t *job)
+{
+    if(!job || !job->dependents)
+        return;
+
+    debug("depend_release() - ENTER [job @ %p]", job);
+
+    while(job->dependents)
+    {
+        dep_t *d = job->dependents;
+        job_t *post = d->post;
+        job->dependents = d->next_out;
+
+        dep_t **e = &post->prereqs;
+        while(*e != d)
+            e = &(*e)->next_in;
+        *e = d->next_in;
+        post->nwait--;
+
+        int ok = depend_satisfied(d->cond, job->status, job->exitcode);
+        FREE(d);
+
+        if(post->status != BLOCKED)
+            continue;
+
+        if(!ok)
+        {
+            /* it can never run. it has no signal to report, so it shows up as
+             * aborted by signal 0 */
+            debug("job %u failed a dependency on job %u", post->jobid, job->jobid);
+            depend_detach(post);
+            post->status = ABORTED;
+            post->exitcode = 0;
+            jobs_notify(post);
+            post->qnext = depend_failed;
+            depend_failed = post;
+        }
+        else if(post->nwait == 0)
+        {
+            debug("job %u is no longer blocked", post->jobid);
+            post->status = NEW;
+            jobs_notify(post);
+
+            /* as at submission, an identical job may have done (or be
+             * doing) the work by now */
+            if(sched_refuse(post) || (post->cacheblob && cache_submit(post)))
+                continue;
+            sched_submit(post);
+        }
+    }
+
+    /* archiving a failed job releases the jobs waiting on it */
+    if(!depend_releasing)
+    {
+        depend_releasing = 1;
+        while(depend_failed)
+        {
+            job_t *j = depend_failed;
+            depend_failed = j->qnext;
+            j->qnext = NULL;
+            jobs_archive(j->owner, j);
+        }
+        depend_releasing = 0;
+    }
+
+    debug("depend_release() - EXIT");
+}
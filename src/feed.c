@@ -0,0 +1,315 @@
+/**
+ * @file feed.c
+ * @author Daniel Calabria
+ *
+ * Feeding data from a client into the stdin of a job.
+ *
+ * A job submitted with stdin=pipe gets a pipe for its stdin when it is
+ * submitted, so the client can start sending data before the job runs. The
+ * client sends the data in JOB_INPUT packets of at most INPUT_CHUNK bytes,
+ * each answered with an ACK once all of it is in the pipe (or a NACK if the
+ * job has no stdin any more), and then an empty one to close the pipe.
+ *
+ * The data is moved from the client's socket into the pipe with splice(), so
+ * it is never copied into (or held by) the server. When the pipe is full,
+ * the server waits for the job to read from it before it reads anything else
+ * from that client, which holds the client back until it gets its ACK.
+ **/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+
+#include "common.h"
+#include "debug.h"
+#include "server.h"
+#include "proto.h"
+#include "jobs.h"
+#include "feed.h"
+
+/* cleared for good if the kernel cannot splice() from a socket */
+static int feed_splice = 1;
+
+/**
+ * int feed_open(job_t *)
+ *
+ * @brief  Creates the pipe for the stdin of a job.
+ *
+ * @param job  The job
+ *
+ * @return  0 on success, -errno on failure
+ **/
+int feed_open(job_t *job)
+{
+    debug("feed_open() - ENTER [job @ %p]", job);
+    int retval = 0;
+    int p[2];
+
+    VALIDATE(job, "job must be non NULL", -EINVAL, feed_open_end);
+    VALIDATE(pipe2(p, O_CLOEXEC) == 0, "pipe2() failed", -errno, feed_open_end);
+
+    /* the main loop select()s on the write end while input is pending */
+    if(p[1] >= FD_SETSIZE)
+    {
+        close(p[0]);
+        close(p[1]);
+        retval = -EMFILE;
+        goto feed_open_end;
+    }
+
+    /* the server never waits on a job's stdin. the larger buffer is a best
+     * effort, a smaller one only costs more round trips. */
+    fcntl(p[1], F_SETFL, O_NONBLOCK);
+    fcntl(p[1], F_SETPIPE_SZ, JOBS_PIPE_SIZE);
+
+    job->infd = p[0];
+    job->inwfd = p[1];
+
+feed_open_end:
+    debug("feed_open() - EXIT [%d]", retval);
+    return retval;
+}
+
+/**
+ * void feed_started(job_t *)
+ *
+ * @brief  Called once a job has been started: only the job reads from its
+ *         stdin now.
+ *
+ * @param job  The job
+ **/
+void feed_started(job_t *job)
+{
+    if(job && job->infd >= 0)
+    {
+        close(job->infd);
+        job->infd = -1;
+    }
+}
+
+/**
+ * void feed_shut(job_t *)
+ *
+ * @brief  Closes the server's end of the stdin of a job, so that the job
+ *         reads EOF. Whatever data is still coming for it is dropped.
+ *
+ * @param job  The job
+ **/
+static void feed_shut(job_t *job)
+{
+    if(job->inwfd < 0)
+        return;
+
+    close(job->inwfd);
+    job->inwfd = -1;
+
+    for(conn_t *c = server->connlist; c; c = c->next)
+    {
+        if(c->in_job != job)
+            continue;
+        c->in_job = NULL;
+        c->in_full = 0;
+        c->in_failed = 1;
+    }
+}
+
+/**
+ * void feed_close(job_t *)
+ *
+ * @brief  Closes both ends of the stdin pipe of a job, as it is freed.
+ *
+ * @param job  The job
+ **/
+void feed_close(job_t *job)
+{
+    if(!job)
+        return;
+
+    feed_started(job);
+    feed_shut(job);
+}
+
+/**
+ * int feed_room(int)
+ *
+ * @brief  Determines whether a pipe can take more data. A pipe whose reader
+ *         went away counts, as writing to it fails right away.
+ *
+ * @param fd  The write end of the pipe
+ *
+ * @return  1 if it can, 0 if it is full.
+ **/
+static int feed_room(int fd)
+{
+    struct pollfd pfd = { fd, POLLOUT, 0 };
+
+    return poll(&pfd, 1, 0) != 0;
+}
+
+/**
+ * int feed_begin(conn_t *, input_t *)
+ *
+ * @brief  Handles the header of a JOB_INPUT packet, and forwards as much of
+ *         its data as can be right away.
+ *
+ * @param conn  The connection the packet came from
+ * @param in  The header
+ *
+ * @return  0 on success, -1 if the client went away
+ **/
+int feed_begin(conn_t *conn, input_t *in)
+{
+    debug("feed_begin() - ENTER [jobid %u, %u bytes]", in->jobid, in->length);
+    int retval = 0;
+
+    job_t *job = jobs_lookup_by_jobid(conn->client, in->jobid);
+    if(job && job->inwfd < 0)
+        job = NULL;
+
+    /* the end of the data */
+    if(in->length == 0)
+    {
+        if(job)
+            feed_shut(job);
+        send_pkt(conn->fd, (job ? ACK : NACK), NULL);
+        goto feed_begin_end;
+    }
+
+    conn->in_left = in->length;
+    conn->in_job = job;
+    conn->in_full = 0;
+    conn->in_failed = (job == NULL);
+    retval = feed_forward(conn);
+
+feed_begin_end:
+    debug("feed_begin() - EXIT [%d]", retval);
+    return retval;
+}
+
+/**
+ * int feed_forward(conn_t *)
+ *
+ * @brief  Moves the data of a JOB_INPUT packet from the client's socket into
+ *         the job's stdin, until the pipe is full or there is no more data
+ *         to be read yet. Once it has all been forwarded, the client gets its
+ *         answer.
+ *
+ * @param conn  The connection the packet came from
+ *
+ * @return  0 on success, -1 if the client went away
+ **/
+int feed_forward(conn_t *conn)
+{
+    debug("feed_forward() - ENTER [%u bytes left]", conn->in_left);
+    int retval = 0;
+    char buf[PIPE_BUF];
+
+    while(conn->in_left > 0)
+    {
+        job_t *job = conn->in_job;
+        size_t len = sizeof(buf);
+        ssize_t n;
+
+        if(len > conn->in_left)
+            len = conn->in_left;
+
+        if(!job)
+        {
+            /* nowhere for it to go */
+            n = recv(conn->fd, buf, len, MSG_DONTWAIT);
+        }
+        else if(feed_splice)
+        {
+            n = splice(conn->fd, NULL, job->inwfd, NULL, conn->in_left,
+                    SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            if(n < 0 && errno == EINVAL)
+            {
+                debug("splice() is not supported, copying instead");
+                feed_splice = 0;
+                continue;
+            }
+        }
+        else
+        {
+            /* a write of at most PIPE_BUF bytes either fits or fails, so
+             * never read more than that, nor while the pipe is full */
+            if(!feed_room(job->inwfd))
+            {
+                conn->in_full = 1;
+                goto feed_forward_end;
+            }
+            n = recv(conn->fd, buf, len, MSG_DONTWAIT);
+            if(n > 0 && write(job->inwfd, buf, n) < 0)
+                n = -1;
+        }
+
+        if(n > 0)
+        {
+            conn->in_left -= n;
+            continue;
+        }
+
+        if(n == 0)
+        {
+            retval = -1;
+            goto feed_forward_end;
+        }
+
+        if(errno == EINTR)
+            continue;
+
+        if(errno == EAGAIN)
+        {
+            /* either the pipe is full, or the rest has not arrived yet */
+            conn->in_full = (job && !feed_room(job->inwfd));
+            goto feed_forward_end;
+        }
+
+        /* the job is done reading, the rest is dropped */
+        if(job && errno == EPIPE)
+        {
+            debug("job %d closed its stdin", job->jobid);
+            feed_shut(job);
+            continue;
+        }
+
+        debug("failed to forward input: %s", strerror(errno));
+        retval = -1;
+        goto feed_forward_end;
+    }
+
+    conn->in_job = NULL;
+    conn->in_full = 0;
+    send_pkt(conn->fd, (conn->in_failed ? NACK : ACK), NULL);
+
+feed_forward_end:
+    debug("feed_forward() - EXIT [%d]", retval);
+    return retval;
+}
+
+/**
+ * int feed_waitfd(conn_t *)
+ *
+ * @brief  Tells the main loop what a connection is waiting for: while the
+ *         stdin of the job it is feeding is full, the main loop waits for
+ *         that pipe to become writable instead of reading from the client.
+ *
+ * @param conn  The connection
+ *
+ * @return  The pipe to wait for, or -1 to wait for the client as usual.
+ **/
+int feed_waitfd(conn_t *conn)
+{
+    if(conn->in_left > 0 && conn->in_full && conn->in_job)
+        return conn->in_job->inwfd;
+
+    return -1;
+}
@@ -0,0 +1,242 @@
+/**
+ * @file gc.c
+ * @author Daniel Calabria
+ *
+ * Retention policy for finished jobs.
+ *
+ * Finished jobs (and their output files) normally live in their owner's
+ * archive until the client expunges them. If the server was started with a
+ * retention policy, the collector expunges archived jobs which are older than
+ * the maximum age, beyond the per client limit, or which push the total size
+ * of all kept output files over budget.
+ *
+ * The collector is run from the main loop. Each run does at most GC_SLICE_USEC
+ * worth of work and then yields, picking up where it left off on the next run,
+ * so that a large backlog of expired jobs never stalls client requests.
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+
+#include "common.h"
+#include "debug.h"
+#include "server.h"
+#include "archive.h"
+#include "gc.h"
+
+/* when the collector last ran */
+static struct timespec gc_last;
+
+/**
+ * long gc_elapsed(struct timespec *)
+ *
+ * @brief  Returns the number of microseconds elapsed since the given time.
+ *
+ * @param since  The starting time, from CLOCK_MONOTONIC
+ *
+ * @return  Microseconds elapsed since `since`.
+ **/
+static long gc_elapsed(struct timespec *since)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec - since->tv_sec) * 1000000L +
+           (now.tv_nsec - since->tv_nsec) / 1000L;
+}
+
+/**
+ * int gc_enabled()
+ *
+ * @brief  Determines whether any retention policy was configured.
+ *
+ * @return  1 if the collector has anything to enforce, 0 otherwise.
+ **/
+int gc_enabled()
+{
+    return server->retain_age > 0 ||
+           server->retain_count > 0 ||
+           server->retain_bytes > 0;
+}
+
+/**
+ * struct timespec* gc_timeout(struct timespec *)
+ *
+ * @brief  Computes how long the main loop may sleep before the collector
+ *         needs to run again.
+ *
+ * @param ts  Storage for the timeout
+ *
+ * @return  ts, or NULL if the main loop may sleep indefinitely.
+ **/
+struct timespec* gc_timeout(struct timespec *ts)
+{
+    if(!gc_enabled())
+        return NULL;
+
+    ts->tv_sec = server->gc_more ? 0 : GC_INTERVAL;
+    ts->tv_nsec = 0;
+    return ts;
+}
+
+/**
+ * int gc_run()
+ *
+ * @brief  Runs one slice of the collector, expunging archived jobs which fall
+ *         outside the retention policy. The slice ends after GC_SLICE_USEC, in
+ *         which case server->gc_more is set and the next run resumes from the
+ *         same client.
+ *
+ * @return  The number of jobs expunged.
+ **/
+int gc_run()
+{
+    int retval = 0;
+    int ops = 0;
+    struct timespec start;
+    client_t *cl = NULL, *first = NULL;
+
+    if(!gc_enabled() || !server->clientlist)
+        return 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if(!server->gc_more && gc_elapsed(&gc_last) < GC_INTERVAL * 1000000L)
+        return 0;
+
+    debug("gc_run() - ENTER");
+    gc_last = start;
+    server->gc_more = 0;
+
+    time_t now = time(NULL);
+
+#define GC_YIELD(n) \
+    if((ops += (n)) >= GC_BATCH) \
+    { \
+        ops = 0; \
+        if(gc_elapsed(&start) >= GC_SLICE_USEC) \
+        { \
+            server->gc_more = 1; \
+            goto gc_run_end; \
+        } \
+    }
+
+    /* per client limits */
+    cl = first = (server->gc_cursor ? server->gc_cursor : server->clientlist);
+    do
+    {
+        archive_t *a = &cl->archive;
+        server->gc_cursor = cl;
+
+        /* lowest jobids were submitted first, so drop those, a batch at a
+         * time */
+        while(server->retain_count > 0 && a->count > server->retain_count)
+        {
+            int n = a->count - server->retain_count;
+            if(n > GC_BATCH)
+                n = GC_BATCH;
+
+            archive_remove_range(a, 0, n, cl->name);
+            retval += n;
+            GC_YIELD(n);
+        }
+
+        if(server->retain_age > 0)
+        {
+            for(uint32_t left = a->count; left > 0 && a->count > 0; )
+            {
+                if(a->gcpos >= a->count)
+                    a->gcpos = 0;
+
+                /* expired entries mostly come in runs, which go together.
+                 * removing them leaves gcpos on the entry after them. */
+                uint32_t n = 0;
+                while(n < GC_BATCH && n < left && a->gcpos + n < a->count &&
+                      a->finished[a->gcpos + n] + server->retain_age <= now)
+                    n++;
+
+                if(n > 0)
+                {
+                    archive_remove_range(a, a->gcpos, n, cl->name);
+                    retval += n;
+                    left -= n;
+                }
+                else
+                {
+                    a->gcpos++;
+                    left--;
+                    n = 1;
+                }
+
+                GC_YIELD(n);
+            }
+        }
+
+        cl = (cl->next ? cl->next : server->clientlist);
+    } while(cl != first);
+
+    /* global budget on output files, evicting the job which finished first
+     * among every client's until we fit */
+    if(server->retain_bytes > 0)
+    {
+        unsigned long long total = 0;
+        for(cl = server->clientlist; cl; cl = cl->next)
+            total += cl->archive.totalbytes;
+
+        while(total > server->retain_bytes)
+        {
+            client_t *victim = NULL;
+            int idx = -1;
+            time_t next = 0;
+            for(cl = server->clientlist; cl; cl = cl->next)
+            {
+                int i = archive_oldest(&cl->archive);
+                if(i < 0)
+                    continue;
+                if(!victim ||
+                   cl->archive.finished[i] < victim->archive.finished[idx])
+                {
+                    if(victim)
+                        next = victim->archive.finished[idx];
+                    victim = cl;
+                    idx = i;
+                }
+                else if(!next || cl->archive.finished[i] < next)
+                    next = cl->archive.finished[i];
+            }
+
+            if(!victim)
+                break;
+
+            /* the victim's entries which finished before any other client's
+             * go along with it, while they are still needed */
+            archive_t *a = &victim->archive;
+            int n = archive_oldest_run(a, idx, next ? next : LONG_MAX,
+                    GC_BATCH);
+            unsigned long long freed = a->bytes[idx];
+            for(int i = 1; i < n; i++)
+            {
+                if(total - freed <= server->retain_bytes)
+                {
+                    n = i;
+                    break;
+                }
+                freed += a->bytes[idx + i];
+            }
+
+            total -= freed;
+            archive_remove_range(a, idx, n, victim->name);
+            retval += n;
+            GC_YIELD(n);
+        }
+    }
+#undef GC_YIELD
+
+gc_run_end:
+    debug("gc_run() - EXIT [%d expunged%s]", retval,
+            server->gc_more ? ", more to do" : "");
+    return retval;
+}
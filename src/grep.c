@@ -0,0 +1,387 @@
+/**
+ * @file grep.c
+ * @author Daniel Calabria
+ *
+ * Searching the output of a finished job on the server.
+ *
+ * A JOB_GREP request carries a pattern, and is answered with just the lines
+ * of one of a job's streams which match it, each prefixed with its line
+ * number like grep -n does: "12:" for a matching line, "11-" for a line of
+ * context around one, and "--" between groups of lines which are not next to
+ * each other. The output is searched where it is kept, see output_map(), so
+ * only the lines found cross the socket.
+ *
+ * A fixed string is searched for with memmem(), which skips through the
+ * output without looking at it line by line; only the newlines between two
+ * matches are counted, with memchr(). Both are vectorized by the C library.
+ * A regular expression (or a string to be matched ignoring case) is tried
+ * on each line in turn with regexec(), copied out of the output to be nul
+ * terminated.
+ **/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <regex.h>
+
+#include "common.h"
+#include "debug.h"
+#include "archive.h"
+#include "output.h"
+#include "grep.h"
+
+/* A search through one stream of a job's output */
+typedef struct grep_scan_s
+{
+    const char *data;
+    uint64_t size;
+
+    int regex;              /* the pattern is in re, not pat */
+    regex_t re;
+    const char *pat;
+    size_t patlen;
+    char *line;             /* the line being matched against re */
+    uint64_t linecap;
+
+    char *out;              /* the lines found */
+    uint64_t len;
+    uint64_t cap;
+    int full;               /* GREP_MAXRESULTS was reached */
+    int nomem;              /* a line or the lines found did not fit */
+} grep_scan_t;
+
+/**
+ * uint64_t grep_nextline(grep_scan_t *, uint64_t)
+ *
+ * @brief  Finds where the line after the one starting at off starts.
+ *
+ * @param s  The search
+ * @param off  The start of a line
+ *
+ * @return  The start of the next line, or the size of the output.
+ **/
+static uint64_t grep_nextline(grep_scan_t *s, uint64_t off)
+{
+    const char *nl = memchr(s->data + off, '\n', s->size - off);
+
+    return (nl ? (uint64_t)(nl - s->data) + 1 : s->size);
+}
+
+/**
+ * uint64_t grep_prevline(grep_scan_t *, uint64_t)
+ *
+ * @brief  Finds where the line before the one starting at off starts.
+ *
+ * @param s  The search
+ * @param off  The start of a line, past the first one
+ *
+ * @return  The start of the previous line.
+ **/
+static uint64_t grep_prevline(grep_scan_t *s, uint64_t off)
+{
+    const char *nl = (off > 1 ? memrchr(s->data, '\n', off - 1) : NULL);
+
+    return (nl ? (uint64_t)(nl - s->data) + 1 : 0);
+}
+
+/**
+ * uint64_t grep_count(grep_scan_t *, uint64_t, uint64_t)
+ *
+ * @brief  Counts the newlines between two offsets.
+ *
+ * @param s  The search
+ * @param from  The first offset
+ * @param to  The offset past the last one
+ *
+ * @return  The number of newlines.
+ **/
+static uint64_t grep_count(grep_scan_t *s, uint64_t from, uint64_t to)
+{
+    const char *p = s->data + from, *end = s->data + to;
+    uint64_t n = 0;
+
+    while(p < end && (p = memchr(p, '\n', end - p)) != NULL)
+    {
+        p++;
+        n++;
+    }
+
+    return n;
+}
+
+/**
+ * long long grep_next(grep_scan_t *, uint64_t)
+ *
+ * @brief  Finds the next line matching the pattern.
+ *
+ * @param s  The search
+ * @param off  The start of the line to search from
+ *
+ * @return  The start of the matching line, or -1 if there is none or the
+ *          line could not be copied out, in which case s->nomem is set.
+ **/
+static long long grep_next(grep_scan_t *s, uint64_t off)
+{
+    if(!s->regex)
+    {
+        const char *m = memmem(s->data + off, s->size - off, s->pat, s->patlen);
+        if(!m)
+            return -1;
+
+        const char *nl = memrchr(s->data + off, '\n', m - (s->data + off));
+        return (nl ? (nl - s->data) + 1 : (long long)off);
+    }
+
+    for(uint64_t ls = off, next; ls < s->size; ls = next)
+    {
+        next = grep_nextline(s, ls);
+
+        /* the output is not nul terminated, so each line is copied out */
+        uint64_t len = next - ls - (s->data[next - 1] == '\n');
+        if(len + 1 > s->linecap)
+        {
+            char *line = realloc(s->line, len + 1);
+            if(!line)
+            {
+                s->nomem = 1;
+                return -1;
+            }
+            s->line = line;
+            s->linecap = len + 1;
+        }
+        memcpy(s->line, s->data + ls, len);
+        s->line[len] = '\0';
+
+        if(regexec(&s->re, s->line, 0, NULL, 0) == 0)
+            return ls;
+    }
+
+    return -1;
+}
+
+/**
+ * int grep_reserve(grep_scan_t *, uint64_t)
+ *
+ * @brief  Makes room for more of the lines found.
+ *
+ * @param s  The search
+ * @param n  The number of bytes to make room for
+ *
+ * @return  0 on success, -1 once GREP_MAXRESULTS is reached, or the lines
+ *          found could not be grown, in which case s->nomem is set too.
+ **/
+static int grep_reserve(grep_scan_t *s, uint64_t n)
+{
+    if(s->full || s->len + n > GREP_MAXRESULTS)
+    {
+        s->full = 1;
+        return -1;
+    }
+
+    if(s->len + n > s->cap)
+    {
+        uint64_t cap = (s->cap ? s->cap : 4096);
+        while(cap < s->len + n)
+            cap *= 2;
+        char *out = realloc(s->out, cap);
+        if(!out)
+        {
+            s->full = s->nomem = 1;
+            return -1;
+        }
+        s->out = out;
+        s->cap = cap;
+    }
+
+    return 0;
+}
+
+/**
+ * void grep_emit(grep_scan_t *, uint64_t, char, uint64_t)
+ *
+ * @brief  Adds a line to the lines found, after its line number and the
+ *         character telling a match from context.
+ *
+ * @param s  The search
+ * @param lineno  The number of the line, counting from 1
+ * @param sep  ':' for a matching line, '-' for context
+ * @param off  The start of the line
+ **/
+static void grep_emit(grep_scan_t *s, uint64_t lineno, char sep, uint64_t off)
+{
+    uint64_t next = grep_nextline(s, off);
+    uint64_t linelen = next - off - (s->data[next - 1] == '\n');
+    char prefix[32];
+    int n = snprintf(prefix, sizeof(prefix), "%llu%c",
+            (unsigned long long)lineno, sep);
+
+    if(grep_reserve(s, n + linelen + 1) < 0)
+        return;
+
+    memcpy(s->out + s->len, prefix, n);
+    memcpy(s->out + s->len + n, s->data + off, linelen);
+    s->out[s->len + n + linelen] = '\n';
+    s->len += n + linelen + 1;
+}
+
+/**
+ * int grep_compile(grep_scan_t *, grep_t *)
+ *
+ * @brief  Gets the pattern of a request ready to be searched for. A fixed
+ *         string matched ignoring case is turned into a regular expression
+ *         matching just that string.
+ *
+ * @param s  The search
+ * @param req  The request
+ *
+ * @return  0 on success, -EINVAL if the pattern is no good
+ **/
+static int grep_compile(grep_scan_t *s, grep_t *req)
+{
+    int retval = 0;
+    char *escaped = NULL;
+    const char *pattern = req->pattern;
+
+    VALIDATE(req->patlen > 0 && strlen(req->pattern) == req->patlen &&
+            !strchr(req->pattern, '\n'), "invalid pattern", -EINVAL,
+            grep_compile_end);
+
+    if(!(req->flags & (GREP_REGEX | GREP_ICASE)))
+    {
+        s->pat = req->pattern;
+        s->patlen = req->patlen;
+        goto grep_compile_end;
+    }
+
+    if(!(req->flags & GREP_REGEX))
+    {
+        MALLOC(escaped, req->patlen * 2 + 1);
+        char *e = escaped;
+        for(const char *p = req->pattern; *p; p++)
+        {
+            if(strchr(".[]{}()\\*+?^$|", *p))
+                *e++ = '\\';
+            *e++ = *p;
+        }
+        pattern = escaped;
+    }
+
+    int flags = REG_EXTENDED | REG_NOSUB | REG_NEWLINE;
+    if(req->flags & GREP_ICASE)
+        flags |= REG_ICASE;
+    VALIDATE(regcomp(&s->re, pattern, flags) == 0, "invalid regular expression",
+            -EINVAL, grep_compile_end);
+    s->regex = 1;
+
+grep_compile_end:
+    FREE(escaped);
+    return retval;
+}
+
+/**
+ * int grep_serve(conn_t *, grep_t *)
+ *
+ * @brief  Answers a JOB_GREP request, with a JOB_RESULTS packet holding the
+ *         lines found, or a NACK if the job has not finished, the pattern is
+ *         no good, nothing matched it or the search ran out of memory. Once
+ *         GREP_MAXRESULTS bytes of lines were found, the rest are left out.
+ *
+ * @param conn  The connection the request came from
+ * @param req  The request
+ *
+ * @return  0 on success, -errno on failure
+ **/
+int grep_serve(conn_t *conn, grep_t *req)
+{
+    debug("grep_serve() - ENTER [jobid %u, stream %u, flags %#x]",
+            req->jobid, req->stream, req->flags);
+    int retval = 0;
+    grep_scan_t s;
+    outmap_t m = { NULL, 0, NULL };
+    uint64_t matches = 0;
+
+    memset(&s, 0, sizeof(grep_scan_t));
+
+    /* finished jobs all live in the archive */
+    int idx = archive_find(&conn->client->archive, req->jobid);
+    VALIDATE(idx >= 0, "job has not finished", -ENOENT, grep_serve_end);
+    VALIDATE(req->stream < 2, "invalid stream", -EINVAL, grep_serve_end);
+    if((retval = grep_compile(&s, req)) < 0 ||
+       (retval = output_map(conn->client, idx, req->stream, &m)) < 0)
+        goto grep_serve_end;
+    s.data = m.data;
+    s.size = m.size;
+
+    /* lines before done (line doneline) have been sent or skipped, and the
+     * search goes on from scan (line scanline) */
+    uint64_t done = 0, doneline = 1, scan = 0, scanline = 1, after = 0;
+    while(!s.full && (req->maxcount == 0 || matches < req->maxcount))
+    {
+        long long ls = grep_next(&s, scan);
+        if(ls < 0)
+            break;
+        uint64_t ln = scanline + grep_count(&s, scan, ls);
+
+        /* context after the previous match */
+        for(; after > 0 && doneline < ln; after--, doneline++)
+        {
+            grep_emit(&s, doneline, '-', done);
+            done = grep_nextline(&s, done);
+        }
+
+        /* context before this one, skipping the lines too far back */
+        if(ln - doneline > req->before)
+        {
+            if(matches > 0 && (req->before > 0 || req->after > 0) &&
+               grep_reserve(&s, 3) == 0)
+            {
+                memcpy(s.out + s.len, "--\n", 3);
+                s.len += 3;
+            }
+            done = ls;
+            for(uint32_t i = 0; i < req->before; i++)
+                done = grep_prevline(&s, done);
+            doneline = ln - req->before;
+        }
+        for(; doneline < ln; doneline++)
+        {
+            grep_emit(&s, doneline, '-', done);
+            done = grep_nextline(&s, done);
+        }
+
+        grep_emit(&s, ln, ':', ls);
+        done = scan = grep_nextline(&s, ls);
+        doneline = scanline = ln + 1;
+        after = req->after;
+        matches++;
+    }
+
+    /* context after the last match */
+    for(; after > 0 && done < s.size; after--, doneline++)
+    {
+        grep_emit(&s, doneline, '-', done);
+        done = grep_nextline(&s, done);
+    }
+
+    /* partial results are no answer to a search which ran out of memory */
+    VALIDATE(!s.nomem, "out of memory", -ENOMEM, grep_serve_end);
+    VALIDATE(s.len > 0, "nothing matched", -ENOENT, grep_serve_end);
+
+grep_serve_end:
+    if(conn->client->connected)
+    {
+        results_t results = { s.len, s.out };
+        send_pkt(conn->fd, (retval == 0 ? JOB_RESULTS : NACK),
+                (retval == 0 ? &results : NULL));
+    }
+    output_unmap(&m);
+    if(s.regex)
+        regfree(&s.re);
+    FREE(s.out);
+    FREE(s.line);
+    debug("grep_serve() - EXIT [%d, %llu matches]", retval,
+            (unsigned long long)matches);
+    return retval;
+}
@@ -16,8 +16,10 @@
 #include <sys/resource.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <signal.h>
 #include <errno.h>
 #include <limits.h>
+#include <time.h>
 
 #include "common.h"
 #include "server.h"
@@ -27,85 +29,220 @@
 #include "jobs.h"
 #include "client.h"
 #include "parse.h"
+#include "sched.h"
+#include "place.h"
+#include "cgroup.h"
+#include "depend.h"
+#include "array.h"
+#include "spawn.h"
+#include "launcher.h"
+#include "cache.h"
+#include "feed.h"
+#include "output.h"
+#include "spool.h"
+
+/* give up on launching a job, leaving the reason for exec_job() to report */
+#define LAUNCH_FAIL(l, e, step) \
+    { \
+        (l)->err = (e); \
+        (l)->what = (step); \
+        if((l)->errfd >= 0) \
+            write((l)->errfd, (l), sizeof(launch_t)); \
+        _exit(EXIT_FAILURE); \
+    }
 
 /**
- * void launch_child(command_t *, int )
- *
- * @brief  Actually launches a child process.
+ * void launch_pipeline(launch_t *)
  *
- * @param cmd  The command to launch
- * @param pgid  The process group id this should be bound to
- * @param foreground  1 if this should be run in the foreground, 0 if background
+ * @brief  Runs the stages of a pipeline in the job's process group, each
+ *         one's stdout connected to the next one's stdin, and waits for them.
+ *         This runs in a child with memory of its own, see spawn_copy(), once
+ *         the job's stdin, stdout and stderr are in place. It stands for the
+ *         job: its rusage covers every stage, and it exits as the last stage
+ *         did.
  *
- * @return  This function never returns.
+ * @param l  The launch_t of the job to launch
  **/
-static void launch_child(command_t *cmd, int pgid, int foreground, job_t *j)
+static void launch_pipeline(launch_t *l)
 {
-    debug("launch_child() - ENTER [cmd @ %p]", cmd);
+    job_t *j = l->job;
+    char **argv = j->argv;
+    int infd = -1, status = 0;
+    pid_t last = -1, pid;
 
-    pid_t pid;
+    /* signals stay blocked here, as they are in the server: signalling the
+     * job's process group reaches the stages, and this waits to mirror them */
 
-    if(!cmd)
+    /* nothing else the server had open is ours to hold on to, such as the
+     * stdin of other jobs, which would then never see EOF */
+    close_range(STDERR_FILENO + 1, ~0U, 0);
+
+    for(uint32_t i = 0; i < j->nstages; i++)
     {
-        error("cmd must be non-NULL!");
-        exit(EXIT_FAILURE);
-    }
+        int p[2] = { -1, -1 };
 
-    pid = getpid();
-    if(pgid == 0)
-        pgid = pid;
-    setpgid(pid, pgid);
+        if(i + 1 < j->nstages)
+        {
+            if(pipe2(p, O_CLOEXEC) < 0)
+                goto launch_pipeline_fail;
+            /* a best effort, a smaller pipe only costs context switches */
+            fcntl(p[1], F_SETPIPE_SZ, JOBS_PIPE_SIZE);
+        }
+
+        if((pid = fork()) < 0)
+            goto launch_pipeline_fail;
+
+        if(pid == 0)
+        {
+            if((infd >= 0 && dup2(infd, STDIN_FILENO) < 0) ||
+               (p[1] >= 0 && dup2(p[1], STDOUT_FILENO) < 0))
+                _exit(EXIT_FAILURE);
+
+            spawn_signals();
+            execvpe(argv[0], argv, j->envp);
+            dprintf(STDERR_FILENO, "%s: %s\n", argv[0], strerror(errno));
+            _exit(127);
+        }
 
-    /* build argv array */
-    int argc = 0;
-    char **argv = NULL;
-    char *executable = NULL;
+        if(infd >= 0)
+            close(infd);
+        if(p[1] >= 0)
+            close(p[1]);
+        infd = p[0];
+        last = pid;
 
-    /* count number of arguments */
-    component_t *c = cmd->components;
-    while(c)
+        while(*argv)
+            argv++;
+        argv++;
+    }
+
+    int res;
+    while((pid = wait(&res)) > 0 || errno == EINTR)
     {
-        argc++;
-        c = c->next;
+        if(pid == last)
+            status = res;
     }
 
-    argv = malloc(sizeof(char *) * (argc+1));
-    if(!argv)
+    if(WIFSIGNALED(status))
     {
-        error("malloc() failed to allocate memory for argv array");
-        exit(EXIT_FAILURE);
+        struct sigaction sa;
+        sigset_t mask;
+
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = SIG_DFL;
+        sigaction(WTERMSIG(status), &sa, NULL);
+        sigemptyset(&mask);
+        sigaddset(&mask, WTERMSIG(status));
+        sigprocmask(SIG_UNBLOCK, &mask, NULL);
+        raise(WTERMSIG(status));
+        _exit(128 + WTERMSIG(status));
     }
-    memset(argv, 0, sizeof(char *) * (argc+1));
+    _exit(WEXITSTATUS(status));
+
+launch_pipeline_fail:
+    /* take down whichever stages did start */
+    dprintf(STDERR_FILENO, "pipeline: %s\n", strerror(errno));
+    kill(0, SIGKILL);
+    _exit(EXIT_FAILURE);
+}
 
-    c = cmd->components;
-    argv[0] = c->component;
+/**
+ * int launch_child(void *)
+ *
+ * @brief  Actually launches a child process. This runs in the child created
+ *         by spawn(), within the memory of the server (or of the launcher,
+ *         see launcher.c), so nothing here allocates, prints or touches the
+ *         job; failures are handed back through the launch_t instead. A
+ *         pipeline is started from spawn_copy() instead, see
+ *         launch_pipeline(), and so is any job when clone() is not
+ *         available, see launch_spawn().
+ *
+ * @param arg  The launch_t of the job to launch
+ *
+ * @return  This function never returns.
+ **/
+int launch_child(void *arg)
+{
+    launch_t *l = (launch_t *)arg;
+    job_t *j = l->job;
+    int res = 0;
 
-    c = c->next;
+    /* set up resource limits. in a cgroup, cpu time is limited for the
+     * job as a whole by cgroup_poll(), and memory by memory.max. */
+    if((res = cgroup_enter(j)) < 0)
+        LAUNCH_FAIL(l, -res, "cgroup_enter()");
 
-    for(int i = 1; i < argc; i++, c = c->next)
+    struct rlimit rlim;
+    if(!j->cgpath)
     {
-        /* debug("comp is %s", c->component); */
-        argv[i] = c->component;
+        rlim.rlim_cur = j->maxcpu;
+        rlim.rlim_max = j->maxcpu;
+        if(setrlimit(RLIMIT_CPU, &rlim) < 0)
+            LAUNCH_FAIL(l, errno, "setrlimit()");
     }
-    executable = argv[0];
 
-    debug("RUNNING: %s (pid=%d)", cmd->command, pid);
+    if(!j->cgpath || !server->cg_memory)
+    {
+        rlim.rlim_cur = j->maxmem;
+        rlim.rlim_max = j->maxmem;
+        if(setrlimit(RLIMIT_AS, &rlim) < 0)
+            LAUNCH_FAIL(l, errno, "setrlimit()");
+    }
 
-    /* open output files and dup2() then over for the process */
-    if(!j->stdoutfile || !j->stderrfile)
+    /* output written straight into files is limited by the kernel, which
+     * kills the job with SIGXFSZ. captured output is counted by the
+     * server instead, see output.c */
+    if(j->maxout > 0 && j->outfd[0] < 0 && j->outmode != OUTPUT_DISCARD)
     {
-        debug("incorrect job file settings");
-        goto launch_child_end;
+        rlim.rlim_cur = j->maxout;
+        rlim.rlim_max = j->maxout;
+        if(setrlimit(RLIMIT_FSIZE, &rlim) < 0)
+            LAUNCH_FAIL(l, errno, "setrlimit()");
     }
 
+    /* set priority */
+    setpriority(PRIO_PROCESS, 0, j->priority);
+
+    /* pin to the cpus the job was placed on */
+    if((res = place_apply(j)) < 0)
+        LAUNCH_FAIL(l, -res, "place_apply()");
+
+    setpgid(0, 0);
+
+    /* argv/envp were built when the job was submitted, see
+     * jobs_build_launch(). nothing between spawn() and exec() allocates. */
+    if(!j->argv || !j->argv[0] || !j->stdoutfile || !j->stderrfile)
+        LAUNCH_FAIL(l, EINVAL, "launch_child()");
+
+    /* the client feeds its stdin, see feed.c */
+    if(j->infd >= 0 && dup2(j->infd, STDIN_FILENO) < 0)
+        LAUNCH_FAIL(l, errno, "dup2()");
+
+    /* open output files and dup2() then over for the process. captured
+     * output goes through pipes instead, see output.c */
     int outfd = -1, errfd = -1;
 
+    if(j->outfd[0] >= 0)
+    {
+        outfd = j->outfd[0];
+        errfd = j->outfd[1];
+        goto outfd_ready;
+    }
+
+    if(j->outmode == OUTPUT_DISCARD)
+    {
+        if((outfd = open("/dev/null", O_WRONLY)) < 0 ||
+           (errfd = open("/dev/null", O_WRONLY)) < 0)
+            LAUNCH_FAIL(l, errno, "open()");
+        goto outfd_ready;
+    }
+
 outfd_create:
     if((outfd = creat(j->stdoutfile, S_IRUSR | S_IWUSR)) < 0)
     {
         if(errno == EINTR)
             goto outfd_create;
-        PERROR_EXIT("creat()");
+        LAUNCH_FAIL(l, errno, "creat()");
     }
 
 errfd_create:
@@ -113,29 +250,75 @@ errfd_create:
     {
         if(errno == EINTR)
             goto errfd_create;
-        PERROR_EXIT("creat()");
+        LAUNCH_FAIL(l, errno, "creat()");
     }
 
-    if(dup2(outfd, STDOUT_FILENO) < 0)
-        PERROR_EXIT("dup2()");
-    if(close(outfd) < 0)
-        PERROR_EXIT("close()");
-    if(dup2(errfd, STDERR_FILENO) < 0)
-        PERROR_EXIT("dup2()");
-    if(close(errfd) < 0)
-        PERROR_EXIT("close()");
+outfd_ready:
+    if(dup2(outfd, STDOUT_FILENO) < 0 || close(outfd) < 0 ||
+       dup2(errfd, STDERR_FILENO) < 0 || close(errfd) < 0)
+        LAUNCH_FAIL(l, errno, "dup2()");
+
+    if(j->nstages > 1)
+        launch_pipeline(l);
+
+    /* the server runs with every signal blocked, which the job would
+     * otherwise inherit across exec() */
+    spawn_signals();
 
     /* execvp searches through PATHs so we don't have to */
-    debug("executing");
-    if(execvpe(executable, argv, j->envp) == -1)
+    execvpe(j->argv[0], j->argv, j->envp);
+    LAUNCH_FAIL(l, errno, "execvpe()");
+}
+
+/**
+ * pid_t launch_spawn(launch_t *, int)
+ *
+ * @brief  Starts the child which launches a job, see launch_child(), and
+ *         waits for it to exec, or to start the stages of its pipeline. A
+ *         child which does not share our memory (a pipeline's, or any child
+ *         if spawn() had to fork()) cannot hand back its failure through the
+ *         launch_t, so the child also writes it into a pipe, which exec()
+ *         closes.
+ *
+ * @param l  The launch_t of the job, holding the failure once this returns
+ * @param flags  Additional clone flags, such as CLONE_PARENT, or 0
+ *
+ * @return  The pid of the child, or -errno on failure.
+ **/
+pid_t launch_spawn(launch_t *l, int flags)
+{
+    int p[2] = { -1, -1 };
+    pid_t pid;
+
+    /* without the pipe, only a child sharing our memory reports failures */
+    if(pipe2(p, O_CLOEXEC) < 0)
+        debug("pipe2() failed: %s", strerror(errno));
+    l->errfd = p[1];
+
+    pid = l->job->nstages > 1 ? spawn_copy(launch_child, l, flags) :
+                                spawn(launch_child, l, flags);
+
+    if(p[1] >= 0)
+        close(p[1]);
+    l->errfd = -1;
+    if(p[0] < 0)
+        return pid;
+
+    if(pid > 0)
     {
-        error("%s", strerror(errno));
-        exit(EXIT_FAILURE);
+        launch_t res;
+        ssize_t n;
+        while((n = read(p[0], &res, sizeof(launch_t))) < 0 && errno == EINTR)
+            ;
+        if(n == sizeof(launch_t))
+        {
+            l->err = res.err;
+            l->what = res.what;
+        }
     }
+    close(p[0]);
 
-launch_child_end:
-    /* shouldn't get here?? */
-    exit(EXIT_FAILURE);
+    return pid;
 }
 
 /**
@@ -272,7 +455,7 @@ int exec_job(client_t *c, job_t *job)
     debug("%d / %d jobs", server->numjobs, server->maxjobs);
     VALIDATE(server->numjobs < server->maxjobs,
             "no room to start another job",
-            0,
+            -1,
             exec_job_end);
 
     command_t *cmd = job->ui->commands;
@@ -281,64 +464,87 @@ int exec_job(client_t *c, job_t *job)
             -1,
             exec_job_end);
 
-    pid_t ppid = fork();
+    /* take the job's share of the budgets (and its cpus) before spawning, so
+     * that the child knows where to run */
+    sched_acquire(job);
+    if(server->cgroot && cgroup_create(job) < 0)
+        error("failed to create cgroup for job, falling back to rlimits");
 
-    if(ppid < 0)
-    {
-        error("fork() failed to spawn child process: %s", strerror(errno));
-        exit(EXIT_FAILURE);
-    }
-    if(ppid == 0)
-    {
-        /* child */
-        job->pgid = ppid;
-
-        /* set up resource limits */
-        struct rlimit rlim;
-        rlim.rlim_cur = job->maxcpu;
-        rlim.rlim_max = job->maxcpu;
-        if(setrlimit(RLIMIT_CPU, &rlim) < 0)
-            PERROR_EXIT("setrlimit()");
+    /* captured output needs its pipes before the job starts */
+    if(job->outmode == OUTPUT_CAPTURE && output_open(job) < 0)
+        error("failed to capture the output of job %d, using files",
+                job->jobid);
 
-        rlim.rlim_cur = job->maxmem;
-        rlim.rlim_max = job->maxmem;
-        if(setrlimit(RLIMIT_AS, &rlim) < 0)
-            PERROR_EXIT("setrlimit()");
-
-        /* set priority */
-        setpriority(PRIO_PROCESS, job->pgid, job->priority);
-
-        /* launch child */
-        launch_child(cmd, job->pgid, 0, job);
-    }
-    else
+    /* the launcher starts it while we carry on, and tells us its pid later.
+     * without one, the child shares our memory until it execs, see spawn.c */
+    if(launcher_launch(job) < 0)
     {
-        /* parent */
-        job->pgid = ppid;
+        launch_t l = { job, 0, NULL, -1 };
+        pid_t ppid = launch_spawn(&l, 0);
 
-        /* if(interactive) */
+        if(ppid < 0)
         {
-            setpgid(ppid, ppid);
+            error("failed to spawn child process: %s", strerror(-ppid));
+            exit(EXIT_FAILURE);
         }
+
+        /* it exits instead, and is reaped as a failed job */
+        if(l.err)
+            error("failed to launch job %d: %s: %s", job->jobid, l.what,
+                    strerror(l.err));
+
+        job->pgid = ppid;
+        setpgid(ppid, ppid);
     }
 
-    server->numjobs++;
+    /* the child (or the launcher) has its own copy of its stdin (and its
+     * output pipes) by now */
+    feed_started(job);
+    output_started(job);
+
+    job->started = time(NULL);
+    sched_occupy(job);
     run_in_background(job, 0);
 
     /* send an update packet to the client */
-    conn_t *conn = conn_find_by_client(c);
-    if(!conn)
-        goto exec_job_end;
+    jobs_notify(job);
+
+    /* the next task of its array takes its place in the queue */
+    array_started(job);
+
+exec_job_end:
+    debug("exec_job() - EXIT [%d]", retval);
+    return retval;
+}
+
+/**
+ * int jobs_notify(job_t *)
+ *
+ * @brief  Sends a JOB_UPDATE packet with the job's current status to the
+ *         client which owns it, if that client is connected.
+ *
+ * @param job  The job which changed state
+ *
+ * @return  0 on success, -errno on failure
+ **/
+int jobs_notify(job_t *job)
+{
+    int retval = 0;
+
+    VALIDATE(job, "job must be non NULL", -EINVAL, jobs_notify_end);
+
+    conn_t *conn = conn_find_by_client(job->owner);
+    if(!conn || !conn->client || !conn->client->connected)
+        goto jobs_notify_end;
 
     update_t *u = NULL;
     MALLOC(u, sizeof(update_t));
     u->jobid = job->jobid;
     u->status = job->status;
-    send_pkt(conn->fd, JOB_UPDATE, u);
+    retval = send_pkt(conn->fd, JOB_UPDATE, u);
     FREE(u);
 
-exec_job_end:
-    debug("exec_job() - EXIT [%d]", retval);
+jobs_notify_end:
     return retval;
 }
 
@@ -412,11 +618,31 @@ int free_job(job_t *job)
             -EINVAL,
             free_job_end);
 
+    /* a job removed while it still runs will never be reaped as one of ours,
+     * so give back what it was holding now */
+    sched_remove(job);
+    sched_release(job);
+    sched_vacate(job);
+    launcher_drop(job);
+    cgroup_destroy(job);
+
+    /* as can identical jobs waiting for its result, which run instead */
+    cache_detach(job);
+    feed_close(job);
+    output_close(job);
+
+    /* whatever was waiting on it can stop waiting */
+    depend_detach(job);
+    depend_release(job);
+
+    /* as may the next task of its array */
+    array_finished(job);
     free_input(job->ui);
 
-    for(int i = 0; i < job->envpc; i++)
-        FREE(job->envp[i]);
-    FREE(job->envp);
+    /* argv + envp live within the launch block */
+    FREE(job->launch);
+    job->argv = NULL;
+    job->envp = NULL;
     if(job->stdoutfile)
     {
         unlink(job->stdoutfile);
@@ -489,17 +715,104 @@ job_t* jobs_create(user_input_t *ui)
     memset(retval, 0, sizeof(job_t));
 
     retval->ui = ui;
+    retval->infd = -1;
+    retval->inwfd = -1;
+    retval->outmode = OUTPUT_FILES;
+    retval->outfd[0] = retval->outfd[1] = -1;
 
 jobs_create_end:
     debug("jobs_create() - EXIT [%p]", retval);
     return retval;
 }
 
+/**
+ * int jobs_build_launch(job_t *, char **, uint32_t)
+ *
+ * @brief  Builds the argv and envp arrays the job will be exec()'d with. Both
+ *         arrays, along with copies of every string they point to, are packed
+ *         into a single allocation so that the child never has to allocate
+ *         anything between fork() and exec(). Every command of a pipeline
+ *         has an argv of its own, each following the NULL ending the last.
+ *
+ * @param job  The job to build the launch block for. job->ui must be set.
+ * @param envp  The environment to copy
+ * @param envpc  The number of entries in envp
+ *
+ * @return  0 on success, -errno on failure
+ **/
+int jobs_build_launch(job_t *job, char **envp, uint32_t envpc)
+{
+    debug("jobs_build_launch() - ENTER [job @ %p]", job);
+    int retval = 0;
+
+    VALIDATE(job && job->ui && job->ui->commands,
+            "job must be non-NULL and have a command",
+            -EINVAL,
+            jobs_build_launch_end);
+
+    size_t nargv = 0, size = 0;
+    uint32_t nstages = 0;
+
+    for(command_t *cmd = job->ui->commands; cmd; cmd = cmd->next)
+    {
+        nargv += cmd->argc + 1;
+        nstages++;
+        for(int i = 0; i < cmd->argc; i++)
+            size += strlen(cmd->argv[i]) + 1;
+    }
+    for(int i = 0; i < envpc; i++)
+        size += strlen(envp[i]) + 1;
+    size += sizeof(char *) * (nargv + envpc + 1);
+
+    char *block = malloc(size);
+    VALIDATE(block,
+            "malloc() failed to allocate launch block",
+            -ENOMEM,
+            jobs_build_launch_end);
+
+    char **argv = (char **)block;
+    char **env = argv + nargv;
+    char *str = (char *)(env + envpc + 1);
+
+    /* each stage's argv is NULL terminated, and the next one follows it */
+    char **a = argv;
+    for(command_t *cmd = job->ui->commands; cmd; cmd = cmd->next)
+    {
+        for(int i = 0; i < cmd->argc; i++)
+        {
+            size_t len = strlen(cmd->argv[i]) + 1;
+            *a++ = memcpy(str, cmd->argv[i], len);
+            str += len;
+        }
+        *a++ = NULL;
+    }
+
+    for(int i = 0; i < envpc; i++)
+    {
+        size_t len = strlen(envp[i]) + 1;
+        env[i] = memcpy(str, envp[i], len);
+        str += len;
+    }
+    env[envpc] = NULL;
+
+    FREE(job->launch);
+    job->launch = block;
+    job->argv = argv;
+    job->nstages = nstages;
+    job->envp = env;
+    job->envpc = envpc;
+
+jobs_build_launch_end:
+    debug("jobs_build_launch() - EXIT [%d]", retval);
+    return retval;
+}
+
 /**
  * int jobs_insert(client_t *c, job_t *)
  *
  * @brief  Inserts a job into the joblist, and updates the job's jobid to be
  *         1 higher than the previous node's jobid (or 1, for the first job).
+ *         Tasks of a job array keep the jobid reserved for them.
  *
  * @param c  The client who owns the job
  * @param job  The job to insert
@@ -524,22 +837,17 @@ int jobs_insert(client_t *c, job_t *job)
     job->next = NULL;
     job->owner = c;
 
-    /* insert the job into the clients list of jobs */
-    /* empty list? */
-    if(c->jobs == NULL)
-    {
+    /* tasks of an array come with the jobid reserved for them, and go
+     * between the jobs submitted around them */
+    if(!job->array)
         job->jobid = c->numjobs++;
-        c->jobs = job;
-    }
-    else
-    {
-        job_t *j = c->jobs;
-        while(j->next)
-            j = j->next;
 
-        job->jobid = c->numjobs++;
-        j->next = job;
-    }
+    /* insert the job into the clients list of jobs */
+    job_t **jp = &c->jobs;
+    while(*jp && (*jp)->jobid < job->jobid)
+        jp = &(*jp)->next;
+    job->next = *jp;
+    *jp = job;
 
     /* insert the job in the servers list of ALL jobs */
     if(server->joblist == NULL)
@@ -556,18 +864,28 @@ int jobs_insert(client_t *c, job_t *job)
     }
 
 
-    /* set up the output files for the job */
-    char outf[NAME_MAX];
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
+    /* set up the output files for the job. the stamp names them, so no two
+     * jobs may share one, even when created in the same microsecond. */
+    static struct timeval last;
+    char outf[PATH_MAX];
+    gettimeofday(&job->stamp, NULL);
+    if(!timercmp(&job->stamp, &last, >))
+    {
+        struct timeval usec = { 0, 1 };
+        timeradd(&last, &usec, &job->stamp);
+    }
+    last = job->stamp;
+
+    /* the job fails to start if its directory cannot be made */
+    int res = spool_prepare(c, &job->stamp);
+    if(res < 0)
+        error("failed to prepare spool directory: %s", strerror(-res));
 
-    snprintf(outf, NAME_MAX-1, "%s_%ld%ld.out",
-            c->name, tv.tv_sec, tv.tv_usec);
+    jobs_output_path(outf, sizeof(outf), c->name, &job->stamp, "out");
     debug("using \'%s\' for stdout file", outf);
     job->stdoutfile = strdup(outf);
 
-    snprintf(outf, NAME_MAX-1, "%s_%ld%ld.err",
-            c->name, tv.tv_sec, tv.tv_usec);
+    jobs_output_path(outf, sizeof(outf), c->name, &job->stamp, "err");
     debug("using \'%s\' for stderr file", outf);
     job->stderrfile = strdup(outf);
 
@@ -654,6 +972,78 @@ jobs_remove_end:
     return retval;
 }
 
+/**
+ * int jobs_archive(client_t *, job_t *)
+ *
+ * @brief  Moves a finished job into the client's archive, then removes the
+ *         job from the joblists and frees it. The job's output files are
+ *         handed over to the archive rather than deleted.
+ *
+ * @param c  The client which owns the job
+ * @param job  The job to archive. This is freed on success.
+ *
+ * @return  0 on success, -errno on failure
+ **/
+int jobs_archive(client_t *c, job_t *job)
+{
+    debug("jobs_archive() - ENTER [job @ %p]", job);
+    int retval = 0;
+
+    VALIDATE(c, "client must be non NULL", -EINVAL, jobs_archive_end);
+    VALIDATE(job, "job must be non NULL", -EINVAL, jobs_archive_end);
+    VALIDATE(JOB_FINISHED(job->status),
+            "only finished jobs can be archived",
+            -EINVAL,
+            jobs_archive_end);
+
+    if((retval = archive_insert(&c->archive, job)) < 0)
+        goto jobs_archive_end;
+
+    /* the archive owns the output files (and captured output) now */
+    FREE(job->stdoutfile);
+    FREE(job->stderrfile);
+    job->output = NULL;
+
+    retval = jobs_remove(c, job);
+
+jobs_archive_end:
+    debug("jobs_archive() - EXIT [%d]", retval);
+    return retval;
+}
+
+/**
+ * int jobs_output_path(char *, size_t, const char *, const struct timeval *,
+ *                      const char *)
+ *
+ * @brief  Builds the name of an output file for a job, of the form
+ *         `owner_timeofsubmission.ext`, within the job's shard of its spool
+ *         root if the server has any, see spool.c.
+ *
+ * @param buf  Where to store the name
+ * @param size  The size of buf
+ * @param owner  The name of the client which owns the job
+ * @param stamp  The time the job was submitted
+ * @param ext  The extension of the file ("out" or "err")
+ *
+ * @return  0 on success, -errno on failure
+ **/
+int jobs_output_path(char *buf, size_t size, const char *owner,
+        const struct timeval *stamp, const char *ext)
+{
+    uint32_t hash = spool_hash(stamp);
+    const char *root = spool_root(hash);
+    int n;
+
+    if(root)
+        n = snprintf(buf, size, "%s/%s/%02x/%s_%ld%ld.%s", root, owner,
+                hash % SPOOL_SHARDS, owner, stamp->tv_sec, stamp->tv_usec, ext);
+    else
+        n = snprintf(buf, size, "%s_%ld%ld.%s",
+                owner, stamp->tv_sec, stamp->tv_usec, ext);
+
+    return (n < 0 || n >= size) ? -ENAMETOOLONG : 0;
+}
+
 /**
  * job_t* jobs_lookup_by_jobid(client_t *, int)
  *
@@ -721,6 +1111,75 @@ jobs_lookup_by_pid_end:
     return retval;
 }
 
+/**
+ * int jobs_kill(job_t *, int)
+ *
+ * @brief  Sends a signal to a running job. A job in a cgroup is killed as a
+ *         whole, including processes which left its process group.
+ *
+ * @param job  The job to signal
+ * @param sig  The signal to send
+ *
+ * @return  0 on success, -errno on error
+ **/
+int jobs_kill(job_t *job, int sig)
+{
+    int retval = 0;
+
+    VALIDATE(job, "job must be non NULL", -EINVAL, jobs_kill_end);
+    VALIDATE(!JOB_PENDING(job->status), "job has no processes", -ESRCH,
+            jobs_kill_end);
+
+    /* its pid is not known yet, so send it once it is. a kill sticks. */
+    if(job->launchseq)
+    {
+        if(job->pendsig != SIGKILL)
+            job->pendsig = sig;
+        goto jobs_kill_end;
+    }
+
+    if(sig == SIGKILL && job->cgpath && cgroup_kill(job) == 0)
+        goto jobs_kill_end;
+
+    if(killpg(job->pgid, sig) < 0)
+        retval = -errno;
+
+jobs_kill_end:
+    return retval;
+}
+
+/**
+ * int jobs_abort(job_t *, int)
+ *
+ * @brief  Aborts a job which has not started yet, so that it never does. The
+ *         job is archived, and thus freed.
+ *
+ * @param job  The pending job
+ * @param sig  The signal which aborted it, reported as its exit code
+ *
+ * @return  0 on success, -errno on error
+ **/
+int jobs_abort(job_t *job, int sig)
+{
+    debug("jobs_abort() - ENTER [job @ %p]", job);
+    int retval = 0;
+
+    VALIDATE(job, "job must be non NULL", -EINVAL, jobs_abort_end);
+    VALIDATE(JOB_PENDING(job->status), "job has already started", -EINVAL,
+            jobs_abort_end);
+
+    sched_remove(job);
+    depend_detach(job);
+    job->status = ABORTED;
+    job->exitcode = sig;
+    jobs_notify(job);
+    retval = jobs_archive(job->owner, job);
+
+jobs_abort_end:
+    debug("jobs_abort() - EXIT [%d]", retval);
+    return retval;
+}
+
 /**
  * int cancel_all_jobs(client_t *)
  *
@@ -736,6 +1195,10 @@ int cancel_all_jobs(client_t *c)
 
     VALIDATE(c, "client must be non NULL", -EINVAL, cancel_all_jobs_end);
 
+    /* no more tasks get created for the jobs being torn down */
+    for(array_t *a = c->arrays; a; a = a->next_array)
+        array_cancel(a);
+
     job_t *j = c->jobs;
     while(j)
     {
@@ -743,10 +1206,10 @@ int cancel_all_jobs(client_t *c)
         {
             /* kill it without prejudice */
             debug("canceling job with pid=%d", j->pgid);
-            killpg(j->pgid, SIGKILL);
+            jobs_kill(j, SIGKILL);
             j->status = CANCELED;
         }
-        else if(j->status == NEW)
+        else if(JOB_PENDING(j->status))
             j->status = ABORTED;
 
         j = j->next;
@@ -834,7 +1297,7 @@ int print_job(job_t *j)
             -EINVAL,
             print_job_end);
 
-    if(j->status != EXITED && j->status != ABORTED)
+    if(!JOB_FINISHED(j->status))
     {
         if(dprintf(STDOUT_FILENO, "[%d] (%s) %s\n",
                     j->jobid, jobs_status_as_char(j->status), j->ui->input) < 0)
@@ -882,7 +1345,7 @@ int jobs_list(client_t *c)
                 "print_job() failed to output job information",
                 -1,
                 jobs_list_end);
-        if(j->status == EXITED || j->status == ABORTED)
+        if(JOB_FINISHED(j->status))
         {
             job_t *jn = j->next;
             jobs_remove(c, j);
@@ -928,6 +1391,15 @@ char* jobs_status_as_char(int status)
         case CANCELED:
             return "canceled";
 
+        case BLOCKED:
+            return "blocked";
+
+        case ARRAY:
+            return "array";
+
+        case QUOTA:
+            return "quota";
+
         default:
             return NULL;
     }
@@ -0,0 +1,723 @@
+/**
+ * @file launcher.c
+ * @author Daniel Calabria
+ *
+ * A helper process which starts jobs on behalf of the server.
+ *
+ * Even with spawn(), the server itself is held up while each child sets up
+ * the job's limits and output files, and the cost of creating the child still
+ * grows with the server's memory. Instead, launcher_init() forks a launcher
+ * at startup, while the server is still small, and connects the two with a
+ * socketpair. exec_job() sends the launcher a request holding everything the
+ * child needs (limits, cpus, cgroup, output files, argv and envp, along with
+ * the pipe for its stdin if it has one) and carries on with other clients;
+ * the launcher spawns the child and answers with its pid, which
+ * launcher_poll() picks up from the main loop.
+ *
+ * The launcher creates the children with CLONE_PARENT, so that they are
+ * children of the server and are reaped by it like any other job. A job may
+ * thus stop or exit before the server learns its pid, in which case its
+ * wait4() status is stashed until the answer arrives; signals sent to a job
+ * in the meantime are held back until then as well (see jobs_kill()).
+ *
+ * Should the launcher not start, or go away, jobs are started by the server
+ * with spawn() as before, and the jobs it was still launching are failed.
+ **/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include "common.h"
+#include "debug.h"
+#include "server.h"
+#include "jobs.h"
+#include "spawn.h"
+#include "launcher.h"
+#include "output.h"
+
+/* the server's end of the socketpair, and the launcher at the other end */
+static int launcher_fd = -1;
+static pid_t launcher_pid = -1;
+
+static uint32_t launcher_seq = 0;       /* last request sent */
+static int launcher_inflight = 0;       /* requests not answered yet */
+static int launcher_closing = 0;        /* the server is shutting down */
+static lstash_t *launcher_stash = NULL;
+
+/* the jobs requests were sent for, hashed by their seq */
+static job_t *launcher_jobs[LAUNCHER_HASH];
+
+/* requests are built (and, in the launcher, received) here */
+static uint32_t launcher_buf[LAUNCHER_MAXMSG / sizeof(uint32_t)];
+
+/**
+ * char* launcher_string(char **, char *)
+ *
+ * @brief  Takes the next nul terminated string from a request.
+ *
+ * @param p  The position within the request, advanced past the string
+ * @param end  The end of the request
+ *
+ * @return  The string, or NULL if the request ends before it does.
+ **/
+static char* launcher_string(char **p, char *end)
+{
+    char *s = *p;
+    char *nul = memchr(s, '\0', end - s);
+    if(!nul)
+        return NULL;
+
+    *p = nul + 1;
+    return s;
+}
+
+/**
+ * void launcher_start(char *, size_t, lrep_t *)
+ *
+ * @brief  Runs in the launcher: unpacks a request into a job of its own and
+ *         starts the job with launch_child(), as a child of the server.
+ *
+ * @param buf  The request
+ * @param len  The length of the request
+ * @param fds  The fds which came with the request: the job's stdin, then its
+ *             stdout and stderr pipes, as far as the request has them
+ * @param nfds  The number of fds
+ * @param rep  The answer to fill in
+ **/
+static void launcher_start(char *buf, size_t len, int *fds, int nfds,
+        lrep_t *rep)
+{
+    lreq_t req;
+    job_t job;
+    char *p = buf + sizeof(lreq_t), *end = buf + len;
+    char **argv = NULL;
+
+    memset(&job, 0, sizeof(job_t));
+    rep->pid = -EINVAL;
+
+    if(len < sizeof(lreq_t))
+        return;
+    memcpy(&req, buf, sizeof(lreq_t));
+    if(nfds != ((req.flags & LREQ_STDIN) ? 1 : 0) +
+                ((req.flags & LREQ_CAPTURE) ? 2 : 0))
+        return;
+    rep->seq = req.seq;
+
+    job.maxcpu = req.maxcpu;
+    job.maxmem = req.maxmem;
+    job.maxout = req.maxout;
+    job.priority = req.priority;
+    job.cores = req.cores;
+    job.node = req.node;
+    job.infd = ((req.flags & LREQ_STDIN) ? *fds++ : -1);
+    job.outfd[0] = ((req.flags & LREQ_CAPTURE) ? fds[0] : -1);
+    job.outfd[1] = ((req.flags & LREQ_CAPTURE) ? fds[1] : -1);
+    job.outmode = ((req.flags & LREQ_DISCARD) ? OUTPUT_DISCARD : OUTPUT_FILES);
+
+    /* the request starts on a word boundary, and so do the cpus */
+    if(req.flags & LREQ_CPUS)
+    {
+        if(req.cores > (end - p) / sizeof(int))
+            return;
+        job.cpus = (int *)p;
+        p += req.cores * sizeof(int);
+    }
+
+    if((req.flags & LREQ_CGROUP) && !(job.cgpath = launcher_string(&p, end)))
+        return;
+    if(!(job.stdoutfile = launcher_string(&p, end)) ||
+       !(job.stderrfile = launcher_string(&p, end)))
+        return;
+
+    /* every string takes at least a byte, which bounds argc and envc */
+    if(req.argc == 0 || req.argc > end - p || req.envc > end - p)
+        return;
+
+    MALLOC(argv, sizeof(char *) * (req.argc + req.envc + 2));
+    job.argv = argv;
+    job.nstages = 1;
+    job.envp = argv + req.argc + 1;
+    job.envpc = req.envc;
+    for(uint32_t i = 0; i < req.argc + req.envc; i++)
+    {
+        char *s = launcher_string(&p, end);
+        if(!s)
+            goto launcher_start_end;
+        if(i >= req.argc)
+            argv[i + 1] = s;
+        else if(*s)
+            argv[i] = s;
+        else
+            job.nstages++;      /* MALLOC() zeroed it, ending a stage */
+    }
+
+    launch_t l = { &job, 0, NULL, -1 };
+    rep->pid = launch_spawn(&l, CLONE_PARENT);
+    rep->err = l.err;
+    if(l.what)
+        strncpy(rep->what, l.what, LAUNCHER_WHAT - 1);
+
+launcher_start_end:
+    FREE(argv);
+}
+
+/**
+ * void launcher_main(int)
+ *
+ * @brief  The launcher: answers requests from the server until the server
+ *         closes its end of the socketpair.
+ *
+ * @param fd  The launcher's end of the socketpair
+ **/
+static void launcher_main(int fd)
+{
+    char *buf = (char *)launcher_buf;
+    char cbuf[CMSG_SPACE(sizeof(int) * LAUNCHER_MAXFDS)];
+    struct iovec iov = { buf, LAUNCHER_MAXMSG };
+    struct msghdr msg;
+    ssize_t n;
+
+    /* keep out of the way of ^C meant for the server */
+    setpgid(0, 0);
+
+    while(1)
+    {
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = cbuf;
+        msg.msg_controllen = sizeof(cbuf);
+
+        if((n = recvmsg(fd, &msg, MSG_CMSG_CLOEXEC)) < 0 && errno == EINTR)
+            continue;
+        if(n <= 0)
+            break;
+
+        /* the job's stdin and output pipes, which the child dup2()s before
+         * we close them */
+        int fds[LAUNCHER_MAXFDS], nfds = 0;
+        struct cmsghdr *cm = CMSG_FIRSTHDR(&msg);
+        if(cm && cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_RIGHTS)
+        {
+            nfds = (cm->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            memcpy(fds, CMSG_DATA(cm), sizeof(int) * nfds);
+        }
+
+        lrep_t rep;
+        memset(&rep, 0, sizeof(lrep_t));
+        launcher_start(buf, n, fds, nfds, &rep);
+        for(int i = 0; i < nfds; i++)
+            close(fds[i]);
+
+        while(send(fd, &rep, sizeof(lrep_t), MSG_NOSIGNAL) < 0 && errno == EINTR)
+            ;
+    }
+
+    _exit(EXIT_SUCCESS);
+}
+
+/**
+ * int launcher_init()
+ *
+ * @brief  Forks the launcher. This should be done as early as possible, while
+ *         the server is small, but after the options which affect how jobs
+ *         are launched have been seen.
+ *
+ * @return  0 on success, -errno on failure
+ **/
+int launcher_init()
+{
+    debug("launcher_init() - ENTER");
+    int retval = 0;
+    int sv[2];
+
+    VALIDATE(socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) == 0,
+            "socketpair() failed", -errno, launcher_init_end);
+
+    /* or the launcher would print whatever we have buffered as well */
+    fflush(NULL);
+
+    pid_t pid = fork();
+    if(pid == 0)
+    {
+        close(sv[0]);
+        launcher_main(sv[1]);
+    }
+
+    if(pid < 0)
+    {
+        retval = -errno;
+        close(sv[0]);
+    }
+    else
+    {
+        launcher_fd = sv[0];
+        launcher_pid = pid;
+    }
+    close(sv[1]);
+
+launcher_init_end:
+    debug("launcher_init() - EXIT [%d]", retval);
+    return retval;
+}
+
+/**
+ * int launcher_socket()
+ *
+ * @brief  Returns the socket the launcher answers on, for the main loop to
+ *         watch.
+ *
+ * @return  The socket, or -1 if there is no launcher.
+ **/
+int launcher_socket()
+{
+    return launcher_fd;
+}
+
+/**
+ * int launcher_launch(job_t *)
+ *
+ * @brief  Asks the launcher to start a job. The job's pid is filled in by
+ *         launcher_poll() once the launcher answers.
+ *
+ * @param job  The job, which has acquired its cpus and cgroup already
+ *
+ * @return  0 on success, -errno if the job has to be started some other way
+ **/
+int launcher_launch(job_t *job)
+{
+    debug("launcher_launch() - ENTER [job @ %p]", job);
+    int retval = 0;
+    char *buf = (char *)launcher_buf;
+
+    VALIDATE(launcher_fd >= 0, "no launcher", -ENOTCONN, launcher_launch_end);
+    VALIDATE(job && job->argv && job->stdoutfile && job->stderrfile,
+            "job cannot be launched", -EINVAL, launcher_launch_end);
+
+    lreq_t req;
+    memset(&req, 0, sizeof(lreq_t));
+    req.maxcpu = job->maxcpu;
+    req.maxmem = job->maxmem;
+    req.maxout = job->maxout;
+    req.priority = job->priority;
+    req.cores = job->cores;
+    req.node = job->node;
+
+    size_t len = sizeof(lreq_t);
+    if(job->cpus)
+    {
+        req.flags |= LREQ_CPUS;
+        len += job->cores * sizeof(int);
+    }
+    if(job->cgpath)
+    {
+        req.flags |= LREQ_CGROUP;
+        len += strlen(job->cgpath) + 1;
+    }
+    int fds[LAUNCHER_MAXFDS], nfds = 0;
+    if(job->infd >= 0)
+    {
+        req.flags |= LREQ_STDIN;
+        fds[nfds++] = job->infd;
+    }
+    if(job->outfd[0] >= 0)
+    {
+        req.flags |= LREQ_CAPTURE;
+        fds[nfds++] = job->outfd[0];
+        fds[nfds++] = job->outfd[1];
+    }
+    if(job->outmode == OUTPUT_DISCARD)
+        req.flags |= LREQ_DISCARD;
+    len += strlen(job->stdoutfile) + 1 + strlen(job->stderrfile) + 1;
+    char **a = job->argv;
+    for(uint32_t i = 0; i < job->nstages; i++, a++)
+    {
+        for(; *a; a++, req.argc++)
+            len += strlen(*a) + 1;
+    }
+    /* the empty strings between the stages */
+    req.argc += job->nstages - 1;
+    len += job->nstages - 1;
+    for(char **e = job->envp; e && *e; e++, req.envc++)
+        len += strlen(*e) + 1;
+
+    VALIDATE(len <= LAUNCHER_MAXMSG, "launch request is too large", -E2BIG,
+            launcher_launch_end);
+
+    if(++launcher_seq == 0)
+        launcher_seq = 1;
+    req.seq = launcher_seq;
+
+    char *p = buf;
+    memcpy(p, &req, sizeof(lreq_t));
+    p += sizeof(lreq_t);
+    if(job->cpus)
+    {
+        memcpy(p, job->cpus, job->cores * sizeof(int));
+        p += job->cores * sizeof(int);
+    }
+#define PUT(s) \
+    { \
+        size_t l = strlen(s) + 1; \
+        memcpy(p, (s), l); \
+        p += l; \
+    }
+    if(job->cgpath)
+        PUT(job->cgpath);
+    PUT(job->stdoutfile);
+    PUT(job->stderrfile);
+    a = job->argv;
+    for(uint32_t i = 0; i < job->nstages; i++, a++)
+    {
+        if(i > 0)
+            PUT("");
+        for(; *a; a++)
+            PUT(*a);
+    }
+    for(char **e = job->envp; e && *e; e++)
+        PUT(*e);
+#undef PUT
+
+    /* the job's stdin and output pipes are handed over along with the
+     * request */
+    char cbuf[CMSG_SPACE(sizeof(int) * LAUNCHER_MAXFDS)];
+    struct iovec iov = { buf, len };
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    if(nfds > 0)
+    {
+        memset(cbuf, 0, sizeof(cbuf));
+        msg.msg_control = cbuf;
+        msg.msg_controllen = CMSG_SPACE(sizeof(int) * nfds);
+
+        struct cmsghdr *cm = CMSG_FIRSTHDR(&msg);
+        cm->cmsg_level = SOL_SOCKET;
+        cm->cmsg_type = SCM_RIGHTS;
+        cm->cmsg_len = CMSG_LEN(sizeof(int) * nfds);
+        memcpy(CMSG_DATA(cm), fds, sizeof(int) * nfds);
+    }
+
+    /* never wait on a launcher which is backed up, start the job ourselves */
+    VALIDATE(sendmsg(launcher_fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL) >= 0,
+            "failed to send launch request", -errno, launcher_launch_end);
+
+    job->pgid = 0;
+    job->launchseq = req.seq;
+    job->pendsig = 0;
+    job->lnext = launcher_jobs[req.seq % LAUNCHER_HASH];
+    launcher_jobs[req.seq % LAUNCHER_HASH] = job;
+    launcher_inflight++;
+
+launcher_launch_end:
+    debug("launcher_launch() - EXIT [%d]", retval);
+    return retval;
+}
+
+/**
+ * job_t* launcher_job(uint32_t)
+ *
+ * @brief  Finds the job a request was sent for, and takes it off the jobs
+ *         being launched.
+ *
+ * @param seq  The request
+ *
+ * @return  The job, or NULL if it has gone away.
+ **/
+static job_t* launcher_job(uint32_t seq)
+{
+    job_t **jp = &launcher_jobs[seq % LAUNCHER_HASH];
+    while(*jp && (*jp)->launchseq != seq)
+        jp = &(*jp)->lnext;
+
+    job_t *j = *jp;
+    if(j)
+    {
+        *jp = j->lnext;
+        j->lnext = NULL;
+        j->launchseq = 0;
+    }
+
+    return j;
+}
+
+/**
+ * void launcher_drop(job_t *)
+ *
+ * @brief  Forgets about a job which goes away while it is being launched. The
+ *         launcher's answer for it then finds no job, and the job's process
+ *         is killed.
+ *
+ * @param job  The job
+ **/
+void launcher_drop(job_t *job)
+{
+    if(job && job->launchseq)
+        launcher_job(job->launchseq);
+}
+
+/**
+ * void launcher_settle(job_t *, int, struct rusage *)
+ *
+ * @brief  Applies a wait4() status to a job the launcher was starting. While
+ *         shutting down only the job's status is updated, so that
+ *         wait_for_all() does not wait on it, and nothing new is started.
+ *
+ * @param j  The job
+ * @param status  The status from wait4()
+ * @param ru  The rusage from wait4()
+ **/
+static void launcher_settle(job_t *j, int status, struct rusage *ru)
+{
+    if(!launcher_closing)
+    {
+        server_reap(j, status, ru);
+        return;
+    }
+
+    memcpy(&j->ru, ru, sizeof(struct rusage));
+    job_update_status(j, status);
+}
+
+/**
+ * void launcher_forget()
+ *
+ * @brief  Drops every stashed status once no more answers are expected; they
+ *         belong to jobs which went away while being launched.
+ **/
+static void launcher_forget()
+{
+    while(launcher_stash)
+    {
+        lstash_t *s = launcher_stash->next;
+        FREE(launcher_stash);
+        launcher_stash = s;
+    }
+}
+
+/**
+ * void launcher_lost()
+ *
+ * @brief  The launcher went away. Jobs are started by the server from now
+ *         on, and those the launcher had not answered for are failed, as if
+ *         they could not be launched.
+ **/
+static void launcher_lost()
+{
+    struct rusage ru;
+    job_t *j;
+
+    if(launcher_fd < 0)
+        return;
+
+    close(launcher_fd);
+    launcher_fd = -1;
+    if(!launcher_closing)
+        error("job launcher went away, starting jobs from the server");
+
+    memset(&ru, 0, sizeof(struct rusage));
+    for(int i = 0; i < LAUNCHER_HASH; i++)
+    {
+        while((j = launcher_jobs[i]) != NULL)
+        {
+            launcher_job(j->launchseq);
+            launcher_settle(j, W_EXITCODE(EXIT_FAILURE, 0), &ru);
+        }
+    }
+
+    launcher_inflight = 0;
+    launcher_forget();
+}
+
+/**
+ * void launcher_done(lrep_t *)
+ *
+ * @brief  Handles the launcher's answer to a request: the job learns its pid,
+ *         and receives whatever happened to it in the meantime.
+ *
+ * @param rep  The answer
+ **/
+static void launcher_done(lrep_t *rep)
+{
+    struct rusage ru;
+    job_t *j = launcher_job(rep->seq);
+
+    launcher_inflight--;
+
+    /* the job puts itself in a process group of its own, but may not have
+     * got that far yet, so killpg() could miss it. it was started with
+     * CLONE_PARENT, which makes it our child, not the launcher's. */
+    if(rep->pid > 0)
+        setpgid(rep->pid, rep->pid);
+
+    /* it was removed while being launched, so nobody wants it anymore */
+    if(!j)
+    {
+        if(rep->pid > 0 && !rep->err)
+            killpg(rep->pid, SIGKILL);
+        goto launcher_done_end;
+    }
+
+    if(rep->pid < 0)
+    {
+        error("failed to spawn child process for job %d: %s", j->jobid,
+                strerror(-rep->pid));
+        memset(&ru, 0, sizeof(struct rusage));
+        launcher_settle(j, W_EXITCODE(EXIT_FAILURE, 0), &ru);
+        goto launcher_done_end;
+    }
+
+    /* it exits instead, and is reaped as a failed job */
+    if(rep->err)
+        error("failed to launch job %d: %s: %s", j->jobid, rep->what,
+                strerror(rep->err));
+
+    j->pgid = rep->pid;
+    if(!rep->err)
+    {
+        /* its priority may have been changed since the request was sent */
+        setpriority(PRIO_PGRP, j->pgid, j->priority);
+        if(j->pendsig)
+            jobs_kill(j, j->pendsig);
+    }
+    j->pendsig = 0;
+
+    /* in the order they were reaped; the job is gone once it finishes */
+    lstash_t **sp = &launcher_stash;
+    while(*sp)
+    {
+        lstash_t *s = *sp;
+        if(s->pid != rep->pid)
+        {
+            sp = &s->next;
+            continue;
+        }
+
+        *sp = s->next;
+        int finished = (WIFEXITED(s->status) || WIFSIGNALED(s->status));
+        launcher_settle(j, s->status, &s->ru);
+        FREE(s);
+        if(finished)
+            break;
+    }
+
+launcher_done_end:
+    if(launcher_inflight <= 0)
+    {
+        launcher_inflight = 0;
+        launcher_forget();
+    }
+}
+
+/**
+ * int launcher_poll()
+ *
+ * @brief  Handles the answers the launcher has sent. While shutting down,
+ *         waits for every answer instead.
+ *
+ * @return  The number of answers handled.
+ **/
+int launcher_poll()
+{
+    int retval = 0;
+    lrep_t rep;
+    ssize_t n;
+
+    while(launcher_fd >= 0)
+    {
+        n = recv(launcher_fd, &rep, sizeof(lrep_t),
+                launcher_closing ? 0 : MSG_DONTWAIT);
+        if(n < 0 && errno == EINTR)
+            continue;
+        if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+        if(n <= 0)
+        {
+            launcher_lost();
+            break;
+        }
+
+        if(n == sizeof(lrep_t))
+        {
+            launcher_done(&rep);
+            retval++;
+        }
+    }
+
+    return retval;
+}
+
+/**
+ * int launcher_reaped(pid_t, int, struct rusage *)
+ *
+ * @brief  Called for a pid reaped by the server which belongs to none of its
+ *         jobs. That is either the launcher, or possibly a job the launcher
+ *         has not answered for yet, whose status is kept for launcher_done().
+ *
+ * @param pid  The pid
+ * @param status  The status from wait4()
+ * @param ru  The rusage from wait4()
+ *
+ * @return  1 if the pid was taken care of, 0 otherwise.
+ **/
+int launcher_reaped(pid_t pid, int status, struct rusage *ru)
+{
+    if(pid == launcher_pid)
+    {
+        launcher_pid = -1;
+        launcher_lost();
+        return 1;
+    }
+
+    if(launcher_inflight <= 0)
+        return 0;
+
+    lstash_t *s = NULL, **sp = &launcher_stash;
+    MALLOC(s, sizeof(lstash_t));
+    s->pid = pid;
+    s->status = status;
+    memcpy(&s->ru, ru, sizeof(struct rusage));
+    while(*sp)
+        sp = &(*sp)->next;
+    *sp = s;
+
+    return 1;
+}
+
+/**
+ * void launcher_shutdown()
+ *
+ * @brief  Waits for the launcher to answer every request, so that all jobs
+ *         know their pids, and then for the launcher to exit.
+ **/
+void launcher_shutdown()
+{
+    debug("launcher_shutdown() - ENTER");
+    launcher_closing = 1;
+
+    if(launcher_fd >= 0)
+    {
+        /* the launcher exits after answering what it has been sent */
+        shutdown(launcher_fd, SHUT_WR);
+        launcher_poll();
+    }
+
+    if(launcher_pid > 0)
+    {
+        while(waitpid(launcher_pid, NULL, 0) < 0 && errno == EINTR)
+            ;
+        launcher_pid = -1;
+    }
+
+    launcher_forget();
+    debug("launcher_shutdown() - EXIT");
+}
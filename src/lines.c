@@ -0,0 +1,192 @@
+/**
+ * @file lines.c
+ * @author Daniel Calabria
+ *
+ * Serving ranges of lines of a finished job's output.
+ *
+ * A JOB_GET_LINES request asks for count lines of one of a job's streams,
+ * starting at line first (counting from 1), or for its last count lines. To
+ * find them, the server indexes the output the first time it is asked for
+ * lines of it: one scan with memchr(), which the C library vectorizes, notes
+ * the offset of every LINES_STRIDE'th line. The index stays with the job's
+ * archive entry, so later requests only scan the at most LINES_STRIDE lines
+ * between a mark and the line they start (or end) at. Finished output does
+ * not change, except when something the job left running appends to its
+ * output files, so an index is only rebuilt if the size of the output does
+ * not match the size it was built for.
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "common.h"
+#include "debug.h"
+#include "archive.h"
+#include "jobs.h"
+#include "output.h"
+#include "lines.h"
+
+/**
+ * int lines_build(lineidx_t *, const char *, uint64_t)
+ *
+ * @brief  Indexes the lines of some output.
+ *
+ * @param idx  The index, whose previous marks are dropped
+ * @param data  The output
+ * @param size  Its size
+ *
+ * @return  0 on success, -errno on failure
+ **/
+static int lines_build(lineidx_t *idx, const char *data, uint64_t size)
+{
+    debug("lines_build() - ENTER [%llu bytes]", (unsigned long long)size);
+    int retval = 0;
+    const char *p = data, *end = data + size;
+    uint64_t n = 0, cap = 16;
+
+    FREE(idx->marks);
+    memset(idx, 0, sizeof(lineidx_t));
+    MALLOC(idx->marks, sizeof(uint64_t) * cap);
+
+    /* line 0 starts at 0, and a mark follows every LINES_STRIDE'th newline
+     * which is not the last byte */
+    idx->marks[idx->nmarks++] = 0;
+    while(p < end && (p = memchr(p, '\n', end - p)) != NULL)
+    {
+        p++;
+        if(++n % LINES_STRIDE != 0 || p == end)
+            continue;
+
+        if(idx->nmarks == cap)
+        {
+            uint64_t *marks = realloc(idx->marks, sizeof(uint64_t) * cap * 2);
+            if(!marks)
+            {
+                FREE(idx->marks);
+                idx->nmarks = 0;
+                retval = -ENOMEM;
+                goto lines_build_end;
+            }
+            idx->marks = marks;
+            cap *= 2;
+        }
+        idx->marks[idx->nmarks++] = p - data;
+    }
+
+    idx->size = size;
+    idx->nlines = n + (size > 0 && data[size - 1] != '\n');
+
+lines_build_end:
+    debug("lines_build() - EXIT [%llu lines]", (unsigned long long)idx->nlines);
+    return retval;
+}
+
+/**
+ * uint64_t lines_offset(lineidx_t *, const char *, uint64_t)
+ *
+ * @brief  Finds where a line starts.
+ *
+ * @param idx  The index of the output
+ * @param data  The output
+ * @param line  The line, counting from 0
+ *
+ * @return  The offset of the line, or the size of the output for a line past
+ *          its last one.
+ **/
+static uint64_t lines_offset(lineidx_t *idx, const char *data, uint64_t line)
+{
+    if(line >= idx->nlines)
+        return idx->size;
+
+    const char *p = data + idx->marks[line / LINES_STRIDE];
+    const char *end = data + idx->size;
+    for(uint64_t n = line % LINES_STRIDE; n > 0; n--)
+        p = (const char *)memchr(p, '\n', end - p) + 1;
+
+    return p - data;
+}
+
+/**
+ * int lines_serve(conn_t *, lines_t *)
+ *
+ * @brief  Answers a JOB_GET_LINES request, with a JOB_RESULTS packet holding
+ *         just the lines asked for, or a NACK if the job has not finished or
+ *         has no such lines.
+ *
+ * @param conn  The connection the request came from
+ * @param req  The request
+ *
+ * @return  0 on success, -errno on failure
+ **/
+int lines_serve(conn_t *conn, lines_t *req)
+{
+    debug("lines_serve() - ENTER [jobid %u, stream %u, first %llu, count %llu]",
+            req->jobid, req->stream, (unsigned long long)req->first,
+            (unsigned long long)req->count);
+    int retval = 0;
+    archive_t *a = &conn->client->archive;
+    results_t results = { 0, NULL };
+    outmap_t m = { NULL, 0, NULL };
+    int k = req->stream;
+
+    /* finished jobs all live in the archive */
+    int idx = archive_find(a, req->jobid);
+    VALIDATE(idx >= 0, "job has not finished", -ENOENT, lines_serve_end);
+    VALIDATE(k == 0 || k == 1, "invalid stream", -EINVAL, lines_serve_end);
+    VALIDATE(req->count > 0, "no lines asked for", -EINVAL, lines_serve_end);
+
+    if((retval = output_map(conn->client, idx, k, &m)) < 0)
+        goto lines_serve_end;
+
+    if(!a->lines[idx])
+        MALLOC(a->lines[idx], sizeof(lineidx_t) * 2);
+    if(a->lines[idx][k].size != m.size || !a->lines[idx][k].marks)
+    {
+        VALIDATE(lines_build(&a->lines[idx][k], m.data, m.size) == 0,
+                "failed to index output", -ENOMEM, lines_serve_end);
+    }
+
+    lineidx_t *li = &a->lines[idx][k];
+    uint64_t first, last;
+    if(req->first == 0)
+        first = (li->nlines > req->count ? li->nlines - req->count : 0);
+    else
+        first = req->first - 1;
+    VALIDATE(first < li->nlines, "no such lines", -ENOENT, lines_serve_end);
+    last = (req->count > li->nlines - first ? li->nlines : first + req->count);
+
+    uint64_t from = lines_offset(li, m.data, first);
+    uint64_t to = lines_offset(li, m.data, last);
+    VALIDATE(to - from <= UINT32_MAX, "lines do not fit in one packet",
+            -EFBIG, lines_serve_end);
+
+    results.length = to - from;
+    results.results = (char *)m.data + from;
+
+lines_serve_end:
+    if(conn->client->connected)
+        send_pkt(conn->fd, (retval == 0 ? JOB_RESULTS : NACK),
+                (retval == 0 ? &results : NULL));
+    output_unmap(&m);
+    debug("lines_serve() - EXIT [%d]", retval);
+    return retval;
+}
+
+/**
+ * void lines_free(lineidx_t *)
+ *
+ * @brief  Releases the line indexes of both streams of a job.
+ *
+ * @param idx  The indexes, which may be NULL
+ **/
+void lines_free(lineidx_t *idx)
+{
+    if(!idx)
+        return;
+
+    for(int i = 0; i < 2; i++)
+        FREE(idx[i].marks);
+    free(idx);
+}
@@ -0,0 +1,605 @@
+/**
+ * @file output.c
+ * @author Daniel Calabria
+ *
+ * Capturing the output of jobs in the server's memory.
+ *
+ * A job normally writes its stdout and stderr straight into its two output
+ * files, which are created for every job, even one which prints nothing. A
+ * job whose output is captured writes into pipes instead, which the main loop
+ * reads from. Up to server->spill bytes of each stream are kept in memory;
+ * past that, the stream is spilled: what was kept is written to the stream's
+ * usual output file, and the rest is spliced from the pipe straight into it.
+ * A job whose output is discarded writes to /dev/null, and has neither.
+ *
+ * The pipes are only made as the job starts, and closed as it is reaped,
+ * after reading whatever is left in them. What was kept then stays with the
+ * job's entry in its owner's archive, see archive.c.
+ *
+ * A job which writes more than its maxout bytes is killed, and ends up in the
+ * QUOTA state; whatever it wrote past its limit is dropped. Jobs writing into
+ * their output files are held to the same limit by RLIMIT_FSIZE instead. A
+ * client whose kept output has reached the server's quota has its new jobs
+ * end up in the QUOTA state without running.
+ **/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "common.h"
+#include "debug.h"
+#include "server.h"
+#include "jobs.h"
+#include "client.h"
+#include "output.h"
+
+/* the outputs still being collected */
+static output_t *outputs = NULL;
+
+/* cleared for good if the kernel cannot splice() into the output files */
+static int output_splice = 1;
+
+/**
+ * void output_unlink(output_t *)
+ *
+ * @brief  Takes an output off the list of those being collected.
+ *
+ * @param o  The output
+ **/
+static void output_unlink(output_t *o)
+{
+    output_t **op = &outputs;
+    while(*op && *op != o)
+        op = &(*op)->next;
+    if(*op)
+        *op = o->next;
+    o->next = NULL;
+}
+
+/**
+ * void output_shut(outbuf_t *)
+ *
+ * @brief  Closes a stream's pipe, and its output file if it spilled.
+ *
+ * @param b  The stream
+ **/
+static void output_shut(outbuf_t *b)
+{
+    if(b->fd >= 0)
+        close(b->fd);
+    if(b->filefd >= 0)
+        close(b->filefd);
+    b->fd = b->filefd = -1;
+}
+
+/**
+ * int output_open(job_t *)
+ *
+ * @brief  Makes the pipes a job's output is captured through, as the job is
+ *         about to start. On failure, the job writes to its output files.
+ *
+ * @param job  The job, whose output is captured
+ *
+ * @return  0 on success, -errno on failure
+ **/
+int output_open(job_t *job)
+{
+    debug("output_open() - ENTER [job @ %p]", job);
+    int retval = 0;
+    output_t *o = NULL;
+
+    VALIDATE(job && job->outmode == OUTPUT_CAPTURE && !job->output,
+            "job's output is not captured", -EINVAL, output_open_end);
+
+    MALLOC(o, sizeof(output_t));
+    for(int i = 0; i < 2; i++)
+    {
+        o->buf[i].fd = -1;
+        o->buf[i].filefd = -1;
+    }
+
+    for(int i = 0; i < 2; i++)
+    {
+        int p[2];
+        if(pipe2(p, O_CLOEXEC) < 0)
+        {
+            retval = -errno;
+            goto output_open_fail;
+        }
+        o->buf[i].fd = p[0];
+        job->outfd[i] = p[1];
+
+        /* the main loop select()s on the read ends */
+        if(p[0] >= FD_SETSIZE)
+        {
+            retval = -EMFILE;
+            goto output_open_fail;
+        }
+        fcntl(p[0], F_SETFL, O_NONBLOCK);
+    }
+
+    o->job = job;
+    o->next = outputs;
+    outputs = o;
+    job->output = o;
+    goto output_open_end;
+
+output_open_fail:
+    for(int i = 0; i < 2; i++)
+    {
+        if(o->buf[i].fd >= 0)
+            close(o->buf[i].fd);
+        if(job->outfd[i] >= 0)
+            close(job->outfd[i]);
+        job->outfd[i] = -1;
+    }
+    FREE(o);
+    job->outmode = OUTPUT_FILES;
+
+output_open_end:
+    debug("output_open() - EXIT [%d]", retval);
+    return retval;
+}
+
+/**
+ * void output_started(job_t *)
+ *
+ * @brief  Called once a job has been started: only the job writes into its
+ *         pipes now, so that the server reads EOF once the job is done.
+ *
+ * @param job  The job
+ **/
+void output_started(job_t *job)
+{
+    for(int i = 0; job && i < 2; i++)
+    {
+        if(job->outfd[i] >= 0)
+            close(job->outfd[i]);
+        job->outfd[i] = -1;
+    }
+}
+
+/**
+ * void output_spill(output_t *, int)
+ *
+ * @brief  Moves what was kept of a stream into the stream's output file, which
+ *         the rest of the stream goes into from now on. If the file cannot be
+ *         written, what was kept stays, and the rest is dropped.
+ *
+ * @param o  The output
+ * @param i  The stream, 0 for stdout or 1 for stderr
+ **/
+static void output_spill(output_t *o, int i)
+{
+    outbuf_t *b = &o->buf[i];
+    const char *path = (i == 0 ? o->job->stdoutfile : o->job->stderrfile);
+    int fd = -1;
+
+    debug("spilling %s of job %d", (i == 0 ? "stdout" : "stderr"),
+            o->job->jobid);
+    if(path)
+        fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                S_IRUSR | S_IWUSR);
+
+    for(uint32_t off = 0; fd >= 0 && off < b->len; )
+    {
+        ssize_t n = write(fd, b->data + off, b->len - off);
+        if(n < 0 && errno == EINTR)
+            continue;
+        if(n <= 0)
+        {
+            close(fd);
+            unlink(path);
+            fd = -1;
+            break;
+        }
+        off += n;
+    }
+
+    if(fd < 0)
+    {
+        error("failed to spill the output of job %d: %s", o->job->jobid,
+                strerror(errno));
+        b->discard = 1;
+        return;
+    }
+
+    FREE(b->data);
+    b->len = b->cap = 0;
+    b->filefd = fd;
+    b->spilled = 1;
+}
+
+/**
+ * void output_keep(output_t *, int, const char *, size_t)
+ *
+ * @brief  Keeps data read from a stream, spilling the stream if it would
+ *         grow past server->spill bytes.
+ *
+ * @param o  The output
+ * @param i  The stream
+ * @param data  The data
+ * @param len  The length of the data
+ **/
+static void output_keep(output_t *o, int i, const char *data, size_t len)
+{
+    outbuf_t *b = &o->buf[i];
+
+    if(b->filefd < 0 && !b->discard && b->len + len > server->spill)
+        output_spill(o, i);
+    if(b->discard)
+        return;
+
+    if(b->filefd >= 0)
+    {
+        while(len > 0)
+        {
+            ssize_t n = write(b->filefd, data, len);
+            if(n < 0 && errno == EINTR)
+                continue;
+            if(n <= 0)
+                return;
+            data += n;
+            len -= n;
+        }
+        return;
+    }
+
+    if(b->len + len > b->cap)
+    {
+        uint32_t cap = b->cap ? b->cap : 4096;
+        while(cap < b->len + len)
+            cap *= 2;
+        if(cap > server->spill && server->spill >= b->len + len)
+            cap = server->spill;
+
+        char *p = realloc(b->data, cap);
+        if(!p)
+            PERROR_EXIT("realloc()");
+        b->data = p;
+        b->cap = cap;
+    }
+
+    memcpy(b->data + b->len, data, len);
+    b->len += len;
+}
+
+/**
+ * void output_overquota(output_t *)
+ *
+ * @brief  The job wrote more than it may. It is killed, unless it is done
+ *         already, and the rest of its output is dropped.
+ *
+ * @param o  The output of the job
+ **/
+static void output_overquota(output_t *o)
+{
+    job_t *job = o->job;
+
+    debug("job %d wrote more than %llu bytes", job->jobid,
+            (unsigned long long)job->maxout);
+    job->overquota = 1;
+    if(!JOB_FINISHED(job->status))
+        jobs_kill(job, SIGKILL);
+
+    for(int i = 0; i < 2; i++)
+        output_shut(&o->buf[i]);
+}
+
+/**
+ * void output_collect(output_t *, int, size_t)
+ *
+ * @brief  Reads what a stream's pipe holds, until it is empty, the stream
+ *         ended, or limit bytes were read.
+ *
+ * @param o  The output
+ * @param i  The stream
+ * @param limit  The most to read
+ **/
+static void output_collect(output_t *o, int i, size_t limit)
+{
+    outbuf_t *b = &o->buf[i];
+    char chunk[16 * 1024];
+    size_t total = 0;
+
+    while(b->fd >= 0 && total < limit)
+    {
+        uint64_t maxout = o->job->maxout;
+        size_t len = limit - total;
+        ssize_t n;
+
+        if(len > OUTPUT_BURST)
+            len = OUTPUT_BURST;
+        if(maxout > 0 && o->written < maxout && len > maxout - o->written)
+            len = maxout - o->written;
+
+        if(maxout > 0 && o->written >= maxout)
+        {
+            /* a single byte more tells a job over its limit from one which
+             * is done writing */
+            if((n = read(b->fd, chunk, 1)) > 0)
+            {
+                output_overquota(o);
+                return;
+            }
+        }
+        else if(b->filefd >= 0 && output_splice)
+        {
+            n = splice(b->fd, NULL, b->filefd, NULL, len,
+                    SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            if(n < 0 && errno == EINVAL)
+            {
+                debug("splice() is not supported, copying instead");
+                output_splice = 0;
+                continue;
+            }
+        }
+        else
+        {
+            if(len > sizeof(chunk))
+                len = sizeof(chunk);
+            if((n = read(b->fd, chunk, len)) > 0)
+                output_keep(o, i, chunk, n);
+        }
+
+        if(n > 0)
+        {
+            total += n;
+            o->written += n;
+            continue;
+        }
+
+        if(n < 0 && errno == EINTR)
+            continue;
+        if(n < 0 && errno == EAGAIN)
+            return;
+
+        /* the job (and whatever it started) is done with the stream */
+        if(n < 0)
+            debug("failed to collect output: %s", strerror(errno));
+        close(b->fd);
+        b->fd = -1;
+    }
+}
+
+/**
+ * void output_finished(job_t *)
+ *
+ * @brief  Called as a job is reaped for the last time: reads whatever is
+ *         left of its output, and closes its pipes. Anything the job left
+ *         running in the background has its output cut short.
+ *
+ * @param job  The job
+ **/
+void output_finished(job_t *job)
+{
+    debug("output_finished() - ENTER [job @ %p]", job);
+
+    if(!job || !job->output)
+        goto output_finished_end;
+
+    output_t *o = job->output;
+    for(int i = 0; i < 2; i++)
+    {
+        outbuf_t *b = &o->buf[i];
+        output_collect(o, i, (size_t)-1);
+        output_shut(b);
+
+        /* it is kept for as long as the job is, so give back the slack */
+        if(b->len == 0)
+        {
+            FREE(b->data);
+            b->cap = 0;
+        }
+        else if(b->len < b->cap)
+        {
+            char *data = realloc(b->data, b->len);
+            if(data)
+            {
+                b->data = data;
+                b->cap = b->len;
+            }
+        }
+    }
+    output_unlink(o);
+
+output_finished_end:
+    debug("output_finished() - EXIT");
+}
+
+/**
+ * void output_free(output_t *)
+ *
+ * @brief  Releases what was kept of a job's output.
+ *
+ * @param o  The output, or NULL
+ **/
+void output_free(output_t *o)
+{
+    if(!o)
+        return;
+
+    output_unlink(o);
+    for(int i = 0; i < 2; i++)
+    {
+        output_shut(&o->buf[i]);
+        FREE(o->buf[i].data);
+    }
+    FREE(o);
+}
+
+/**
+ * void output_close(job_t *)
+ *
+ * @brief  Releases a job's pipes and output, as it is freed. Once the job is
+ *         archived, its output belongs to the archive instead.
+ *
+ * @param job  The job
+ **/
+void output_close(job_t *job)
+{
+    if(!job)
+        return;
+
+    output_started(job);
+    output_free(job->output);
+    job->output = NULL;
+}
+
+/**
+ * uint64_t output_bytes(output_t *)
+ *
+ * @brief  Determines how much memory the output kept of a job takes up.
+ *
+ * @param o  The output, or NULL
+ *
+ * @return  The number of bytes kept.
+ **/
+uint64_t output_bytes(output_t *o)
+{
+    return o ? (uint64_t)o->buf[0].len + o->buf[1].len : 0;
+}
+
+/**
+ * int output_fds(fd_set *, int)
+ *
+ * @brief  Adds the pipes of every output still being collected to a set of
+ *         fds to be read from.
+ *
+ * @param fds  The set
+ * @param nfds  The highest fd within the set
+ *
+ * @return  The highest fd within the set now.
+ **/
+int output_fds(fd_set *fds, int nfds)
+{
+    for(output_t *o = outputs; o; o = o->next)
+    {
+        for(int i = 0; i < 2; i++)
+        {
+            if(o->buf[i].fd < 0)
+                continue;
+            FD_SET(o->buf[i].fd, fds);
+            if(o->buf[i].fd > nfds)
+                nfds = o->buf[i].fd;
+        }
+    }
+
+    return nfds;
+}
+
+/**
+ * int output_quota(client_t *)
+ *
+ * @brief  Determines whether a client has used up its share of the spool, in
+ *         which case its new jobs are not run.
+ *
+ * @param c  The client
+ *
+ * @return  1 if it has, 0 otherwise.
+ **/
+int output_quota(client_t *c)
+{
+    return server->quota > 0 && c->archive.totalbytes >= server->quota;
+}
+
+/**
+ * int output_map(client_t *, int, int, outmap_t *)
+ *
+ * @brief  Gets at one stream of the output of a finished job: what was kept
+ *         in memory, or else its output file, mapped.
+ *
+ * @param c  The client owning the job
+ * @param idx  The job's index within the client's archive
+ * @param k  0 for its stdout, 1 for its stderr
+ * @param m  Filled in with the output, to be released with output_unmap()
+ *
+ * @return  0 on success, -ENOENT if the stream is empty, -errno on failure
+ **/
+int output_map(client_t *c, int idx, int k, outmap_t *m)
+{
+    int retval = 0;
+    output_t *o = c->archive.output[idx];
+
+    memset(m, 0, sizeof(outmap_t));
+
+    /* captured output is in memory, unless it spilled */
+    if(o && !o->buf[k].spilled)
+    {
+        m->data = o->buf[k].data;
+        m->size = o->buf[k].len;
+    }
+    else
+    {
+        char path[PATH_MAX];
+        struct stat st;
+        jobs_output_path(path, sizeof(path), c->name, &c->archive.stamp[idx],
+                (k ? "err" : "out"));
+
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+        VALIDATE(fd >= 0, "failed to open output file", -errno,
+                output_map_end);
+        if(fstat(fd, &st) == 0 && st.st_size > 0)
+        {
+            void *p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if(p != MAP_FAILED)
+            {
+                m->data = m->mapped = p;
+                m->size = st.st_size;
+            }
+            else
+                retval = -errno;
+        }
+        close(fd);
+    }
+
+    if(retval == 0 && m->size == 0)
+        retval = -ENOENT;
+
+output_map_end:
+    return retval;
+}
+
+/**
+ * void output_unmap(outmap_t *)
+ *
+ * @brief  Releases what output_map() got at.
+ *
+ * @param m  The output
+ **/
+void output_unmap(outmap_t *m)
+{
+    if(m->mapped)
+        munmap(m->mapped, m->size);
+    memset(m, 0, sizeof(outmap_t));
+}
+
+/**
+ * void output_poll(fd_set *)
+ *
+ * @brief  Collects the output of every job with something in its pipes. No
+ *         more than OUTPUT_BURST bytes are read from a pipe at a time, so
+ *         that a job which writes fast does not hold up the server.
+ *
+ * @param fds  The set of fds which select() found readable
+ **/
+void output_poll(fd_set *fds)
+{
+    for(output_t *o = outputs; o; o = o->next)
+    {
+        for(int i = 0; i < 2; i++)
+        {
+            if(o->buf[i].fd >= 0 && FD_ISSET(o->buf[i].fd, fds))
+                output_collect(o, i, OUTPUT_BURST);
+        }
+    }
+}
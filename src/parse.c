@@ -4,7 +4,7 @@
  *
  * Parses a string into it's comprised parts.
  *
- * A 'user_input' is of the form: `./a; ./b; ./c -t c`
+ * A 'user_input' is a pipeline of the form: `./a | ./b | ./c -t c`
  *
  * Given this as user input, it will be further decomposed into:
  * A `command` list which is of the form: `./a`, `./b`, and `./c -t c`
@@ -24,61 +24,11 @@
 #include "debug.h"
 #include "parse.h"
 
-/**
- * void free_components(component_t *)
- *
- * @brief  Frees memory associated with components, which are stored as SLL.
- *         This will traverse the list, freeing the entries as it progresses.
- *
- * @param comp  The head of the list of components to free.
- **/
-static void free_components(component_t *comp)
-{
-    if(comp)
-    {
-        component_t *n = comp->next;
-        while(comp)
-        {
-            n = comp->next;
-            FREE(comp->component);
-            FREE(comp);
-            comp = n;
-        }
-    }
-}
-
-/**
- * void free_commands(command_t *)
- *
- * @brief  Frees memory associated with commands, which are stored as SLL. This
- *         will traverse the list, freeing the entries as it progresses.
- *
- * @param cmd  The head of the list of commands to free.
- **/
-static void free_commands(command_t *cmd)
-{
-    if(cmd)
-    {
-        command_t *n = cmd->next;
-        while(cmd)
-        {
-            n = cmd->next;
-            free_components(cmd->components);
-            cmd->components = NULL;
-            FREE(cmd->command);
-            /* FREE(cmd->redirect_stdout); */
-            /* FREE(cmd->redirect_stderr); */
-            /* FREE(cmd->redirect_stdin); */
-            FREE(cmd);
-            cmd = n;
-        }
-    }
-}
-
 /**
  * int free_input(user_input_t *)
  *
- * @brief Cleans up a user_input, freeing all nested structs as necessary.
+ * @brief Cleans up a user_input. Since every nested struct lives within the
+ *        same arena as the user_input itself, this is a single free().
  *
  * @param ui  Pointer to the user_input to clean up.
  * @return  0 on success, -errno on failure.
@@ -93,9 +43,6 @@ int free_input(user_input_t *ui)
             -EINVAL,
             free_input_end);
 
-    free_commands(ui->commands);
-    ui->commands = NULL;
-    FREE(ui->input);
     FREE(ui);
 
 free_input_end:
@@ -104,162 +51,166 @@ free_input_end:
 }
 
 /**
- * int insert_component(component_t *, command_t *)
+ * size_t count_components(const char *)
  *
- * @brief  Inserts the given component at the end of the component list stored
- *         in cmd.
+ * @brief  Counts the number of delimited components within a string, without
+ *         modifying it.
  *
- * @param comp  The component to insert into cmd
- * @param cmd  The command_t which contains the list to append comp to.
+ * @param str  The string to examine
  *
- * @return  0 on success, -errno on failure.
+ * @return  The number of components found in str.
  **/
-static int insert_component(component_t *comp, command_t *cmd)
+static size_t count_components(const char *str)
 {
-    debug("insert_component - ENTER [comp @ %p, cmd @ %p]", comp, cmd);
-    int retval = 0;
+    size_t count = 0;
 
-    VALIDATE(comp,
-            "comp must be non-NULL",
-            -EINVAL,
-            insert_component_end);
-    VALIDATE(cmd,
-            "cmd must be non-NULL",
-            -EINVAL,
-            insert_component_end);
-
-    if(!cmd->components)
+    while(*str)
     {
-        cmd->components = comp;
-        goto insert_component_end;
-    }
+        str += strspn(str, COMPONENT_DELIMS COMMAND_DELIMS);
+        if(!*str)
+            break;
 
-    component_t *c = cmd->components;
-    while(c->next)
-        c = c->next;
-    c->next = comp;
+        count++;
+        str += strcspn(str, COMPONENT_DELIMS COMMAND_DELIMS);
+    }
 
-insert_component_end:
-    debug("insert_component() - EXIT [%d]", retval);
-    return retval;
+    return count;
 }
 
 /**
- * int insert_command(command_t *, user_input_t *)
+ * size_t count_commands(const char *)
  *
- * @brief  Inserts the given command at the end of the command list stored in
- *         ui.
+ * @brief  Counts the number of commands within a string, without modifying
+ *         it.
  *
- * @param cmd  The command to append to the end of the list
- * @param ui  The user_input_t which contains the list to append cmd to
+ * @param str  The string to examine
  *
- * @return  0 on success, -errno on failure
+ * @return  The number of commands found in str, or 0 if any of them is empty
+ *          (as in `ls |` or `ls || sort`).
  **/
-static int insert_command(command_t *cmd, user_input_t *ui)
+static size_t count_commands(const char *str)
 {
-    debug("insert_command() - ENTER [cmd @ %p, ui @ %p]", cmd, ui);
-    int retval = 0;
+    size_t count = 0;
 
-    VALIDATE(cmd,
-            "cmd must be non-NULL",
-            -EINVAL,
-            insert_command_end);
-    VALIDATE(ui,
-            "ui must be non-NULL",
-            -EINVAL,
-            insert_command_end);
-
-    if(!ui->commands)
+    while(1)
     {
-        ui->commands = cmd;
-        goto insert_command_end;
+        size_t len = strcspn(str, COMMAND_DELIMS);
+        if(strspn(str, COMPONENT_DELIMS) >= len)
+            return 0;
+
+        count++;
+        if(!str[len])
+            break;
+        str += len + 1;
     }
 
-    command_t *c = ui->commands;
-    while(c->next)
-        c = c->next;
-    c->next = cmd;
-
-insert_command_end:
-    debug("insert_command() - EXIT [%d]", retval);
-    return retval;
+    return count;
 }
 
 /**
  * user_input_t* parse_input(char *)
  *
  * @brief Parses the given string, splitting it into commands and components.
+ *        The input is scanned once to size the arena, and then a second time
+ *        to fill it in.
  *
  * @param input  The char* string to parse
- * @return  A pointer to a user_input_t representing the parsed input
+ * @return  A pointer to a user_input_t representing the parsed input, or NULL
+ *          if the input is empty, has an empty command, or on error. The
+ *          caller releases it with free_input().
  **/
 user_input_t* parse_input(char *input)
 {
     debug("parse_input() - ENTER [input @ %p (\'%s\')]", input, input);
     user_input_t *retval = NULL;
 
-    char *ctok = NULL;
-    char *iptr = input, *cptr = NULL;
+    char *ctok = NULL, *cptr = NULL;
     char *savecptr = NULL;
+    size_t len = 0, ntok = 0, ncmd = 0, hdrsize = 0;
 
     VALIDATE(input,
             "can not parse a NULL input",
             NULL,
             parse_input_end);
 
-    /* create the user_input_t */
-    if((retval = malloc(sizeof(user_input_t))) == NULL)
-    {
-        error("malloc() returned NULL: %s", strerror(errno));
-        goto parse_input_fail;
-    }
-    memset(retval, 0, sizeof(user_input_t));
+    len = strlen(input);
+    ntok = count_components(input);
+    ncmd = count_commands(input);
+    VALIDATE(ntok > 0 && ncmd > 0,
+            "can not parse an empty input or command",
+            NULL,
+            parse_input_end);
 
-    /* save a copy of the original input */
-    retval->input = strdup(input);
+    /* everything up to (and including) the argv arrays is pointer aligned,
+     * the character data follows it */
+    hdrsize = sizeof(user_input_t) + sizeof(command_t) * ncmd +
+              sizeof(component_t) * ntok + sizeof(char *) * (ntok + ncmd);
 
-    /* create + insert the command_t into the user_input_t */
-    command_t *newc = malloc(sizeof(command_t));
-    if(!newc)
+    if((retval = malloc(hdrsize + 3 * (len + 1))) == NULL)
     {
-        error("malloc() failed to allocate buffer for command_t");
-        goto parse_input_fail;
+        error("malloc() returned NULL: %s", strerror(errno));
+        goto parse_input_end;
     }
-    memset(newc, 0, sizeof(command_t));
-    newc->command = strdup(iptr);
-    insert_command(newc, retval);
-
-    /* add the component_t's to the command_t */
-    for(cptr = iptr; ; cptr = NULL)
+    memset(retval, 0, hdrsize);
+
+    command_t *cmds = (command_t *)(retval + 1);
+    component_t *comps = (component_t *)(cmds + ncmd);
+    char **argv = (char **)(comps + ntok);
+    char *text = (char *)(argv + ntok + ncmd);
+    char *ctext = text + len + 1;
+    char *tokens = ctext + len + 1;
+
+    /* save a copy of the original input, and two more which are cut up into
+     * commands and tokens */
+    memcpy(text, input, len + 1);
+    memcpy(ctext, input, len + 1);
+    memcpy(tokens, input, len + 1);
+    retval->input = text;
+    retval->commands = cmds;
+
+    size_t off = 0;
+    for(size_t i = 0; i < ncmd; i++)
     {
-        ctok = strtok_r(cptr, COMPONENT_DELIMS, &savecptr);
-        if(!ctok)
-        {
-            debug("no token found for COMPONENT_DELIMS");
-            goto parse_input_loop_end;
-        }
-        debug("c-token -> %s", ctok);
-
-        component_t *newcomp = malloc(sizeof(component_t));
-        if(!newcomp)
+        command_t *newc = &cmds[i];
+        size_t clen = strcspn(text + off, COMMAND_DELIMS);
+
+        ctext[off + clen] = '\0';
+        tokens[off + clen] = '\0';
+
+        newc->command = ctext + off + strspn(ctext + off, COMPONENT_DELIMS);
+        newc->in_fd = -1;
+        newc->out_fd = -1;
+        newc->components = comps;
+        newc->argv = argv;
+        if(i + 1 < ncmd)
+            newc->next = newc + 1;
+
+        /* split the token bytes in place, filling in the components + argv */
+        for(cptr = tokens + off; ; cptr = NULL)
         {
-            error("malloc() failed to allocate buffer for component_t");
-            goto parse_input_fail;
+            ctok = strtok_r(cptr, COMPONENT_DELIMS, &savecptr);
+            if(!ctok)
+            {
+                debug("no token found for COMPONENT_DELIMS");
+                break;
+            }
+            debug("c-token -> %s", ctok);
+
+            component_t *newcomp = &comps[newc->argc];
+            newcomp->component = ctok;
+            if(newc->argc > 0)
+                comps[newc->argc - 1].next = newcomp;
+
+            argv[newc->argc++] = ctok;
         }
-        memset(newcomp, 0, sizeof(component_t));
+        argv[newc->argc] = NULL;
 
-        newcomp->component = strdup(ctok);
-        insert_component(newcomp, newc);
+        comps += newc->argc;
+        argv += newc->argc + 1;
+        off += clen + 1;
     }
 
-
-parse_input_fail:
-    free_input(retval);
-
-parse_input_loop_end:
-
 parse_input_end:
     debug("parse_input() - EXIT [%p]", retval);
     return retval;
 }
-
@@ -0,0 +1,430 @@
+/**
+ * @file place.c
+ * @author Daniel Calabria
+ *
+ * CPU and NUMA placement of running jobs.
+ *
+ * When placement is enabled, every cpu the server may use is handed out to at
+ * most one running job at a time, and a job is pinned to the cpus it was given
+ * with sched_setaffinity(). A job is placed on the NUMA node (as listed under
+ * PLACE_SYSFS) with the fewest free cpus that can still hold all of it, so
+ * that jobs do not straddle sockets and larger nodes stay free for larger
+ * jobs. Only when no single node has room is a job spread across nodes.
+ *
+ * The core budget is capped at the number of usable cpus, so a job which
+ * sched_fits() always finds enough free cpus here.
+ **/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+
+#include "common.h"
+#include "debug.h"
+#include "server.h"
+#include "jobs.h"
+#include "place.h"
+
+/**
+ * void place_add_cpu(int, int)
+ *
+ * @brief  Records a cpu which jobs may be placed on.
+ *
+ * @param cpu  The cpu number
+ * @param node  The NUMA node the cpu belongs to
+ **/
+static void place_add_cpu(int cpu, int node)
+{
+    for(int i = 0; i < server->ncpus; i++)
+    {
+        if(server->cpuid[i] == cpu)
+            return;
+    }
+
+    if(server->ncpus % 64 == 0)
+    {
+        int cap = server->ncpus + 64;
+        server->cpuid = realloc(server->cpuid, sizeof(int) * cap);
+        server->cpunode = realloc(server->cpunode, sizeof(int) * cap);
+        server->cpuowner = realloc(server->cpuowner, sizeof(job_t *) * cap);
+        if(!server->cpuid || !server->cpunode || !server->cpuowner)
+            PERROR_EXIT("realloc()");
+    }
+
+    server->cpuid[server->ncpus] = cpu;
+    server->cpunode[server->ncpus] = node;
+    server->cpuowner[server->ncpus] = NULL;
+    server->ncpus++;
+
+    if(node >= server->nnodes)
+        server->nnodes = node + 1;
+}
+
+/**
+ * int place_read_node(int, cpu_set_t *)
+ *
+ * @brief  Reads the cpulist of a NUMA node, such as "0-3,8-11", keeping the
+ *         cpus which the server itself is allowed to run on.
+ *
+ * @param node  The node number
+ * @param allowed  The server's own affinity mask
+ *
+ * @return  0 on success, -errno on failure
+ **/
+static int place_read_node(int node, cpu_set_t *allowed)
+{
+    int retval = 0;
+    char path[128], list[4096];
+    FILE *f = NULL;
+
+    snprintf(path, sizeof(path), PLACE_SYSFS "/node%d/cpulist", node);
+    VALIDATE((f = fopen(path, "r")), "failed to open node cpulist", -errno,
+            place_read_node_end);
+    VALIDATE(fgets(list, sizeof(list), f), "failed to read node cpulist",
+            -EIO, place_read_node_end);
+
+    char *p = list;
+    while(*p && *p != '\n')
+    {
+        char *endp = NULL;
+        long lo = strtol(p, &endp, 10), hi = lo;
+        VALIDATE(endp != p, "malformed cpulist", -EINVAL, place_read_node_end);
+        if(*endp == '-')
+        {
+            p = endp + 1;
+            hi = strtol(p, &endp, 10);
+        }
+
+        for(long cpu = lo; cpu <= hi && cpu < CPU_SETSIZE; cpu++)
+        {
+            if(CPU_ISSET(cpu, allowed))
+                place_add_cpu(cpu, node);
+        }
+
+        p = (*endp == ',' ? endp + 1 : endp);
+    }
+
+place_read_node_end:
+    if(f)
+        fclose(f);
+    return retval;
+}
+
+/**
+ * int place_init()
+ *
+ * @brief  Discovers the cpus and NUMA nodes jobs may be placed on. Without
+ *         NUMA information, every cpu the server may run on counts as node 0.
+ *
+ * @return  The number of usable cpus, or -errno on failure.
+ **/
+int place_init()
+{
+    debug("place_init() - ENTER");
+    int retval = 0;
+    cpu_set_t allowed;
+    DIR *d = NULL;
+    struct dirent *de = NULL;
+
+    VALIDATE(sched_getaffinity(0, sizeof(allowed), &allowed) == 0,
+            "sched_getaffinity() failed", -errno, place_init_end);
+
+    if((d = opendir(PLACE_SYSFS)))
+    {
+        while((de = readdir(d)))
+        {
+            char *endp = NULL;
+            if(strncmp(de->d_name, "node", 4) != 0)
+                continue;
+
+            long node = strtol(de->d_name + 4, &endp, 10);
+            if(endp == de->d_name + 4 || *endp != '\0')
+                continue;
+
+            if(place_read_node(node, &allowed) < 0)
+                debug("skipping node%ld", node);
+        }
+        closedir(d);
+    }
+
+    if(server->ncpus == 0)
+    {
+        for(int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+        {
+            if(CPU_ISSET(cpu, &allowed))
+                place_add_cpu(cpu, 0);
+        }
+    }
+
+    VALIDATE(server->ncpus > 0, "no usable cpus", -ENODEV, place_init_end);
+
+    /* every running job needs cpus of its own */
+    if(server->core_budget == 0 || server->core_budget > server->ncpus)
+        server->core_budget = server->ncpus;
+
+    retval = server->ncpus;
+
+place_init_end:
+    debug("place_init() - EXIT [%d cpus, %d nodes]", retval, server->nnodes);
+    return retval;
+}
+
+/**
+ * int place_acquire(job_t *)
+ *
+ * @brief  Chooses the cpus a job will run on.
+ *
+ * @param job  The job about to start
+ *
+ * @return  0 on success, -errno on failure
+ **/
+int place_acquire(job_t *job)
+{
+    debug("place_acquire() - ENTER [job @ %p]", job);
+    int retval = 0;
+    int need = (job->cores ? job->cores : 1);
+    int *nfree = NULL;
+
+    VALIDATE(!job->cpus, "job is already placed", 0, place_acquire_end);
+    VALIDATE(server->ncpus > 0, "placement is not enabled", 0,
+            place_acquire_end);
+
+    nfree = calloc(server->nnodes, sizeof(int));
+    VALIDATE(nfree, "calloc() failed", -ENOMEM, place_acquire_end);
+
+    int total = 0;
+    for(int i = 0; i < server->ncpus; i++)
+    {
+        if(!server->cpuowner[i])
+        {
+            nfree[server->cpunode[i]]++;
+            total++;
+        }
+    }
+    VALIDATE(total >= need, "not enough free cpus", -EBUSY, place_acquire_end);
+
+    /* best fit: the node with the fewest free cpus that holds the whole job */
+    int node = -1;
+    for(int n = 0; n < server->nnodes; n++)
+    {
+        if(nfree[n] >= need && (node < 0 || nfree[n] < nfree[node]))
+            node = n;
+    }
+
+    job->cpus = malloc(sizeof(int) * need);
+    VALIDATE(job->cpus, "malloc() failed", -ENOMEM, place_acquire_end);
+    job->node = node;
+
+    int got = 0;
+    while(got < need)
+    {
+        /* spilling over: take from whichever node has the most left */
+        int from = node;
+        if(from < 0)
+        {
+            for(int n = 0; n < server->nnodes; n++)
+            {
+                if(nfree[n] > 0 && (from < 0 || nfree[n] > nfree[from]))
+                    from = n;
+            }
+        }
+
+        for(int i = 0; i < server->ncpus && got < need; i++)
+        {
+            if(server->cpuowner[i] || server->cpunode[i] != from)
+                continue;
+
+            server->cpuowner[i] = job;
+            job->cpus[got++] = server->cpuid[i];
+            nfree[from]--;
+
+            if(node < 0)
+                break;
+        }
+    }
+
+place_acquire_end:
+    free(nfree);
+    debug("place_acquire() - EXIT [%d, node %d]", retval, job->node);
+    return retval;
+}
+
+/**
+ * void place_release(job_t *)
+ *
+ * @brief  Returns the cpus held by a job.
+ *
+ * @param job  The job
+ **/
+void place_release(job_t *job)
+{
+    if(!job || !job->cpus)
+        return;
+
+    for(int i = 0; i < server->ncpus; i++)
+    {
+        if(server->cpuowner[i] == job)
+            server->cpuowner[i] = NULL;
+    }
+
+    FREE(job->cpus);
+}
+
+/**
+ * int place_apply(job_t *)
+ *
+ * @brief  Pins the calling process to the cpus of a job and, if requested,
+ *         binds its memory to the job's node. Called in the child before the
+ *         job is exec'd.
+ *
+ * @param job  The job being launched
+ *
+ * @return  0 on success, -errno on failure
+ **/
+int place_apply(job_t *job)
+{
+    int retval = 0;
+    cpu_set_t set;
+
+    if(!job->cpus)
+        return 0;
+
+    CPU_ZERO(&set);
+    for(int i = 0; i < job->cores; i++)
+        CPU_SET(job->cpus[i], &set);
+
+    VALIDATE(sched_setaffinity(0, sizeof(set), &set) == 0,
+            "sched_setaffinity() failed", -errno, place_apply_end);
+
+    if(server->membind && job->node >= 0 && job->node < PLACE_MAXNODES)
+    {
+        unsigned long mask[PLACE_MAXNODES / (8 * sizeof(unsigned long))];
+        memset(mask, 0, sizeof(mask));
+        mask[job->node / (8 * sizeof(unsigned long))] |=
+            1UL << (job->node % (8 * sizeof(unsigned long)));
+
+        VALIDATE(syscall(SYS_set_mempolicy, MPOL_BIND, mask, PLACE_MAXNODES) == 0,
+                "set_mempolicy() failed", -errno, place_apply_end);
+    }
+
+place_apply_end:
+    return retval;
+}
+
+/**
+ * int place_move(job_t *)
+ *
+ * @brief  Pins every thread of a job's processes to the cpus of the job. Used
+ *         for a job which was placed again after being preempted, and so may
+ *         have been given other cpus than it started on. Memory the job
+ *         already allocated stays on the node it was allocated on.
+ *
+ * @param job  The running job
+ *
+ * @return  0 on success, -errno on failure
+ **/
+int place_move(job_t *job)
+{
+    int retval = 0;
+    cpu_set_t set;
+    DIR *proc = NULL;
+
+    if(!job->cpus || job->pgid <= 0)
+        return 0;
+
+    CPU_ZERO(&set);
+    for(int i = 0; i < job->cores; i++)
+        CPU_SET(job->cpus[i], &set);
+
+    proc = opendir("/proc");
+    VALIDATE(proc, "opendir() failed", -errno, place_move_end);
+
+    /* the processes of the job are those in its process group */
+    struct dirent *de;
+    while((de = readdir(proc)))
+    {
+        pid_t pid = atoi(de->d_name);
+        if(pid <= 0 || getpgid(pid) != job->pgid)
+            continue;
+
+        char path[64];
+        snprintf(path, sizeof(path), "/proc/%d/task", pid);
+        DIR *tasks = opendir(path);
+        if(!tasks)
+            continue;
+
+        struct dirent *te;
+        while((te = readdir(tasks)))
+        {
+            pid_t tid = atoi(te->d_name);
+            if(tid > 0 && sched_setaffinity(tid, sizeof(set), &set) < 0 &&
+               errno != ESRCH)
+                retval = -errno;
+        }
+        closedir(tasks);
+    }
+
+place_move_end:
+    if(proc)
+        closedir(proc);
+    return retval;
+}
+
+/**
+ * int place_format(job_t *, char *, size_t)
+ *
+ * @brief  Writes the cpus of a job as a cpulist, such as "0-3,8".
+ *
+ * @param job  The job
+ * @param buf  Where to write the list
+ * @param size  The size of buf
+ *
+ * @return  The length of the list, 0 if the job is not placed.
+ **/
+int place_format(job_t *job, char *buf, size_t size)
+{
+    int len = 0;
+
+    if(size > 0)
+        buf[0] = '\0';
+    if(!job || !job->cpus)
+        return 0;
+
+    /* cpus were handed out in ascending order within each node */
+    for(int i = 0; i < job->cores && len < (int)size; )
+    {
+        int j = i;
+        while(j + 1 < job->cores && job->cpus[j+1] == job->cpus[j] + 1)
+            j++;
+
+        if(j > i)
+            len += snprintf(buf + len, size - len, "%s%d-%d", (len ? "," : ""),
+                    job->cpus[i], job->cpus[j]);
+        else
+            len += snprintf(buf + len, size - len, "%s%d", (len ? "," : ""),
+                    job->cpus[i]);
+        i = j + 1;
+    }
+
+    return (len < (int)size ? len : (int)size - 1);
+}
+
+/**
+ * void place_free()
+ *
+ * @brief  Releases the server's record of usable cpus.
+ **/
+void place_free()
+{
+    FREE(server->cpuid);
+    FREE(server->cpunode);
+    FREE(server->cpuowner);
+    server->ncpus = server->nnodes = 0;
+}
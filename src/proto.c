@@ -10,6 +10,7 @@
 #include <stdlib.h>
 #include <errno.h>
 #include <string.h>
+#include <stddef.h>
 
 #include "common.h"
 #include "debug.h"
@@ -98,6 +99,34 @@ int send_pkt(int fd, char packet_type, void *payload)
             /* priority */
             WRITE(fd, &s->priority, sizeof(int32_t));
 
+            /* cores */
+            WRITE(fd, &s->cores, sizeof(uint32_t));
+
+            /* walltime */
+            WRITE(fd, &s->walltime, sizeof(uint32_t));
+
+            /* dependencies */
+            WRITE(fd, &s->ndeps, sizeof(uint32_t));
+            if(s->ndeps > 0)
+                WRITE(fd, s->deps, sizeof(dependency_t) * s->ndeps);
+
+            /* job array */
+            WRITE(fd, &s->ntasks, sizeof(uint32_t));
+            WRITE(fd, &s->array_lo, sizeof(uint32_t));
+            WRITE(fd, &s->array_cap, sizeof(uint32_t));
+
+            /* cache fingerprint */
+            WRITE(fd, &s->fplen, sizeof(uint32_t));
+            if(s->fplen > 0)
+                WRITE(fd, s->fingerprint, s->fplen);
+
+            /* stdin fed by the client */
+            WRITE(fd, &s->input, sizeof(uint32_t));
+
+            /* where its output goes */
+            WRITE(fd, &s->output, sizeof(uint32_t));
+            WRITE(fd, &s->maxout, sizeof(uint64_t));
+
             /* cmdline length */
             WRITE(fd, &s->cmdlen, sizeof(uint32_t));
 
@@ -188,6 +217,51 @@ int send_pkt(int fd, char packet_type, void *payload)
             break;
         }
 
+        /* JOB_GET_LINES */
+        case JOB_GET_LINES:
+        {
+            VALIDATE(payload, "payload must be non NULL", -EINVAL, send_pkt_end);
+            WRITE(fd, &packet_type, sizeof(char));
+            lines_t *l = (lines_t *)payload;
+            WRITE(fd, l, sizeof(lines_t));
+            break;
+        }
+
+        /* JOB_GREP */
+        case JOB_GREP:
+        {
+            VALIDATE(payload, "payload must be non NULL", -EINVAL, send_pkt_end);
+            WRITE(fd, &packet_type, sizeof(char));
+            grep_t *g = (grep_t *)payload;
+            WRITE(fd, g, offsetof(grep_t, pattern));
+            WRITE(fd, g->pattern, g->patlen);
+            break;
+        }
+
+        /* JOB_SEARCH */
+        case JOB_SEARCH:
+        {
+            VALIDATE(payload, "payload must be non NULL", -EINVAL, send_pkt_end);
+            WRITE(fd, &packet_type, sizeof(char));
+            query_t *q = (query_t *)payload;
+            WRITE(fd, q, offsetof(query_t, pattern));
+            WRITE(fd, q->pattern, q->patlen);
+            break;
+        }
+
+        /* JOB_INPUT */
+        case JOB_INPUT:
+        {
+            VALIDATE(payload, "payload must be non NULL", -EINVAL, send_pkt_end);
+            WRITE(fd, &packet_type, sizeof(char));
+            input_t *in = (input_t *)payload;
+            WRITE(fd, &in->jobid, sizeof(uint32_t));
+            WRITE(fd, &in->length, sizeof(uint32_t));
+            if(in->length > 0)
+                WRITE(fd, in->data, in->length);
+            break;
+        }
+
         /* JOB_RESULTS */
         case JOB_RESULTS:
         {
@@ -316,6 +390,43 @@ int recv_pkt(int fd, void **payload)
             READ(fd, &j->priority, sizeof(int32_t));
             debug("pri %d", j->priority);
 
+            /* cores */
+            READ(fd, &j->cores, sizeof(uint32_t));
+            debug("cores %d", j->cores);
+
+            /* walltime */
+            READ(fd, &j->walltime, sizeof(uint32_t));
+
+            /* dependencies */
+            READ(fd, &j->ndeps, sizeof(uint32_t));
+            debug("ndeps %d", j->ndeps);
+            if(j->ndeps > 0)
+            {
+                MALLOC(j->deps, sizeof(dependency_t) * j->ndeps);
+                READ(fd, j->deps, sizeof(dependency_t) * j->ndeps);
+            }
+
+            /* job array */
+            READ(fd, &j->ntasks, sizeof(uint32_t));
+            READ(fd, &j->array_lo, sizeof(uint32_t));
+            READ(fd, &j->array_cap, sizeof(uint32_t));
+            debug("ntasks %d", j->ntasks);
+
+            /* cache fingerprint */
+            READ(fd, &j->fplen, sizeof(uint32_t));
+            if(j->fplen > 0)
+            {
+                MALLOC(j->fingerprint, sizeof(char) * (j->fplen + 1));
+                READ(fd, j->fingerprint, j->fplen);
+            }
+
+            /* stdin fed by the client */
+            READ(fd, &j->input, sizeof(uint32_t));
+
+            /* where its output goes */
+            READ(fd, &j->output, sizeof(uint32_t));
+            READ(fd, &j->maxout, sizeof(uint64_t));
+
             /* cmdlen */
             READ(fd, &j->cmdlen, sizeof(uint32_t));
             debug("cmd len %d", j->cmdlen);
@@ -430,6 +541,55 @@ int recv_pkt(int fd, void **payload)
             break;
         }
 
+        /* JOB_GET_LINES */
+        case JOB_GET_LINES:
+        {
+            lines_t *l = NULL;
+            MALLOC(l, sizeof(lines_t));
+            READ(fd, l, sizeof(lines_t));
+            *payload = l;
+            retval = c;
+            break;
+        }
+
+        /* JOB_GREP */
+        case JOB_GREP:
+        {
+            grep_t *g = NULL;
+            MALLOC(g, sizeof(grep_t));
+            READ(fd, g, offsetof(grep_t, pattern));
+            MALLOC(g->pattern, sizeof(char) * (g->patlen + 1));
+            READ(fd, g->pattern, g->patlen);
+            *payload = g;
+            retval = c;
+            break;
+        }
+
+        /* JOB_SEARCH */
+        case JOB_SEARCH:
+        {
+            query_t *q = NULL;
+            MALLOC(q, sizeof(query_t));
+            READ(fd, q, offsetof(query_t, pattern));
+            MALLOC(q->pattern, sizeof(char) * (q->patlen + 1));
+            READ(fd, q->pattern, q->patlen);
+            *payload = q;
+            retval = c;
+            break;
+        }
+
+        /* JOB_INPUT, whose data is left for the caller */
+        case JOB_INPUT:
+        {
+            input_t *in = NULL;
+            MALLOC(in, sizeof(input_t));
+            READ(fd, &in->jobid, sizeof(uint32_t));
+            READ(fd, &in->length, sizeof(uint32_t));
+            *payload = in;
+            retval = c;
+            break;
+        }
+
         /* JOB_RESULTS */
         case JOB_RESULTS:
         {
@@ -0,0 +1,1100 @@
+/**
+ * @file sched.c
+ * @author Daniel Calabria
+ *
+ * Admission of NEW jobs.
+ *
+ * A job which is submitted while the server is already running maxjobs jobs
+ * is placed on a ready queue. Whenever a slot opens up, sched_dispatch()
+ * starts queued jobs, so finding the next job to run never requires walking
+ * the list of every job the server knows about.
+ *
+ * Which queued job runs next depends on the server's policy:
+ *
+ *   POLICY_FIFO  - one queue for the whole server, in order of submission.
+ *   POLICY_FAIR  - one queue per client. The next job comes from the client
+ *                  with the least recent cpu usage relative to its weight,
+ *                  where usage is charged from the rusage of each finished job
+ *                  and decays with a half-life of FAIR_HALFLIFE seconds.
+ *   POLICY_PRIO  - a binary heap ordered by priority, then submission time.
+ *                  A queued job gains one level of priority for every
+ *                  server->aging seconds it waits. Since every queued job ages
+ *                  at the same rate, this is the same as keying the heap on
+ *                  (submission time + priority * aging), which never changes
+ *                  while the job waits.
+ *
+ * Besides maxjobs, the server may be given a budget for the total maxmem and
+ * the total number of cores of the jobs it runs. A job only starts once what
+ * it declared fits within what is left of the budgets. When the job the policy
+ * would pick next does not fit, up to SCHED_SCAN jobs behind it are tried in
+ * policy order and the first ones which fit are started, so that small jobs
+ * can fill the gaps left around big ones.
+ *
+ * With preemption enabled, a queued job which does not fit may instead take
+ * the place of running jobs of lower priority (a higher nice value). The least
+ * urgent of those are stopped with SIGSTOP until the job fits, giving back
+ * their slots and their shares of the budgets, though a stopped job keeps
+ * the memory it already has. Preempted jobs are resumed, most urgent first, as
+ * soon as they fit again, ahead of any queued job which is not more urgent.
+ *
+ * Filling gaps that way can keep a big job waiting forever. With backfill
+ * enabled, the first queued job which does not fit instead gets a reservation
+ * (EASY backfilling): the time by which enough running jobs will have finished
+ * for it to fit, going by their estimated run times, and what will be left
+ * over then. A job behind it only starts early if it is estimated to finish by
+ * that time, or if it fits within what is left over. A job's estimate is the
+ * walltime it was submitted with, or else its cpu limit.
+ *
+ * A client over its output quota gets no more jobs started: whichever of its
+ * jobs would be admitted next (queued, released by the jobs it waited on, or
+ * a task of one of its arrays) ends up in the QUOTA state instead.
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <stdint.h>
+#include <limits.h>
+#include <signal.h>
+
+#include "common.h"
+#include "debug.h"
+#include "server.h"
+#include "client.h"
+#include "jobs.h"
+#include "sched.h"
+#include "place.h"
+#include "output.h"
+
+/**
+ * job_t** sched_head(job_t *) / job_t** sched_tail(job_t *)
+ *
+ * @brief  Finds the queue a job belongs on under the current policy.
+ **/
+static job_t** sched_head(job_t *job)
+{
+    return (server->policy == POLICY_FAIR ? &job->owner->queue : &server->queue);
+}
+
+static job_t** sched_tail(job_t *job)
+{
+    return (server->policy == POLICY_FAIR ? &job->owner->queue_tail : &server->queue_tail);
+}
+
+/**
+ * int64_t sched_key(job_t *)
+ *
+ * @brief  Computes a job's position in the priority heap. Lower runs first.
+ *
+ * @param job  The job
+ *
+ * @return  The heap key of the job, in microseconds.
+ **/
+static int64_t sched_key(job_t *job)
+{
+    return (int64_t)job->stamp.tv_sec * 1000000 + job->stamp.tv_usec +
+           (int64_t)job->priority * server->aging * 1000000;
+}
+
+/**
+ * void heap_swap(int, int)
+ *
+ * @brief  Swaps two entries of the priority heap, keeping their indices up
+ *         to date.
+ **/
+static void heap_swap(int a, int b)
+{
+    job_t *t = server->heap[a];
+    server->heap[a] = server->heap[b];
+    server->heap[b] = t;
+    server->heap[a]->heapidx = a;
+    server->heap[b]->heapidx = b;
+}
+
+/**
+ * void heap_sift(int)
+ *
+ * @brief  Restores the heap property for the entry at idx, moving it up or
+ *         down as needed.
+ **/
+static void heap_sift(int idx)
+{
+    while(idx > 0 &&
+          server->heap[idx]->qkey < server->heap[(idx-1)/2]->qkey)
+    {
+        heap_swap(idx, (idx-1)/2);
+        idx = (idx-1)/2;
+    }
+
+    while(1)
+    {
+        int l = 2*idx + 1, r = l + 1, min = idx;
+
+        if(l < server->heapsize && server->heap[l]->qkey < server->heap[min]->qkey)
+            min = l;
+        if(r < server->heapsize && server->heap[r]->qkey < server->heap[min]->qkey)
+            min = r;
+        if(min == idx)
+            break;
+
+        heap_swap(idx, min);
+        idx = min;
+    }
+}
+
+/**
+ * double sched_usage(client_t *, time_t)
+ *
+ * @brief  Decays a client's recorded cpu usage up to the given time.
+ *
+ * @param c  The client
+ * @param now  The current time
+ *
+ * @return  The client's decayed usage, in cpu seconds.
+ **/
+static double sched_usage(client_t *c, time_t now)
+{
+    if(c->usage > 0 && now > c->usage_stamp)
+        c->usage *= exp2(-(double)(now - c->usage_stamp) / FAIR_HALFLIFE);
+    c->usage_stamp = now;
+
+    return c->usage;
+}
+
+/**
+ * int sched_enqueue(job_t *)
+ *
+ * @brief  Appends a job to the end of its ready queue.
+ *
+ * @param job  The job to enqueue
+ *
+ * @return  0 on success, -errno on failure
+ **/
+int sched_enqueue(job_t *job)
+{
+    debug("sched_enqueue() - ENTER [job @ %p]", job);
+    int retval = 0;
+
+    VALIDATE(job, "job must be non NULL", -EINVAL, sched_enqueue_end);
+    VALIDATE(!job->queued, "job is already queued", -EINVAL, sched_enqueue_end);
+
+    if(server->policy == POLICY_PRIO)
+    {
+        if(server->heapsize == server->heapcap)
+        {
+            int cap = server->heapcap ? server->heapcap * 2 : 64;
+            job_t **heap = realloc(server->heap, sizeof(job_t *) * cap);
+            VALIDATE(heap, "realloc() failed to grow heap", -ENOMEM,
+                    sched_enqueue_end);
+            server->heap = heap;
+            server->heapcap = cap;
+        }
+
+        job->qkey = sched_key(job);
+        job->heapidx = server->heapsize++;
+        server->heap[job->heapidx] = job;
+        heap_sift(job->heapidx);
+    }
+    else
+    {
+        job_t **head = sched_head(job), **tail = sched_tail(job);
+
+        job->qnext = NULL;
+        job->qprev = *tail;
+        if(*tail)
+            (*tail)->qnext = job;
+        else
+            *head = job;
+        *tail = job;
+    }
+
+    job->queued = 1;
+    server->nqueued++;
+
+sched_enqueue_end:
+    debug("sched_enqueue() - EXIT [%d]", retval);
+    return retval;
+}
+
+/**
+ * void sched_unpreempt(job_t *)
+ *
+ * @brief  Takes a job off the list of preempted jobs, if it is on it.
+ *
+ * @param job  The job
+ **/
+static void sched_unpreempt(job_t *job)
+{
+    if(!job->preempted)
+        return;
+
+    job_t **p = &server->preempted;
+    while(*p && *p != job)
+        p = &(*p)->pnext;
+    if(*p)
+        *p = job->pnext;
+
+    job->pnext = NULL;
+    job->preempted = 0;
+}
+
+/**
+ * int sched_remove(job_t *)
+ *
+ * @brief  Removes a job from its ready queue, or from the list of preempted
+ *         jobs, if it is on one.
+ *
+ * @param job  The job to remove
+ *
+ * @return  0 on success, -errno on failure
+ **/
+int sched_remove(job_t *job)
+{
+    int retval = 0;
+
+    VALIDATE(job, "job must be non NULL", -EINVAL, sched_remove_end);
+    sched_unpreempt(job);
+    if(!job->queued)
+        goto sched_remove_end;
+
+    if(server->policy == POLICY_PRIO)
+    {
+        int idx = job->heapidx;
+
+        server->heapsize--;
+        if(idx != server->heapsize)
+        {
+            heap_swap(idx, server->heapsize);
+            heap_sift(idx);
+        }
+    }
+    else
+    {
+        job_t **head = sched_head(job), **tail = sched_tail(job);
+
+        if(job->qprev)
+            job->qprev->qnext = job->qnext;
+        else
+            *head = job->qnext;
+
+        if(job->qnext)
+            job->qnext->qprev = job->qprev;
+        else
+            *tail = job->qprev;
+
+        job->qnext = job->qprev = NULL;
+    }
+
+    job->queued = 0;
+    server->nqueued--;
+
+sched_remove_end:
+    return retval;
+}
+
+/**
+ * job_t* sched_dequeue()
+ *
+ * @brief  Removes and returns the job which should run next.
+ *
+ * @return  The next job to run, or NULL if nothing is queued.
+ **/
+job_t* sched_dequeue()
+{
+    job_t *retval = NULL;
+
+    if(server->nqueued == 0)
+        return NULL;
+
+    if(server->policy == POLICY_FAIR)
+    {
+        /* pick the client which is furthest below its share */
+        time_t now = time(NULL);
+        client_t *best = NULL;
+        double bestshare = 0;
+
+        for(client_t *c = server->clientlist; c; c = c->next)
+        {
+            if(!c->queue)
+                continue;
+
+            double share = sched_usage(c, now) / c->weight;
+            if(!best || share < bestshare)
+            {
+                best = c;
+                bestshare = share;
+            }
+        }
+
+        retval = best ? best->queue : NULL;
+    }
+    else if(server->policy == POLICY_PRIO)
+        retval = server->heap[0];
+    else
+        retval = server->queue;
+
+    if(retval)
+        sched_remove(retval);
+
+    return retval;
+}
+
+/**
+ * void sched_requeue(job_t *)
+ *
+ * @brief  Puts a job which was just dequeued back where it came from, at the
+ *         front of its queue.
+ *
+ * @param job  The job to put back
+ **/
+static void sched_requeue(job_t *job)
+{
+    if(server->policy == POLICY_PRIO)
+    {
+        /* its key has not changed, so it lands back in the same place */
+        sched_enqueue(job);
+        return;
+    }
+
+    job_t **head = sched_head(job), **tail = sched_tail(job);
+
+    job->qprev = NULL;
+    job->qnext = *head;
+    if(*head)
+        (*head)->qprev = job;
+    else
+        *tail = job;
+    *head = job;
+    job->queued = 1;
+    server->nqueued++;
+}
+
+/* A reservation for the first queued job which did not fit, see sched_reserve() */
+typedef struct resv_s
+{
+    time_t shadow;      /* when the job is expected to fit */
+    int slots;          /* what will be left over once it starts */
+    long long mem;
+    long long cores;
+} resv_t;
+
+/**
+ * long sched_estimate(const job_t *)
+ *
+ * @brief  Estimates how long a job runs for, in seconds.
+ *
+ * @param job  The job
+ *
+ * @return  The job's walltime, or its cpu limit if it was not given one.
+ **/
+static long sched_estimate(const job_t *job)
+{
+    return (job->walltime ? job->walltime : job->maxcpu);
+}
+
+/**
+ * time_t sched_end(const job_t *)
+ *
+ * @brief  Estimates when a running job ends.
+ *
+ * @param job  The job
+ *
+ * @return  The time it started, plus its estimated run time.
+ **/
+static time_t sched_end(const job_t *job)
+{
+    return job->started + sched_estimate(job);
+}
+
+/**
+ * void sched_reserve(job_t *, resv_t *)
+ *
+ * @brief  Computes the reservation of a job which does not fit right now:
+ *         running jobs are assumed to finish once their estimated run time is
+ *         up, in that order, until the job would fit. A job which is past its
+ *         estimate is expected to finish any moment now. Suspended jobs are
+ *         not expected to finish at all, so a job may never fit; then only
+ *         what is free right now is left over.
+ *
+ * @param job  The job
+ * @param resv  Where to store the reservation
+ **/
+static void sched_reserve(job_t *job, resv_t *resv)
+{
+    time_t now = time(NULL);
+
+    resv_t avail = {
+        .shadow = now,
+        .slots = server->maxjobs - server->numjobs,
+        .mem = (server->mem_budget > 0 ?
+                (long long)(server->mem_budget - server->mem_used) : LLONG_MAX),
+        .cores = (server->core_budget > 0 ?
+                (long long)server->core_budget - server->cores_used : LLONG_MAX)
+    };
+    *resv = avail;
+
+    int fits = 0;
+    for(job_t *j = server->ending; ; j = j->enext)
+    {
+        if(resv->slots >= 1 && resv->mem >= job->maxmem &&
+           resv->cores >= job->cores)
+        {
+            fits = 1;
+            break;
+        }
+        if(!j)
+            break;
+
+        time_t end = sched_end(j);
+        resv->shadow = (end > now ? end : now);
+        resv->slots++;
+        if(j->admitted && server->mem_budget > 0)
+            resv->mem += j->maxmem;
+        if(j->admitted && server->core_budget > 0)
+            resv->cores += j->cores;
+    }
+
+    /* not even once everything running is done, so there is no telling
+     * when it will; nothing may start beyond what is free right now */
+    if(!fits)
+    {
+        *resv = avail;
+    }
+    else
+    {
+        resv->slots -= 1;
+        resv->mem -= job->maxmem;
+        resv->cores -= job->cores;
+    }
+    debug("reservation at %ld, leaving %d slots, %lld mem, %lld cores",
+            (long)resv->shadow, resv->slots, resv->mem, resv->cores);
+}
+
+/**
+ * int sched_backfills(job_t *, resv_t *)
+ *
+ * @brief  Determines whether a job which fits right now may start without
+ *         delaying a reservation. One which would still be running by then
+ *         takes its share of what the reservation leaves over.
+ *
+ * @param job  The job
+ * @param resv  The reservation
+ *
+ * @return  1 if the job may start, 0 if it has to wait.
+ **/
+static int sched_backfills(job_t *job, resv_t *resv)
+{
+    if(time(NULL) + sched_estimate(job) <= resv->shadow)
+        return 1;
+
+    if(resv->slots < 1 || resv->mem < job->maxmem || resv->cores < job->cores)
+        return 0;
+
+    resv->slots--;
+    resv->mem -= job->maxmem;
+    resv->cores -= job->cores;
+    return 1;
+}
+
+/**
+ * int sched_dispatch()
+ *
+ * @brief  Starts queued jobs until either nothing is queued, the server is
+ *         running as many jobs as it is allowed to, or none of the next
+ *         SCHED_SCAN jobs fit within the remaining budgets. Preempted jobs
+ *         are resumed first, as long as they are at least as urgent as the
+ *         queued job they would otherwise make wait. Under backfill, jobs
+ *         behind one which does not fit must not delay its reservation.
+ *
+ * @return  The number of jobs started.
+ **/
+int sched_dispatch()
+{
+    static int dispatching = 0;
+    debug("sched_dispatch() - ENTER");
+    int retval = 0;
+    int scanned = 0;
+    int reserved = 0;
+    resv_t resv = { 0 };
+    job_t *j = NULL, *skipped = NULL;
+
+    /* refusing a job may queue another (the next task of its array, or one
+     * following it), which the loop below gets to anyway */
+    if(dispatching)
+        goto sched_dispatch_end;
+    dispatching = 1;
+
+    /* with preemption, a job may get in even when every slot is taken */
+    while((server->numjobs < server->maxjobs || server->preempt) &&
+          scanned < SCHED_SCAN && (j = sched_dequeue()))
+    {
+        if(sched_refuse(j))
+            continue;
+
+        sched_resume(j->priority);
+
+        /* a job which would delay the reservation is set aside before it
+         * gets to suspend anything */
+        resv_t left = resv;
+        if(reserved && !sched_backfills(j, &left))
+        {
+            debug("job would delay the reservation");
+            j->qnext = skipped;
+            skipped = j;
+            scanned++;
+            continue;
+        }
+
+        if(!sched_fits(j) && !sched_preempt(j))
+        {
+            /* nothing behind it can start either */
+            if(server->numjobs >= server->maxjobs)
+            {
+                sched_requeue(j);
+                break;
+            }
+
+            if(server->backfill && !reserved)
+            {
+                sched_reserve(j, &resv);
+                reserved = 1;
+            }
+
+            /* set it aside, it goes back in front of the queue once the
+             * jobs behind it have had their chance */
+            j->qnext = skipped;
+            skipped = j;
+            scanned++;
+            continue;
+        }
+
+        resv = left;
+
+        debug("starting new job");
+        if(exec_job(j->owner, j) < 0)
+        {
+            debug("exec_job() failed");
+
+            /* it keeps its place until there is room for it, but one which
+             * cannot be started at all is given up on */
+            if(server->numjobs >= server->maxjobs)
+            {
+                sched_requeue(j);
+                break;
+            }
+            error("failed to start job %u, aborting it", j->jobid);
+            jobs_abort(j, 0);
+            continue;
+        }
+        retval++;
+    }
+
+    /* most recently skipped first, so the queue ends up in its old order */
+    while(skipped)
+    {
+        j = skipped;
+        skipped = j->qnext;
+        sched_requeue(j);
+    }
+
+    /* whatever room is left goes to the jobs which were preempted */
+    sched_resume(INT32_MAX);
+    dispatching = 0;
+
+sched_dispatch_end:
+    debug("sched_dispatch() - EXIT [%d]", retval);
+    return retval;
+}
+
+/**
+ * int sched_submit(job_t *)
+ *
+ * @brief  Admits a newly submitted job. It is started right away if there is
+ *         room for it and nothing is waiting, otherwise it is queued.
+ *
+ * @param job  The job which was submitted
+ *
+ * @return  0 on success, -1 on failure
+ **/
+int sched_submit(job_t *job)
+{
+    debug("sched_submit() - ENTER [job @ %p]", job);
+    int retval = 0;
+
+    VALIDATE(job, "job must be non NULL", -1, sched_submit_end);
+
+    if(sched_refuse(job))
+        goto sched_submit_end;
+
+    if(server->nqueued > 0 || !sched_fits(job))
+    {
+        debug("%d / %d jobs, queueing", server->numjobs, server->maxjobs);
+        retval = sched_enqueue(job) < 0 ? -1 : 0;
+
+        /* it may still fit in a gap the jobs ahead of it are too big for, or
+         * be urgent enough to preempt a running job */
+        if(retval == 0 && (server->nqueued > 1 || server->preempt))
+            sched_dispatch();
+        goto sched_submit_end;
+    }
+
+    retval = exec_job(job->owner, job);
+
+sched_submit_end:
+    debug("sched_submit() - EXIT [%d]", retval);
+    return retval;
+}
+
+/**
+ * int sched_refuse(job_t *)
+ *
+ * @brief  Keeps a job from starting while its owner is over its output
+ *         quota. The job ends up in the QUOTA state without having run, and
+ *         is archived; freeing it releases the jobs waiting on it.
+ *
+ * @param job  A job which is about to be admitted, and is in no queue
+ *
+ * @return  1 if the job was refused, and is gone, 0 if it may start.
+ **/
+int sched_refuse(job_t *job)
+{
+    if(!output_quota(job->owner))
+        return 0;
+
+    debug("client is over its output quota, refusing job %u", job->jobid);
+    job->status = QUOTA;
+    jobs_notify(job);
+    if(jobs_archive(job->owner, job) < 0)
+        error("failed to archive refused job");
+
+    return 1;
+}
+
+/**
+ * int sched_set_priority(job_t *, int)
+ *
+ * @brief  Changes the priority of a job. Under the priority policy, a queued
+ *         job moves to its new place in the queue; a running one moves to its
+ *         new place among the running jobs, so sched_preempt() still finds
+ *         the least urgent first.
+ *
+ * @param job  The job
+ * @param priority  The new priority level (niceness)
+ *
+ * @return  0 on success, -errno on failure
+ **/
+int sched_set_priority(job_t *job, int priority)
+{
+    int retval = 0;
+
+    VALIDATE(job, "job must be non NULL", -EINVAL, sched_set_priority_end);
+
+    job->priority = priority;
+    if(job->queued && server->policy == POLICY_PRIO)
+    {
+        job->qkey = sched_key(job);
+        heap_sift(job->heapidx);
+    }
+    else if(job->running)
+    {
+        sched_vacate(job);
+        sched_occupy(job);
+    }
+
+sched_set_priority_end:
+    return retval;
+}
+
+/**
+ * int sched_victim(job_t *, job_t *)
+ *
+ * @brief  Determines whether a job may be preempted in favor of another.
+ *
+ * @param victim  The running job
+ * @param job  The job which needs room
+ *
+ * @return  1 if victim is running and less urgent than job, 0 otherwise.
+ **/
+static int sched_victim(job_t *victim, job_t *job)
+{
+    return victim != job && victim->status == RUNNING && victim->pgid > 0 &&
+           victim->priority > job->priority;
+}
+
+/**
+ * int sched_preempt(job_t *)
+ *
+ * @brief  Makes room for a job by suspending running jobs which are less
+ *         urgent than it, least urgent (and then most recently submitted)
+ *         first. Nothing is suspended unless suspending all of those jobs
+ *         would make enough room.
+ *
+ * @param job  The job which needs room
+ *
+ * @return  1 if the job fits now, 0 otherwise.
+ **/
+int sched_preempt(job_t *job)
+{
+    if(!server->preempt || !job)
+        return 0;
+
+    /* what suspending every less urgent job would give back. those are all
+     * at the front of the running jobs. */
+    int n = 0;
+    unsigned long long mem = 0;
+    uint32_t cores = 0;
+    for(job_t *j = server->running; j && j->priority > job->priority;
+        j = j->rnext)
+    {
+        if(!sched_victim(j, job))
+            continue;
+
+        n++;
+        if(j->admitted)
+        {
+            mem += j->maxmem;
+            cores += j->cores;
+        }
+    }
+
+    if(n == 0 || server->numjobs - n >= server->maxjobs)
+        return 0;
+    if(server->mem_budget > 0 &&
+       server->mem_used - mem + job->maxmem > server->mem_budget)
+        return 0;
+    if(server->core_budget > 0 &&
+       server->cores_used - cores + job->cores > server->core_budget)
+        return 0;
+
+    while(!sched_fits(job))
+    {
+        job_t *v = server->running;
+        while(v && v->priority > job->priority && !sched_victim(v, job))
+            v = v->rnext;
+
+        if(!v || !sched_victim(v, job) || jobs_kill(v, SIGSTOP) < 0)
+            break;
+
+        /* the stop is reaped later on, and is no change by then */
+        debug("preempting job %d of \'%s\'", v->jobid, v->owner->name);
+        v->status = SUSPENDED;
+        v->preempted = 1;
+        v->pnext = server->preempted;
+        server->preempted = v;
+        sched_vacate(v);
+        sched_release(v);
+        jobs_notify(v);
+    }
+
+    return sched_fits(job);
+}
+
+/**
+ * int sched_resume(int)
+ *
+ * @brief  Resumes preempted jobs which fit, most urgent first. Only jobs with
+ *         a priority of at least the given level (a nice value no higher than
+ *         it) are resumed.
+ *
+ * @param priority  The least urgent level to resume
+ *
+ * @return  The number of jobs resumed.
+ **/
+int sched_resume(int priority)
+{
+    int retval = 0;
+
+    while(server->preempted)
+    {
+        job_t *best = NULL;
+        for(job_t *j = server->preempted; j; j = j->pnext)
+        {
+            if(j->priority <= priority && sched_fits(j) &&
+               (!best || j->priority < best->priority))
+                best = j;
+        }
+
+        if(!best)
+            break;
+
+        debug("resuming preempted job %d of \'%s\'", best->jobid,
+                best->owner->name);
+        sched_unpreempt(best);
+        sched_acquire(best);
+        if(place_move(best) < 0)
+            error("failed to move resumed job to its new cpus");
+        run_in_background(best, 1);
+        sched_occupy(best);
+        jobs_notify(best);
+        retval++;
+    }
+
+    return retval;
+}
+
+/**
+ * void sched_continued(job_t *)
+ *
+ * @brief  Notes that a job was continued. A preempted job which was resumed
+ *         by hand takes back its share of the budgets, even if that goes over
+ *         them, since it is running regardless.
+ *
+ * @param job  The job which continued
+ **/
+void sched_continued(job_t *job)
+{
+    if(!job || !job->preempted)
+        return;
+
+    sched_unpreempt(job);
+    sched_acquire(job);
+    if(place_move(job) < 0)
+        error("failed to move resumed job to its new cpus");
+}
+
+/**
+ * int sched_urgent(const job_t *, const job_t *)
+ *
+ * @brief  Orders running jobs for preemption.
+ *
+ * @return  1 if a is more urgent than b (a lower nice value, or else an
+ *          earlier submission), 0 otherwise.
+ **/
+static int sched_urgent(const job_t *a, const job_t *b)
+{
+    if(a->priority != b->priority)
+        return a->priority < b->priority;
+    return timercmp(&a->stamp, &b->stamp, <);
+}
+
+/**
+ * void sched_occupy(job_t *) / void sched_vacate(job_t *)
+ *
+ * @brief  A job starts (or goes back to) running, taking one of the maxjobs
+ *         slots, or stops running and gives it back. Running jobs are kept
+ *         least urgent first, where sched_preempt() looks for its victims,
+ *         and soonest expected to end first, for sched_reserve(). Both may be
+ *         called more than once for the same job; only the first call has any
+ *         effect.
+ **/
+void sched_occupy(job_t *job)
+{
+    if(!job || job->running)
+        return;
+
+    job_t *prev = NULL, *next = server->running;
+    while(next && !sched_urgent(next, job))
+    {
+        prev = next;
+        next = next->rnext;
+    }
+
+    job->rprev = prev;
+    job->rnext = next;
+    if(prev)
+        prev->rnext = job;
+    else
+        server->running = job;
+    if(next)
+        next->rprev = job;
+
+    prev = NULL;
+    next = server->ending;
+    while(next && sched_end(next) <= sched_end(job))
+    {
+        prev = next;
+        next = next->enext;
+    }
+
+    job->eprev = prev;
+    job->enext = next;
+    if(prev)
+        prev->enext = job;
+    else
+        server->ending = job;
+    if(next)
+        next->eprev = job;
+
+    job->running = 1;
+    server->numjobs++;
+}
+
+void sched_vacate(job_t *job)
+{
+    if(!job || !job->running)
+        return;
+
+    if(job->rprev)
+        job->rprev->rnext = job->rnext;
+    else
+        server->running = job->rnext;
+    if(job->rnext)
+        job->rnext->rprev = job->rprev;
+
+    if(job->eprev)
+        job->eprev->enext = job->enext;
+    else
+        server->ending = job->enext;
+    if(job->enext)
+        job->enext->eprev = job->eprev;
+
+    job->rprev = job->rnext = NULL;
+    job->eprev = job->enext = NULL;
+    job->running = 0;
+    server->numjobs--;
+}
+
+/**
+ * int sched_admissible(job_t *)
+ *
+ * @brief  Determines whether a job could ever run under the server's budgets.
+ *
+ * @param job  The job
+ *
+ * @return  1 if the job fits within an otherwise idle server, 0 otherwise.
+ **/
+int sched_admissible(job_t *job)
+{
+    if(server->mem_budget > 0 && job->maxmem > server->mem_budget)
+        return 0;
+    if(server->core_budget > 0 && job->cores > server->core_budget)
+        return 0;
+
+    return 1;
+}
+
+/**
+ * int sched_fits(job_t *)
+ *
+ * @brief  Determines whether a job can be started right now.
+ *
+ * @param job  The job
+ *
+ * @return  1 if there is a free slot and room left in the budgets, 0 otherwise.
+ **/
+int sched_fits(job_t *job)
+{
+    if(server->numjobs >= server->maxjobs)
+        return 0;
+    if(server->mem_budget > 0 &&
+       server->mem_used + job->maxmem > server->mem_budget)
+        return 0;
+    if(server->core_budget > 0 &&
+       server->cores_used + job->cores > server->core_budget)
+        return 0;
+
+    return 1;
+}
+
+/**
+ * void sched_acquire(job_t *) / void sched_release(job_t *)
+ *
+ * @brief  Charges a starting job's declared memory and cores against the
+ *         budgets, or returns them once it is gone. Both may be called more
+ *         than once for the same job; only the first call has any effect.
+ **/
+void sched_acquire(job_t *job)
+{
+    if(!job || job->admitted)
+        return;
+
+    server->mem_used += job->maxmem;
+    server->cores_used += job->cores;
+    job->admitted = 1;
+
+    if(server->ncpus > 0 && place_acquire(job) < 0)
+        error("failed to place job, it will run unpinned");
+}
+
+void sched_release(job_t *job)
+{
+    if(!job || !job->admitted)
+        return;
+
+    server->mem_used -= job->maxmem;
+    server->cores_used -= job->cores;
+    job->admitted = 0;
+
+    place_release(job);
+}
+
+/**
+ * void sched_charge(job_t *)
+ *
+ * @brief  Charges the cpu time used by a finished job to its owner, for use
+ *         by the fair-share policy.
+ *
+ * @param job  The job which finished
+ **/
+void sched_charge(job_t *job)
+{
+    if(!job || !job->owner)
+        return;
+
+    double used = job->ru.ru_utime.tv_sec + job->ru.ru_stime.tv_sec +
+                  (job->ru.ru_utime.tv_usec + job->ru.ru_stime.tv_usec) / 1e6;
+
+    job->owner->usage = sched_usage(job->owner, time(NULL)) + used;
+    debug("client \'%s\' charged %.3fs (usage now %.3fs)",
+            job->owner->name, used, job->owner->usage);
+}
+
+/**
+ * int sched_set_weight(const char *)
+ *
+ * @brief  Records a fair-share weight, given as `name=weight`.
+ *
+ * @param spec  The weight specification
+ *
+ * @return  0 on success, -errno on failure
+ **/
+int sched_set_weight(const char *spec)
+{
+    int retval = 0;
+    char *eq = NULL, *endp = NULL;
+
+    VALIDATE(spec, "spec must be non NULL", -EINVAL, sched_set_weight_end);
+    VALIDATE((eq = strchr(spec, '=')) && eq != spec,
+            "weight must be of the form name=weight",
+            -EINVAL,
+            sched_set_weight_end);
+
+    double w = strtod(eq + 1, &endp);
+    VALIDATE(*endp == '\0' && endp != eq + 1 && w > 0,
+            "weight must be a positive number",
+            -EINVAL,
+            sched_set_weight_end);
+
+    weight_t *wt = NULL;
+    MALLOC(wt, sizeof(weight_t));
+    wt->name = strndup(spec, eq - spec);
+    wt->weight = w;
+    wt->next = server->weights;
+    server->weights = wt;
+
+sched_set_weight_end:
+    return retval;
+}
+
+/**
+ * double sched_weight(const char *)
+ *
+ * @brief  Looks up the fair-share weight for a client.
+ *
+ * @param name  The name of the client
+ *
+ * @return  The client's weight, or 1 if none was configured.
+ **/
+double sched_weight(const char *name)
+{
+    for(weight_t *w = server->weights; w; w = w->next)
+    {
+        if(strcmp(w->name, name) == 0)
+            return w->weight;
+    }
+
+    return 1.0;
+}
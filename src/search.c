@@ -0,0 +1,644 @@
+/**
+ * @file search.c
+ * @author Daniel Calabria
+ *
+ * Searching the output of all of a client's finished jobs.
+ *
+ * A JOB_SEARCH request asks which of a client's finished jobs wrote a fixed
+ * string, and where. Without an index, every stream of every job the client
+ * has is searched. A server started with -I keeps an index for each client
+ * instead: for every trigram (three consecutive bytes) which appears in the
+ * output, the list of documents (streams of jobs) it appears in. Only the
+ * documents containing every trigram of the string can contain the string,
+ * so only those are searched to find the lines it is on.
+ *
+ * The output of a job is queued for indexing as the job is archived, and the
+ * main loop indexes up to SEARCH_BURST bytes between waiting for requests,
+ * so that indexing a large output never holds the server up. Output not
+ * indexed yet is searched in full. The lists of documents hold the gaps
+ * between them as varints, mostly a byte each. The documents of expunged jobs
+ * stay in the lists until they make up more than half of an index, which is
+ * then built again from what the client still has.
+ *
+ * Output which is not text can hold most of the 2^24 trigrams, so an index
+ * may take up at most SEARCH_MAXINDEX bytes. One which would grow past that
+ * is given up, and the client's output searched in full, until it has
+ * expunged half of the jobs it had then, when the index is built again.
+ **/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "common.h"
+#include "debug.h"
+#include "server.h"
+#include "client.h"
+#include "archive.h"
+#include "output.h"
+#include "search.h"
+
+/**
+ * posting_t* search_slot(search_t *, uint32_t, int)
+ *
+ * @brief  Finds the list of documents of a trigram.
+ *
+ * @param s  The index
+ * @param tri  The trigram
+ * @param create  Whether to add an empty list for it, if it has none. The
+ *                table must have room for it.
+ *
+ * @return  The list, or NULL if it has none and none was to be added.
+ **/
+static posting_t* search_slot(search_t *s, uint32_t tri, int create)
+{
+    if(s->tablecap == 0)
+        return NULL;
+
+    uint32_t mask = s->tablecap - 1;
+    uint32_t h = (tri + 1) * 0x9e3779b1;
+    for(h = (h ^ (h >> 15)) & mask; ; h = (h + 1) & mask)
+    {
+        posting_t *p = &s->table[h];
+        if(p->tri == tri + 1)
+            return p;
+        if(p->tri != 0)
+            continue;
+        if(!create)
+            return NULL;
+
+        p->tri = tri + 1;
+        s->ntrigrams++;
+        return p;
+    }
+}
+
+/**
+ * int search_grow(search_t *)
+ *
+ * @brief  Doubles the size of the trigram table of an index, unless that would
+ *         take the index past SEARCH_MAXINDEX bytes.
+ *
+ * @param s  The index
+ *
+ * @return  0 on success, -1 if the index is full.
+ **/
+static int search_grow(search_t *s)
+{
+    posting_t *old = s->table;
+    uint32_t oldcap = s->tablecap;
+    uint32_t cap = (oldcap ? oldcap * 2 : 4096);
+
+    if(s->bytes + sizeof(posting_t) * (cap - oldcap) > SEARCH_MAXINDEX)
+        return -1;
+
+    s->tablecap = cap;
+    s->bytes += sizeof(posting_t) * (cap - oldcap);
+    MALLOC(s->table, sizeof(posting_t) * s->tablecap);
+    s->ntrigrams = 0;
+
+    for(uint32_t i = 0; i < oldcap; i++)
+    {
+        if(old[i].tri == 0)
+            continue;
+        posting_t *p = search_slot(s, old[i].tri - 1, 1);
+        *p = old[i];
+    }
+    FREE(old);
+    return 0;
+}
+
+/**
+ * int search_post(search_t *, uint32_t, uint32_t)
+ *
+ * @brief  Notes that a trigram appears in a document. Documents are indexed
+ *         in ascending order, so a document is only ever added at the end of
+ *         a list, or found there already.
+ *
+ * @param s  The index
+ * @param tri  The trigram
+ * @param doc  The document
+ *
+ * @return  0 on success, -1 if the index would grow past SEARCH_MAXINDEX.
+ **/
+static int search_post(search_t *s, uint32_t tri, uint32_t doc)
+{
+    if((s->ntrigrams + 1) * 2 > s->tablecap && search_grow(s) < 0)
+        return -1;
+
+    posting_t *p = search_slot(s, tri, 1);
+    if(p->last == doc + 1)
+        return 0;
+
+    if(p->len + 5 > p->cap)
+    {
+        uint32_t cap = (p->cap ? p->cap * 2 : 8);
+        if(s->bytes + (cap - p->cap) > SEARCH_MAXINDEX)
+            return -1;
+
+        uint8_t *data = realloc(p->data, cap);
+        if(!data)
+            PERROR_EXIT("realloc()");
+        s->bytes += cap - p->cap;
+        p->data = data;
+        p->cap = cap;
+    }
+
+    for(uint32_t v = doc + 1 - p->last; ; v >>= 7)
+    {
+        if(v < 0x80)
+        {
+            p->data[p->len++] = v;
+            break;
+        }
+        p->data[p->len++] = (v & 0x7f) | 0x80;
+    }
+    p->last = doc + 1;
+    return 0;
+}
+
+/**
+ * uint32_t search_decode(posting_t *, uint32_t *)
+ *
+ * @brief  Lists the documents of a trigram.
+ *
+ * @param p  The list of the trigram
+ * @param docs  Room for at least p->len documents
+ *
+ * @return  The number of documents.
+ **/
+static uint32_t search_decode(posting_t *p, uint32_t *docs)
+{
+    uint32_t n = 0, cur = 0, v = 0, shift = 0;
+
+    for(uint32_t i = 0; i < p->len; i++)
+    {
+        v |= (uint32_t)(p->data[i] & 0x7f) << shift;
+        shift += 7;
+        if(p->data[i] & 0x80)
+            continue;
+
+        cur += v;
+        docs[n++] = cur - 1;
+        v = shift = 0;
+    }
+
+    return n;
+}
+
+/**
+ * void search_push(uint32_t **, uint32_t *, uint32_t *, uint32_t)
+ *
+ * @brief  Appends to an array of keys, growing it if need be.
+ *
+ * @param arr  The array
+ * @param n  Its length
+ * @param cap  Its capacity
+ * @param key  The key to append
+ **/
+static void search_push(uint32_t **arr, uint32_t *n, uint32_t *cap,
+        uint32_t key)
+{
+    if(*n == *cap)
+    {
+        uint32_t c = (*cap ? *cap * 2 : 64);
+        uint32_t *p = realloc(*arr, sizeof(uint32_t) * c);
+        if(!p)
+            PERROR_EXIT("realloc()");
+        *arr = p;
+        *cap = c;
+    }
+    (*arr)[(*n)++] = key;
+}
+
+/**
+ * void search_clear(search_t *)
+ *
+ * @brief  Empties an index, and its queue of documents to be indexed.
+ *
+ * @param s  The index
+ **/
+static void search_clear(search_t *s)
+{
+    for(uint32_t i = 0; i < s->tablecap; i++)
+        FREE(s->table[i].data);
+    FREE(s->table);
+    FREE(s->docs);
+    FREE(s->pending);
+    memset(s, 0, sizeof(search_t));
+}
+
+/**
+ * void search_add(archive_t *, uint32_t)
+ *
+ * @brief  Queues the output of a job which was just archived to be indexed.
+ *
+ * @param a  The archive of the job's owner
+ * @param jobid  The job
+ **/
+void search_add(archive_t *a, uint32_t jobid)
+{
+    if(!server->search_index)
+        return;
+
+    if(!a->search)
+        MALLOC(a->search, sizeof(search_t));
+    search_t *s = a->search;
+    if(s->full)
+        return;
+
+    for(uint32_t k = 0; k < 2; k++)
+        search_push(&s->pending, &s->npending, &s->pendcap, jobid << 1 | k);
+}
+
+/**
+ * void search_forget(archive_t *, int)
+ *
+ * @brief  Called as a job is expunged. Its documents stay in the index, and
+ *         are skipped when searching, until the index is built again; they
+ *         are counted towards doing so. A stream still waiting to be indexed
+ *         is simply skipped when its turn comes.
+ *
+ * @param a  The archive of the job's owner
+ * @param idx  The job's index within the archive
+ **/
+void search_forget(archive_t *a, int idx)
+{
+    if(a->search)
+        a->search->ndead += (a->indexed[idx] & 1) + (a->indexed[idx] >> 1);
+}
+
+/**
+ * void search_free(archive_t *)
+ *
+ * @brief  Releases the index of an archive.
+ *
+ * @param a  The archive
+ **/
+void search_free(archive_t *a)
+{
+    if(!a->search)
+        return;
+
+    search_clear(a->search);
+    FREE(a->search);
+}
+
+/**
+ * void search_rebuild(archive_t *)
+ *
+ * @brief  Starts an index over, with every job still in the archive queued
+ *         to be indexed.
+ *
+ * @param a  The archive
+ **/
+static void search_rebuild(archive_t *a)
+{
+    search_t *s = a->search;
+
+    debug("rebuilding search index, %u of %u documents dead", s->ndead,
+            s->ndocs);
+    search_clear(s);
+    memset(a->indexed, 0, sizeof(*a->indexed) * a->count);
+    for(uint32_t i = 0; i < a->count; i++)
+        for(uint32_t k = 0; k < 2; k++)
+            search_push(&s->pending, &s->npending, &s->pendcap,
+                    a->jobid[i] << 1 | k);
+}
+
+/**
+ * void search_giveup(archive_t *)
+ *
+ * @brief  Drops an index which outgrew SEARCH_MAXINDEX, noting how many jobs
+ *         the archive held, so that it is only built again once half of them
+ *         are gone.
+ *
+ * @param a  The archive
+ **/
+static void search_giveup(archive_t *a)
+{
+    search_t *s = a->search;
+
+    debug("search index outgrew %u bytes, giving it up", SEARCH_MAXINDEX);
+    search_clear(s);
+    memset(a->indexed, 0, sizeof(*a->indexed) * a->count);
+    s->full = (a->count > 0 ? a->count : 1);
+}
+
+/**
+ * uint64_t search_index(client_t *, uint64_t)
+ *
+ * @brief  Indexes queued output of a client's jobs, in order.
+ *
+ * @param c  The client
+ * @param budget  The most bytes to index
+ *
+ * @return  The number of bytes indexed.
+ **/
+static uint64_t search_index(client_t *c, uint64_t budget)
+{
+    search_t *s = c->archive.search;
+    uint64_t done = 0;
+
+    while(s->pendhead < s->npending && done < budget)
+    {
+        uint32_t key = s->pending[s->pendhead];
+        int idx = archive_find(&c->archive, key >> 1);
+        outmap_t m = { NULL, 0, NULL };
+
+        if(idx >= 0 && output_map(c, idx, key & 1, &m) == 0 && m.size >= 3)
+        {
+            const uint8_t *d = (const uint8_t *)m.data;
+            uint64_t end = m.size - 2;
+            if(end > s->cursor + (budget - done))
+                end = s->cursor + (budget - done);
+
+            for(uint64_t i = s->cursor; i < end; i++)
+            {
+                if(search_post(s, d[i] << 16 | d[i + 1] << 8 | d[i + 2],
+                            s->ndocs) < 0)
+                {
+                    output_unmap(&m);
+                    search_giveup(&c->archive);
+                    return done + (i - s->cursor);
+                }
+            }
+            done += end - s->cursor;
+            s->cursor = end;
+
+            if(end < m.size - 2)
+            {
+                output_unmap(&m);
+                break;
+            }
+        }
+        output_unmap(&m);
+
+        /* a document which made it into any list keeps its number, even if
+         * its job went away halfway, in which case it is dead already */
+        if(s->cursor > 0)
+        {
+            search_push(&s->docs, &s->ndocs, &s->doccap, key);
+            if(idx >= 0)
+                c->archive.indexed[idx] |= 1 << (key & 1);
+            else
+                s->ndead++;
+        }
+        s->cursor = 0;
+        if(++s->pendhead == s->npending)
+            s->pendhead = s->npending = 0;
+    }
+
+    return done;
+}
+
+/**
+ * void search_poll()
+ *
+ * @brief  Indexes up to SEARCH_BURST bytes of queued output, and starts over
+ *         the indexes which mostly hold expunged jobs, or were given up and
+ *         have lost half of their jobs since.
+ **/
+void search_poll()
+{
+    uint64_t budget = SEARCH_BURST;
+
+    if(!server->search_index)
+        return;
+
+    for(client_t *c = server->clientlist; c && budget > 0; c = c->next)
+    {
+        search_t *s = c->archive.search;
+        if(!s)
+            continue;
+
+        if(s->full && c->archive.count > s->full / 2)
+            continue;
+        if(s->full || (s->ndead > SEARCH_MINDEAD && s->ndead > s->ndocs / 2))
+            search_rebuild(&c->archive);
+        budget -= search_index(c, budget);
+    }
+}
+
+/**
+ * struct timespec* search_timeout(struct timespec *)
+ *
+ * @brief  Computes how long the main loop may sleep before search_poll()
+ *         needs to run again.
+ *
+ * @param ts  Storage for the timeout
+ *
+ * @return  ts, or NULL if there is nothing to index.
+ **/
+struct timespec* search_timeout(struct timespec *ts)
+{
+    if(!server->search_index)
+        return NULL;
+
+    for(client_t *c = server->clientlist; c; c = c->next)
+    {
+        if(c->archive.search && c->archive.search->npending > 0)
+        {
+            ts->tv_sec = 0;
+            ts->tv_nsec = 0;
+            return ts;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * int search_cmpkey(const void *, const void *)
+ *
+ * @brief  Orders the keys of documents for qsort().
+ *
+ * @param x  A key
+ * @param y  Another key
+ *
+ * @return  <0, 0 or >0 as x is below, equal to or above y
+ **/
+static int search_cmpkey(const void *x, const void *y)
+{
+    uint32_t a = *(const uint32_t *)x, b = *(const uint32_t *)y;
+    return (a > b) - (a < b);
+}
+
+/**
+ * uint32_t search_candidates(archive_t *, query_t *, uint32_t **)
+ *
+ * @brief  Lists the documents which may contain the string searched for: those
+ *         the index has every trigram of the string for, and those not
+ *         indexed yet. Without an index (or for a string too short to have a
+ *         trigram, or once the index was given up) that is every document.
+ *
+ * @param a  The archive of the client searching
+ * @param req  The search
+ * @param keys  Set to the keys of the documents, sorted and to be freed
+ *
+ * @return  The number of documents.
+ **/
+static uint32_t search_candidates(archive_t *a, query_t *req, uint32_t **keys)
+{
+    search_t *s = a->search;
+    uint32_t n = 0, cap = 0, ndocs = 0;
+    uint32_t *docs = NULL, *other = NULL;
+    const uint8_t *pat = (const uint8_t *)req->pattern;
+
+    *keys = NULL;
+    if(!s || s->full || req->patlen < 3)
+    {
+        for(uint32_t i = 0; i < a->count; i++)
+            for(uint32_t k = 0; k < 2; k++)
+                search_push(keys, &n, &cap, a->jobid[i] << 1 | k);
+        return n;
+    }
+
+    /* start from the trigram in the fewest documents */
+    posting_t *first = NULL;
+    for(uint32_t i = 0; i + 2 < req->patlen; i++)
+    {
+        posting_t *p = search_slot(s, pat[i] << 16 | pat[i + 1] << 8 | pat[i + 2], 0);
+        if(!p)
+        {
+            first = NULL;
+            break;
+        }
+        if(!first || p->len < first->len)
+            first = p;
+    }
+
+    if(first)
+    {
+        MALLOC(docs, sizeof(uint32_t) * first->len);
+        ndocs = search_decode(first, docs);
+    }
+
+    for(uint32_t i = 0; ndocs > 0 && i + 2 < req->patlen; i++)
+    {
+        posting_t *p = search_slot(s, pat[i] << 16 | pat[i + 1] << 8 | pat[i + 2], 0);
+        if(p == first)
+            continue;
+
+        other = realloc(other, sizeof(uint32_t) * p->len);
+        if(!other)
+            PERROR_EXIT("realloc()");
+        uint32_t nother = search_decode(p, other), kept = 0;
+        for(uint32_t x = 0, y = 0; x < ndocs && y < nother; )
+        {
+            if(docs[x] < other[y])
+                x++;
+            else if(docs[x] > other[y])
+                y++;
+            else
+            {
+                docs[kept++] = docs[x++];
+                y++;
+            }
+        }
+        ndocs = kept;
+    }
+
+    /* the document being indexed may be in some of the lists already */
+    for(uint32_t i = 0; i < ndocs && docs[i] < s->ndocs; i++)
+        search_push(keys, &n, &cap, s->docs[docs[i]]);
+    for(uint32_t i = s->pendhead; i < s->npending; i++)
+        search_push(keys, &n, &cap, s->pending[i]);
+
+    FREE(docs);
+    FREE(other);
+
+    if(n > 1)
+        qsort(*keys, n, sizeof(uint32_t), search_cmpkey);
+    return n;
+}
+
+/**
+ * int search_serve(conn_t *, query_t *)
+ *
+ * @brief  Answers a JOB_SEARCH request, with a JOB_RESULTS packet holding a
+ *         line for each line of output the string is on, or a NACK if it is
+ *         nowhere. Once SEARCH_MAXRESULTS bytes of lines were found, the rest
+ *         are left out.
+ *
+ * @param conn  The connection the request came from
+ * @param req  The request
+ *
+ * @return  0 on success, -errno on failure
+ **/
+int search_serve(conn_t *conn, query_t *req)
+{
+    debug("search_serve() - ENTER [%u bytes]", req->patlen);
+    int retval = 0;
+    archive_t *a = &conn->client->archive;
+    uint32_t *keys = NULL, nkeys = 0, searched = 0, matches = 0;
+    char *out = NULL;
+    uint64_t len = 0;
+
+    VALIDATE(req->patlen > 0 && strlen(req->pattern) == req->patlen &&
+            !strchr(req->pattern, '\n'), "invalid pattern", -EINVAL,
+            search_serve_end);
+
+    nkeys = search_candidates(a, req, &keys);
+    MALLOC(out, SEARCH_MAXRESULTS);
+
+    for(uint32_t i = 0; i < nkeys; i++)
+    {
+        if((i > 0 && keys[i] == keys[i - 1]) ||
+           (req->maxcount > 0 && matches >= req->maxcount))
+            continue;
+
+        int idx = archive_find(a, keys[i] >> 1);
+        outmap_t m = { NULL, 0, NULL };
+        if(idx < 0 || output_map(conn->client, idx, keys[i] & 1, &m) < 0)
+            continue;
+        searched++;
+
+        /* number the lines the string is on, like grep.c does */
+        const char *d = m.data, *end = m.data + m.size, *scan = d, *hit;
+        uint64_t line = 1;
+        while((req->maxcount == 0 || matches < req->maxcount) &&
+              (hit = memmem(scan, end - scan, req->pattern, req->patlen)))
+        {
+            const char *ls = memrchr(scan, '\n', hit - scan);
+            ls = (ls ? ls + 1 : scan);
+            for(const char *p = scan; (p = memchr(p, '\n', ls - p)); p++)
+                line++;
+
+            char entry[96];
+            int n = snprintf(entry, sizeof(entry),
+                    "[%u] %s line %llu, offset %llu\n", keys[i] >> 1,
+                    (keys[i] & 1 ? "stderr" : "stdout"),
+                    (unsigned long long)line, (unsigned long long)(ls - d));
+            if(len + n > SEARCH_MAXRESULTS)
+                break;
+            memcpy(out + len, entry, n);
+            len += n;
+            matches++;
+
+            scan = memchr(hit, '\n', end - hit);
+            if(!scan)
+                break;
+            scan++;
+            line++;
+        }
+        output_unmap(&m);
+    }
+
+    debug("searched %u of %u documents", searched, nkeys);
+    VALIDATE(len > 0, "nothing matched", -ENOENT, search_serve_end);
+
+search_serve_end:
+    if(conn->client->connected)
+    {
+        results_t results = { len, out };
+        send_pkt(conn->fd, (retval == 0 ? JOB_RESULTS : NACK),
+                (retval == 0 ? &results : NULL));
+    }
+    FREE(keys);
+    FREE(out);
+    debug("search_serve() - EXIT [%d, %u matches]", retval, matches);
+    return retval;
+}
@@ -20,13 +20,26 @@
 #include <sys/time.h>
 #include <sys/resource.h>
 #include <sys/wait.h>
-#include <sys/mman.h>
 
 #include "common.h"
 #include "debug.h"
 #include "server.h"
 #include "proto.h"
 #include "conn.h"
+#include "sched.h"
+#include "place.h"
+#include "cgroup.h"
+#include "depend.h"
+#include "array.h"
+#include "spawn.h"
+#include "launcher.h"
+#include "cache.h"
+#include "feed.h"
+#include "output.h"
+#include "lines.h"
+#include "grep.h"
+#include "search.h"
+#include "spool.h"
 
 server_t *server;
 
@@ -50,6 +63,93 @@ void server_handler(int sig)
         debug_enabled = !debug_enabled;
 }
 
+/**
+ * void server_reap(job_t *, int, struct rusage *)
+ *
+ * @brief  Handles a change in state of one of our jobs, as reported by
+ *         wait4(): the slot and budgets it held, the client and the jobs
+ *         waiting on it are all updated, and a finished job is archived.
+ *
+ * @param j  The job
+ * @param status  The status from wait4()
+ * @param ru  The rusage from wait4()
+ **/
+void server_reap(job_t *j, int status, struct rusage *ru)
+{
+    memcpy(&j->ru, ru, sizeof(struct rusage));
+
+    uint32_t was = j->status;
+    job_update_status(j, status);
+
+    /* whatever it wrote last is still in its pipes. a job which wrote more
+     * than it may ends up in a state of its own, however it ended. */
+    if(JOB_FINISHED(j->status))
+    {
+        output_finished(j);
+        if(j->overquota || (j->status == ABORTED && j->maxout > 0 &&
+                    j->exitcode == SIGXFSZ))
+            j->status = QUOTA;
+    }
+    debug("pid %d changed to \'%s\'", j->pgid, jobs_status_as_char(j->status));
+
+    /* only a running job holds one of the maxjobs slots. the server marks the
+     * jobs it stops or continues itself right away, so their reports here are
+     * no change. */
+    if(was != RUNNING && j->status == RUNNING)
+        sched_occupy(j);
+    else if(was == RUNNING && j->status != RUNNING)
+        sched_vacate(j);
+
+    debug("status=%d", j->status);
+    switch(j->status)
+    {
+        case RUNNING:
+            sched_continued(j);
+            break;
+
+        case SUSPENDED:
+        case EXITED:
+        case ABORTED:
+        case QUOTA:
+        {
+            /* if a job just stopped, see if we can start another one. a
+             * suspended job keeps its memory, so it keeps its share of the
+             * budgets too, unless it was preempted. a finished one is
+             * archived first, so its output counts towards its owner's
+             * quota by then. */
+            if(j->status != SUSPENDED)
+                sched_release(j);
+            if(!JOB_FINISHED(j->status))
+                sched_dispatch();
+            break;
+        }
+
+        default:
+            break;
+    }
+
+    /* send an update packet to the client */
+    jobs_notify(j);
+
+    /* finished jobs only need to be kept in compact form */
+    if(JOB_FINISHED(j->status))
+    {
+        /* count every process of the job, not just the first */
+        if(j->cgpath)
+            cgroup_collect(j);
+        sched_charge(j);
+
+        /* keep its result for identical jobs, or start one in its place */
+        cache_finished(j);
+
+        /* the jobs which were waiting on it are started (or failed) as it
+         * is freed, once archived */
+        if(jobs_archive(j->owner, j) < 0)
+            error("failed to archive finished job");
+        sched_dispatch();
+    }
+}
+
 /**
  * void handle_all_signals()
  *
@@ -73,64 +173,16 @@ void handle_all_signals()
             job_t *j = NULL;
             if((j = jobs_lookup_by_pid(server->joblist, pid)) == NULL)
             {
+                /* the launcher itself, or a job it started which we do not
+                 * know the pid of yet */
+                if(launcher_reaped(pid, status, &ru))
+                    continue;
+
                 debug("failed to locate job for pid=%d", pid);
                 continue;
             }
 
-            memcpy(&j->ru, &ru, sizeof(struct rusage));
-
-            job_update_status(j, status);
-            debug("pid %d changed to \'%s\'", j->pgid, jobs_status_as_char(j->status));
-
-            debug("status=%d", j->status);
-            switch(j->status)
-            {
-                case RUNNING:
-                    server->numjobs++;
-                    break;
-
-                case SUSPENDED:
-                case EXITED:
-                case ABORTED:
-                {
-                    /* if a job just stopped, see if we can start another one */
-                    server->numjobs--;
-
-                    job_t *j = server->joblist;
-                    while(j && server->numjobs < server->maxjobs)
-                    {
-                        /* only try to start NEW jobs */
-                        if(j->status == NEW)
-                        {
-                            debug("starting new job");
-                            if(exec_job(j->owner, j) < 0)
-                            {
-                                debug("exec_job() failed");
-                            }
-                        }
-
-                        j = j->snext;
-                    }
-
-                    break;
-                }
-
-                default:
-                    break;
-            }
-
-            conn_t *conn = conn_find_by_client(j->owner);
-            if(!conn)
-                continue;
-
-            /* send an update packet to the client */
-            update_t *u = NULL;
-            MALLOC(u, sizeof(update_t));
-            u->jobid = j->jobid;
-            u->status = j->status;
-            if(conn->client && conn->client->connected)
-                send_pkt(conn->fd, JOB_UPDATE, u);
-            FREE(u);
+            server_reap(j, status, &ru);
         }
 
         need_to_reap = 0;
@@ -165,19 +217,45 @@ void server_shutdown(int exitcode)
         c = cn;
     }
 
+    /* learn the pids of any jobs still being launched */
+    launcher_shutdown();
+
+    /* cancel every job first, so that none of them starts in place of an
+     * identical job of another client as that one is freed */
+    for(client_t *cl = server->clientlist; cl; cl = cl->next)
+        cancel_all_jobs(cl);
+
     /* delete all clients and their corresponding jobs */
     client_t *cl = server->clientlist;
     while(cl)
     {
         client_t *cln = cl->next;
-        cancel_all_jobs(cl);
         wait_for_all(cl);
         free_jobs(cl);
+        array_free_all(cl);
+        archive_free(&cl->archive, cl->name);
+        FREE(cl->spooldirs);
         FREE(cl->name);
         FREE(cl);
         cl = cln;
     }
 
+    FREE(server->heap);
+    place_free();
+    spawn_free();
+    cache_free();
+    spool_free();
+    cgroup_shutdown();
+
+    /* fair-share weights */
+    while(server->weights)
+    {
+        weight_t *w = server->weights->next;
+        FREE(server->weights->name);
+        FREE(server->weights);
+        server->weights = w;
+    }
+
     /* delete the socket */
     if(unlink(server->socket_file) < 0)
         perror("unlink()");
@@ -201,6 +279,9 @@ int server_init()
     MALLOC(server, sizeof(server_t));
     memset(server, 0, sizeof(server_t));
     server->maxjobs = INT_MAX;
+    server->aging = PRIO_AGING;
+    server->outmode = OUTPUT_FILES;
+    server->spill = OUTPUT_SPILL;
     server->socket_file = strdup(SOCKET_NAME);
 
     return 0;
@@ -223,6 +304,17 @@ int server_handle_client(conn_t *conn)
 
     VALIDATE(conn, "conn must not be NULL", -EINVAL, server_handle_client_end);
 
+    /* the rest of a JOB_INPUT packet comes before anything else */
+    if(conn->in_left > 0)
+    {
+        if(feed_forward(conn) < 0)
+        {
+            debug("client %d went away while sending input", conn->fd);
+            server_disconnect_client(conn);
+        }
+        goto server_handle_client_end;
+    }
+
     if((r = recv_pkt(conn->fd, &payload)) < 0)
     {
         debug("error dealing with client %d. disconnecting it", conn->fd);
@@ -241,7 +333,7 @@ int server_handle_client(conn_t *conn)
             debug("server received login packet for %s", name);
             conn->client = server_login_client(name);
             FREE(name);
-            if(conn->client && conn->client->connected)
+            if(!conn->client || conn->client->connected)
                 send_pkt(conn->fd, (conn->client ? ACK : NACK), NULL);
             break;
         }
@@ -256,12 +348,31 @@ int server_handle_client(conn_t *conn)
 
             user_input_t *ui = NULL;
             ui = parse_input(s->cmdline);
-            if(!ui)
+
+            /* tasks of an array can not wait on other jobs, nor be cached, and
+             * neither arrays nor cached jobs can be fed their stdin. a cached
+             * job's output has to be in its files. */
+            int badarray = (s->ntasks > ARRAY_MAXTASKS ||
+                    (s->ntasks > 0 && (s->ndeps > 0 || s->fplen > 0 ||
+                                       s->array_lo > UINT32_MAX - s->ntasks)));
+            int badinput = (s->input && (s->ntasks > 0 || s->fplen > 0));
+            int badoutput = (s->output > OUTPUT_DISCARD ||
+                    (s->fplen > 0 && s->output > OUTPUT_FILES));
+
+            /* a client over its quota gets no new arrays; its single jobs end
+             * up in the QUOTA state below */
+            int overquota = (s->ntasks > 0 && output_quota(conn->client));
+            if(!ui || badarray || badinput || badoutput || overquota ||
+               depend_check(conn->client, s->deps, s->ndeps) < 0)
             {
-                debug("parse_input() failed");
+                debug("parse_input(), depend_check() or array check failed");
+                free_input(ui);
                 for(int i = 0; i < s->envpc; i++)
                     FREE(s->envp[i]);
+                FREE(s->envp);
+                FREE(s->deps);
                 FREE(s->cmdline);
+                FREE(s->fingerprint);
                 FREE(s);
                 if(conn->client && conn->client->connected)
                     send_pkt(conn->fd, NACK, NULL);
@@ -275,8 +386,73 @@ int server_handle_client(conn_t *conn)
             j->maxmem = s->maxmem;
             j->maxcpu = s->maxcpu;
             j->priority = s->priority;
-            j->envpc = s->envpc;
-            j->envp = s->envp;
+            j->cores = (s->cores ? s->cores : 1);
+            j->walltime = s->walltime;
+
+            /* a cached result is kept as links to the output files */
+            if(s->output != OUTPUT_DEFAULT)
+                j->outmode = s->output;
+            else if(s->fplen == 0)
+                j->outmode = server->outmode;
+            j->maxout = s->maxout;
+
+            /* a job which would not fit even on an idle server never runs */
+            if(!sched_admissible(j) || (s->input && feed_open(j) < 0))
+            {
+                debug("job exceeds the budgets, or failed to get its stdin");
+                free_job(j);
+                for(int i = 0; i < s->envpc; i++)
+                    FREE(s->envp[i]);
+                FREE(s->envp);
+                FREE(s->deps);
+                FREE(s->cmdline);
+                FREE(s->fingerprint);
+                FREE(s);
+                if(conn->client && conn->client->connected)
+                    send_pkt(conn->fd, NACK, NULL);
+                retval = -1;
+                goto server_handle_client_end;
+            }
+
+            if(jobs_build_launch(j, s->envp, s->envpc) < 0)
+            {
+                error("failed to build launch block for job");
+                exit(EXIT_FAILURE);
+            }
+
+            if(s->fingerprint && cache_prepare(j, s->fingerprint) < 0)
+            {
+                error("failed to make job cacheable");
+                exit(EXIT_FAILURE);
+            }
+
+            /* an array keeps the job as the template for its tasks, which are
+             * created as the earlier ones start */
+            if(s->ntasks > 0)
+            {
+                array_t *a = array_create(conn->client, j, s->array_lo,
+                        s->array_lo + (s->ntasks - 1), s->array_cap);
+                if(!a)
+                {
+                    error("failed to create job array");
+                    exit(EXIT_FAILURE);
+                }
+
+                for(int i = 0; i < s->envpc; i++)
+                    FREE(s->envp[i]);
+                FREE(s->envp);
+                FREE(s->cmdline);
+                FREE(s->fingerprint);
+                FREE(s);
+                if(conn->client && conn->client->connected)
+                    send_pkt(conn->fd, JOB_SUBMIT_SUCCESS, &a->jobid);
+                printf("client \'%s\' submitted a new job array.\n",
+                        conn->client->name);
+
+                if(array_feed(a))
+                    sched_dispatch();
+                break;
+            }
 
             if(jobs_insert(conn->client, j) < 0)
             {
@@ -285,15 +461,41 @@ int server_handle_client(conn_t *conn)
             }
 
             debug("jobid is %d", j->jobid);
+            int nwait = depend_attach(conn->client, j, s->deps, s->ndeps);
             for(int i = 0; i < s->envpc; i++)
                 FREE(s->envp[i]);
+            FREE(s->envp);
+            FREE(s->deps);
             FREE(s->cmdline);
+            FREE(s->fingerprint);
             FREE(s);
             if(conn->client && conn->client->connected)
                 send_pkt(conn->fd, JOB_SUBMIT_SUCCESS, &j->jobid);
             printf("client \'%s\' submitted a new job.\n", conn->client->name);
 
-            if(exec_job(conn->client, j) < 0)
+            /* jobs waiting on others are started by depend_release() */
+            if(nwait < 0)
+            {
+                debug("job depends on a job which failed");
+                j->status = ABORTED;
+                jobs_notify(j);
+                jobs_archive(conn->client, j);
+                break;
+            }
+            else if(nwait > 0)
+            {
+                j->status = BLOCKED;
+                jobs_notify(j);
+                break;
+            }
+            else if(sched_refuse(j))
+                break;
+
+            /* an identical job may have done (or be doing) the work already */
+            if(j->cacheblob && cache_submit(j))
+                break;
+
+            if(sched_submit(j) < 0)
             {
                 if(conn->client && conn->client->connected)
                     send_pkt(conn->fd, NACK, NULL);
@@ -314,9 +516,18 @@ int server_handle_client(conn_t *conn)
             debug("server received JOB_STATUS for user=%s jobid=%d",
                     conn->client->name, *jobid);
             job_t *j = jobs_lookup_by_jobid(conn->client, *jobid);
+            int idx = j ? -1 : archive_find(&conn->client->archive, *jobid);
+
+            /* an array itself, or one of its tasks which was not created */
+            array_t *a = NULL, *ta = NULL;
+            if(!j && idx < 0)
+            {
+                a = array_find(conn->client, *jobid);
+                ta = (a ? NULL : array_of_task(conn->client, *jobid));
+            }
             FREE(jobid);
 
-            if(!j)
+            if(!j && idx < 0 && !a && !ta)
             {
                 if(conn->client && conn->client->connected)
                     send_pkt(conn->fd, NACK, NULL);
@@ -325,12 +536,30 @@ int server_handle_client(conn_t *conn)
 
             status_t *s = NULL;
             MALLOC(s, sizeof(status_t));
-            s->status = j->status;
-            s->exitcode = j->exitcode;
-            s->maxmem = j->maxmem;
-            s->maxcpu = j->maxcpu;
-            s->priority = getpriority(PRIO_PGRP, j->pgid);
-            memcpy(&s->ru, &j->ru, sizeof(struct rusage));
+            if(a)
+                array_status(a, s);
+            else if(ta)
+            {
+                s->status = (ta->stopped ? ABORTED : NEW);
+                s->maxmem = ta->tmpl->maxmem;
+                s->maxcpu = ta->tmpl->maxcpu;
+                s->priority = ta->tmpl->priority;
+                s->node = -1;
+            }
+            else if(j)
+            {
+                s->status = j->status;
+                s->exitcode = j->exitcode;
+                s->maxmem = j->maxmem;
+                s->maxcpu = j->maxcpu;
+                s->priority = (JOB_PENDING(j->status) || j->launchseq ?
+                        j->priority : getpriority(PRIO_PGRP, j->pgid));
+                s->node = (j->cpus ? j->node : -1);
+                place_format(j, s->cpus, sizeof(s->cpus));
+                memcpy(&s->ru, &j->ru, sizeof(struct rusage));
+            }
+            else
+                archive_status(&conn->client->archive, idx, s);
             if(conn->client && conn->client->connected)
                 send_pkt(conn->fd, JOB_STATUS_RESP, s);
             FREE(s);
@@ -345,13 +574,17 @@ int server_handle_client(conn_t *conn)
                     server_handle_client_end);
             debug("server received JOB_LIST_ALL for user=%s", conn->client->name);
 
-            int jobcount = 0;
+            archive_t *a = &conn->client->archive;
+            int jobcount = a->count;
             job_t *j = conn->client->jobs;
             while(j)
             {
                 jobcount++;
                 j = j->next;
             }
+            array_t *arr = conn->client->arrays;
+            for(; arr; arr = arr->next_array)
+                jobcount++;
 
             if(jobcount <= 0)
             {
@@ -364,16 +597,43 @@ int server_handle_client(conn_t *conn)
             listing_t *mainl = NULL;
             MALLOC(mainl, sizeof(listing_t));
             j = conn->client->jobs;
+            arr = conn->client->arrays;
 
+            /* the live jobs, the archive and the arrays are all ordered by
+             * jobid, so merge them to list everything in order */
+            int idx = 0;
             listing_t *l = mainl, *ln = NULL;
             for(int i = 0; i < jobcount; i++)
             {
                 l->left = jobcount - i - 1;
-                l->jobid = j->jobid;
-                l->cmdline = strdup(j->ui->input);
+                if(arr && (!j || arr->jobid < j->jobid) &&
+                   (idx >= a->count || arr->jobid < a->jobid[idx]))
+                {
+                    char desc[PATH_MAX];
+                    array_describe(arr, desc, sizeof(desc));
+                    l->jobid = arr->jobid;
+                    l->cmdline = strdup(desc);
+                    l->status = ARRAY;
+                    l->exitcode = 0;
+                    arr = arr->next_array;
+                }
+                else if(j && (idx >= a->count || j->jobid < a->jobid[idx]))
+                {
+                    l->jobid = j->jobid;
+                    l->cmdline = strdup(j->ui->input);
+                    l->status = j->status;
+                    l->exitcode = j->exitcode;
+                    j = j->next;
+                }
+                else
+                {
+                    l->jobid = a->jobid[idx];
+                    l->cmdline = strdup(archive_cmdline(a, idx));
+                    l->status = a->status[idx];
+                    l->exitcode = a->exitcode[idx];
+                    idx++;
+                }
                 l->cmdlen = strlen(l->cmdline)+1;
-                l->status = j->status;
-                l->exitcode = j->exitcode;
 
                 if(l->left > 0)
                 {
@@ -381,7 +641,6 @@ int server_handle_client(conn_t *conn)
                     l->next = ln;
                     l = l->next;
                 }
-                j = j->next;
             }
 
             if(conn->client && conn->client->connected)
@@ -408,6 +667,19 @@ int server_handle_client(conn_t *conn)
             debug("server received JOB_SET_PRI for user=%s", conn->client->name);
 
             job_t *j = jobs_lookup_by_jobid(conn->client, p->jobid);
+            array_t *a = (j ? NULL : array_find(conn->client, p->jobid));
+            if(a)
+            {
+                /* tasks yet to start get the new priority, running ones are
+                 * left as they are */
+                a->tmpl->priority = p->priority;
+                if(a->pending)
+                    sched_set_priority(a->pending, p->priority);
+                if(conn->client && conn->client->connected)
+                    send_pkt(conn->fd, ACK, NULL);
+                FREE(p);
+                break;
+            }
             if(!j)
             {
                 if(conn->client && conn->client->connected)
@@ -416,10 +688,15 @@ int server_handle_client(conn_t *conn)
                 break;
             }
 
+            /* jobs which have not started yet have no process group; their
+             * new priority takes effect in the queue and when they start. for
+             * those still being launched, once their pid is known. */
             debug("j->pgid for setpri is %d", j->pgid);
-            int res = setpriority(PRIO_PGRP, j->pgid, p->priority);
+            int res = (JOB_PENDING(j->status) || j->launchseq ? 0 :
+                    setpriority(PRIO_PGRP, j->pgid, p->priority));
             if(res == 0)
             {
+                sched_set_priority(j, p->priority);
                 if(conn->client && conn->client->connected)
                     send_pkt(conn->fd, ACK, NULL);
             }
@@ -443,7 +720,17 @@ int server_handle_client(conn_t *conn)
                     conn->client->name, s->jobid, s->signal);
 
             job_t *j = jobs_lookup_by_jobid(conn->client, s->jobid);
-            if(!j)
+            array_t *a = (j ? NULL : array_find(conn->client, s->jobid));
+            if(a)
+            {
+                if(conn->client && conn->client->connected)
+                    send_pkt(conn->fd, ACK, NULL);
+
+                /* signals go to each running task; killing the array also
+                 * cancels the tasks which have not started */
+                array_signal(a, s->signal);
+            }
+            else if(!j && archive_find(&conn->client->archive, s->jobid) < 0)
             {
                 if(conn->client && conn->client->connected)
                     send_pkt(conn->fd, NACK, NULL);
@@ -452,7 +739,14 @@ int server_handle_client(conn_t *conn)
             {
                 if(conn->client && conn->client->connected)
                     send_pkt(conn->fd, ACK, NULL);
-                killpg(j->pgid, s->signal);
+
+                /* archived jobs have nothing left to signal, and queued jobs
+                 * have no process group yet. killing a queued job aborts it
+                 * before it ever starts. */
+                if(j && !JOB_PENDING(j->status))
+                    jobs_kill(j, s->signal);
+                else if(j && s->signal == SIGKILL)
+                    jobs_abort(j, SIGKILL);
             }
 
             FREE(s);
@@ -469,20 +763,39 @@ int server_handle_client(conn_t *conn)
                     conn->client->name, *jobid);
 
             job_t *j = jobs_lookup_by_jobid(conn->client, *jobid);
-            if(!j)
+            int idx = j ? -1 : archive_find(&conn->client->archive, *jobid);
+            array_t *a = (j || idx >= 0 ? NULL :
+                    array_find(conn->client, *jobid));
+            if(a)
+            {
+                /* the tasks which finished stay around, to be expunged on
+                 * their own */
+                if(conn->client && conn->client->connected)
+                    send_pkt(conn->fd, ACK, NULL);
+                array_remove(conn->client, a);
+                sched_dispatch();
+            }
+            else if(!j && idx < 0)
             {
                 if(conn->client && conn->client->connected)
                     send_pkt(conn->fd, NACK, NULL);
             }
+            else if(!j)
+            {
+                if(conn->client && conn->client->connected)
+                    send_pkt(conn->fd, ACK, NULL);
+                archive_remove(&conn->client->archive, idx, conn->client->name);
+            }
             else
             {
                 if(conn->client && conn->client->connected)
                     send_pkt(conn->fd, ACK, NULL);
                 /* make sure its not running */
                 if(j->status == RUNNING || j->status == SUSPENDED)
-                    killpg(j->pgid, SIGKILL);
+                    jobs_kill(j, SIGKILL);
 
                 jobs_remove(conn->client, j);
+                sched_dispatch();
             }
 
             FREE(jobid);
@@ -499,66 +812,82 @@ int server_handle_client(conn_t *conn)
                     r, conn->client->name, *jobid);
 
             job_t *j = jobs_lookup_by_jobid(conn->client, *jobid);
+            int idx = j ? -1 : archive_find(&conn->client->archive, *jobid);
+            int k = (r == JOB_GET_STDOUT ? 0 : 1);
             FREE(jobid);
 
-            if(!j)
-            {
-                if(conn->client && conn->client->connected)
-                    send_pkt(conn->fd, NACK, NULL);
-                goto server_handle_client_end;
-            }
-
             /* if the job's not done, don't return any results.
              * it's like baking. don't take the cake out of the oven before
-             * the timer goes off... */
-            if(j->status != ABORTED && j->status != EXITED)
+             * the timer goes off... finished jobs all live in the archive. */
+            if(idx < 0)
             {
                 if(conn->client && conn->client->connected)
                     send_pkt(conn->fd, NACK, NULL);
                 goto server_handle_client_end;
             }
 
-
-            char *c = (r == JOB_GET_STDOUT ? j->stdoutfile : j->stderrfile);
-            struct stat s;
-            if(stat(c, &s) < 0)
+            /* from memory, or the output file mapped. an empty stream means
+             * by definition there are no results. */
+            outmap_t m;
+            int res = output_map(conn->client, idx, k, &m);
+            if(res == 0 && m.size > UINT32_MAX)
+                res = -EFBIG;
+            if(conn->client->connected)
             {
-                debug("stat failed for results file for \'%s\'", c);
-                if(conn->client && conn->client->connected)
-                    send_pkt(conn->fd, NACK, NULL);
-                goto server_handle_client_end;
+                results_t results = { m.size, (char *)m.data };
+                send_pkt(conn->fd, (res == 0 ? JOB_RESULTS : NACK),
+                        (res == 0 ? &results : NULL));
             }
+            if(res < 0)
+                debug("no results for job: %s", strerror(-res));
+            output_unmap(&m);
+            break;
+        }
 
-            int fd = open(c, O_RDONLY);
-            if(fd < 0)
-            {
-                perror("open()");
-                if(conn->client && conn->client->connected)
-                    send_pkt(conn->fd, NACK, NULL);
-                goto server_handle_client_end;
-            }
+        /* a range of lines of a finished job's output */
+        case JOB_GET_LINES:
+        {
+            VALIDATE(conn->client, "client must be non NULL", -EINVAL,
+                    server_handle_client_end);
+            lines_t *req = (lines_t *)payload;
+            lines_serve(conn, req);
+            FREE(req);
+            break;
+        }
 
-            results_t *results = NULL;
-            MALLOC(results, sizeof(results_t));
-            results->length = s.st_size;
+        /* the lines of a finished job's output matching a pattern */
+        case JOB_GREP:
+        {
+            VALIDATE(conn->client, "client must be non NULL", -EINVAL,
+                    server_handle_client_end);
+            grep_t *req = (grep_t *)payload;
+            grep_serve(conn, req);
+            FREE(req->pattern);
+            FREE(req);
+            break;
+        }
+
+        case JOB_SEARCH:
+        {
+            VALIDATE(conn->client, "client must be non NULL", -EINVAL,
+                    server_handle_client_end);
+            query_t *req = (query_t *)payload;
+            search_serve(conn, req);
+            FREE(req->pattern);
+            FREE(req);
+            break;
+        }
 
-            /* if the file is empty, then by definition there are no results */
-            if(results->length == 0)
+        /* data for the stdin of a job, which follows on the socket */
+        case JOB_INPUT:
+        {
+            input_t *in = (input_t *)payload;
+            if(!conn->client || feed_begin(conn, in) < 0)
             {
-                debug("results file is empty");
-                if(conn->client && conn->client->connected)
-                    send_pkt(conn->fd, NACK, NULL);
-                goto server_handle_client_end;
+                debug("failed to take input from client %d", conn->fd);
+                server_disconnect_client(conn);
             }
-
-            results->results = mmap(0, results->length, PROT_READ, MAP_PRIVATE, fd, 0);
-            if(results->results == MAP_FAILED)
-                PERROR_EXIT("mmap()");
-            if(conn->client && conn->client->connected)
-                send_pkt(conn->fd, JOB_RESULTS, results);
-            munmap(results->results, results->length);
-            FREE(results);
-
+            FREE(in);
             break;
         }
 
@@ -589,6 +918,11 @@ client_t* server_login_client(char *name)
     VALIDATE(name, "name must be non NULL", NULL, server_login_client_end);
     VALIDATE(strlen(name) > 0, "name must be len>0", NULL, server_login_client_end);
 
+    /* it names the client's output files, and the directories they are in */
+    VALIDATE(!strchr(name, '/') && strcmp(name, ".") != 0 &&
+            strcmp(name, "..") != 0, "name must not be a path", NULL,
+            server_login_client_end);
+
     client_t *cl = server->clientlist;
 
     /* does user already exist? */
@@ -618,6 +952,7 @@ client_t* server_login_client(char *name)
     MALLOC(retval, sizeof(client_t));
     retval->connected = 1;
     retval->name = strdup(name);
+    retval->weight = sched_weight(name);
 
     retval->next = server->clientlist;
     server->clientlist = retval;
@@ -724,10 +1059,15 @@ int server_remove_client(client_t *client)
 
     debug("removing client \'%s\' (fd=%d)", client->name, client->clientfd);
 
+    if(server->gc_cursor == client)
+        server->gc_cursor = NULL;
+
     /* free resources held by client */
     cancel_all_jobs(client);
     free_jobs(client);
     client->jobs = NULL;
+    array_free_all(client);
+    archive_free(&client->archive, client->name);
 
     /* remove the client from the server records */
     if(server->clientlist == client)
@@ -7,6 +7,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <sys/socket.h>
 #include <sys/types.h>
@@ -20,6 +21,15 @@
 #include "debug.h"
 #include "server.h"
 #include "proto.h"
+#include "gc.h"
+#include "sched.h"
+#include "place.h"
+#include "cgroup.h"
+#include "launcher.h"
+#include "feed.h"
+#include "output.h"
+#include "spool.h"
+#include "search.h"
 
 volatile sig_atomic_t debug_enabled = 0;
 
@@ -33,10 +43,37 @@ volatile sig_atomic_t debug_enabled = 0;
  **/
 void usage(char *pname)
 {
-    printf("Usage: %s [-f socket_file] [-d] [-n maxjobs] [-h]\n"
+    printf("Usage: %s [-f socket_file] [-d] [-n maxjobs] [-a maxage] [-k maxkeep]\n"
+           "       [-b maxbytes] [-s policy] [-w user=weight] [-g aging]\n"
+           "       [-m membudget] [-c cores] [-P] [-B] [-A] [-N] [-G cgroupdir]\n"
+           "       [-t spill] [-o spooldir[,spooldir...]] [-q quota] [-I] [-h]\n"
            "    -f socketfile :  Specifies the socket file to use for the server\n"
            "    -d            :  Enables debugging output\n"
            "    -n maxjobs    :  Maximum number of jobs the server can concurrently run\n"
+           "    -a maxage     :  Expunge finished jobs after maxage seconds\n"
+           "    -k maxkeep    :  Maximum number of finished jobs kept per client\n"
+           "    -b maxbytes   :  Maximum total size of kept job output\n"
+           "    -s policy     :  How queued jobs are picked: fifo (default), fair or\n"
+           "                     priority\n"
+           "    -w user=weight:  Fair-share weight of a user (default 1), repeatable\n"
+           "    -g aging      :  Seconds a queued job waits to gain a priority level\n"
+           "    -m membudget  :  Maximum total memory limit of running jobs, in bytes\n"
+           "    -c cores      :  Maximum total cores requested by running jobs\n"
+           "    -P            :  Suspend running jobs to make room for more urgent\n"
+           "                     ones, resuming them once there is room again\n"
+           "    -B            :  Only let queued jobs jump ahead of one which does\n"
+           "                     not fit if they do not delay it (backfill)\n"
+           "    -A            :  Pin each running job to cpus of its own\n"
+           "    -N            :  Like -A, also binding job memory to its NUMA node\n"
+           "    -G cgroupdir  :  Enforce job limits with cgroups under cgroupdir\n"
+           "    -t spill      :  Capture job output in memory, writing a stream to\n"
+           "                     its output file once it passes spill bytes\n"
+           "    -o spooldirs  :  Keep job output files in these directories,\n"
+           "                     instead of the working directory\n"
+           "    -q quota      :  Run no new jobs for a client whose kept job output\n"
+           "                     passes quota bytes\n"
+           "    -I            :  Index the output of finished jobs in the background,\n"
+           "                     for searches across all of a client's jobs\n"
            "    -h            :  Displays this help message\n"
            , pname);
     exit(EXIT_FAILURE);
@@ -60,7 +97,10 @@ int main(int argc, char *argv[])
 
     /* command line options */
     int opt;
-    while((opt = getopt(argc, argv, "f:dn:h")) != -1)
+    int placement = 0;
+    char *cgdir = NULL;
+    char *spooldirs = NULL;
+    while((opt = getopt(argc, argv, "f:dn:a:k:b:s:w:g:m:c:PBANG:t:o:q:Ih")) != -1)
     {
         switch(opt)
         {
@@ -89,12 +129,194 @@ int main(int argc, char *argv[])
                 break;
             }
 
+            case 'a':
+            {
+                char *endp = NULL;
+                server->retain_age = strtol(optarg, &endp, 10);
+                if(*endp != '\0' || server->retain_age < 1)
+                {
+                    printf("Invalid maximum age.\n");
+                    usage(argv[0]);
+                }
+                break;
+            }
+
+            case 'k':
+            {
+                char *endp = NULL;
+                server->retain_count = strtol(optarg, &endp, 10);
+                if(*endp != '\0' || server->retain_count < 1)
+                {
+                    printf("Invalid number of jobs to keep.\n");
+                    usage(argv[0]);
+                }
+                break;
+            }
+
+            case 'b':
+            {
+                char *endp = NULL;
+                server->retain_bytes = strtoull(optarg, &endp, 10);
+                if(*endp != '\0' || server->retain_bytes < 1)
+                {
+                    printf("Invalid output size budget.\n");
+                    usage(argv[0]);
+                }
+                break;
+            }
+
+            case 's':
+            {
+                if(strcmp(optarg, "fifo") == 0)
+                    server->policy = POLICY_FIFO;
+                else if(strcmp(optarg, "fair") == 0)
+                    server->policy = POLICY_FAIR;
+                else if(strcmp(optarg, "priority") == 0)
+                    server->policy = POLICY_PRIO;
+                else
+                {
+                    printf("Invalid scheduling policy.\n");
+                    usage(argv[0]);
+                }
+                break;
+            }
+
+            case 'g':
+            {
+                char *endp = NULL;
+                server->aging = strtol(optarg, &endp, 10);
+                if(*endp != '\0' || server->aging < 1)
+                {
+                    printf("Invalid aging interval.\n");
+                    usage(argv[0]);
+                }
+                break;
+            }
+
+            case 'm':
+            {
+                char *endp = NULL;
+                server->mem_budget = strtoull(optarg, &endp, 10);
+                if(*endp != '\0' || server->mem_budget < 1)
+                {
+                    printf("Invalid memory budget.\n");
+                    usage(argv[0]);
+                }
+                break;
+            }
+
+            case 'c':
+            {
+                char *endp = NULL;
+                server->core_budget = strtoul(optarg, &endp, 10);
+                if(*endp != '\0' || server->core_budget < 1)
+                {
+                    printf("Invalid core budget.\n");
+                    usage(argv[0]);
+                }
+                break;
+            }
+
+            case 'P':
+            {
+                server->preempt = 1;
+                break;
+            }
+
+            case 'B':
+            {
+                server->backfill = 1;
+                break;
+            }
+
+            case 'N':
+                server->membind = 1;
+                /* fallthrough */
+            case 'A':
+            {
+                placement = 1;
+                break;
+            }
+
+            case 'G':
+            {
+                cgdir = optarg;
+                break;
+            }
+
+            case 'w':
+            {
+                if(sched_set_weight(optarg) < 0)
+                {
+                    printf("Invalid weight.\n");
+                    usage(argv[0]);
+                }
+                break;
+            }
+
+            case 't':
+            {
+                char *endp = NULL;
+                unsigned long spill = strtoul(optarg, &endp, 10);
+                if(*endp != '\0' || endp == optarg || spill > UINT32_MAX / 2)
+                {
+                    printf("Invalid spill threshold.\n");
+                    usage(argv[0]);
+                }
+                server->outmode = OUTPUT_CAPTURE;
+                server->spill = spill;
+                break;
+            }
+
+            case 'o':
+                spooldirs = optarg;
+                break;
+
+            case 'q':
+            {
+                char *endp = NULL;
+                server->quota = strtoull(optarg, &endp, 10);
+                if(*endp != '\0' || endp == optarg || server->quota < 1)
+                {
+                    printf("Invalid output quota.\n");
+                    usage(argv[0]);
+                }
+                break;
+            }
+
+            case 'I':
+                server->search_index = 1;
+                break;
+
             case 'h':
             default:
                 usage(argv[0]);
         }
     }
 
+    /* placement needs to know the cpu budget, so wait until all the options
+     * have been seen */
+    if(placement && place_init() < 0)
+    {
+        printf("Failed to discover cpus for placement.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    /* what a previous run left in the spool goes before any job starts */
+    if(spooldirs && spool_init(spooldirs) < 0)
+    {
+        printf("Cannot use %s as the spool.\n", spooldirs);
+        exit(EXIT_FAILURE);
+    }
+
+    if(cgdir && cgroup_init(cgdir) < 0)
+        printf("Cannot use cgroups under %s, falling back to rlimits.\n", cgdir);
+
+    /* the launcher is forked before the server grows, and before it installs
+     * its signal handlers */
+    if(launcher_init() < 0)
+        printf("Cannot start the job launcher, starting jobs from the server.\n");
+
     /* install signal handler */
     struct sigaction sa;
     sa.sa_handler = server_handler;
@@ -148,9 +370,10 @@ int main(int argc, char *argv[])
     printf("Server socket is open and listening on %s\n", server->socket_file);
 
     int connfd = -1;
-    fd_set fds;
+    fd_set fds, wfds;
     int nfds;
     int n = -1;
+    struct timespec ts, cgts, srts;
 
     /* main server loop */
     while(1)
@@ -160,26 +383,54 @@ int main(int argc, char *argv[])
         sigfillset(&mask);
         sigprocmask(SIG_BLOCK, &mask, &o_mask);
         handle_all_signals();
+        gc_run();
+        search_poll();
+        cgroup_poll();
 
         /* set up the list of fd's to examine */
         FD_ZERO(&fds);
+        FD_ZERO(&wfds);
         FD_SET(sockfd, &fds);
         nfds = sockfd;
 
+        int lfd = launcher_socket();
+        if(lfd >= 0)
+        {
+            FD_SET(lfd, &fds);
+            if(lfd > nfds)
+                nfds = lfd;
+        }
+
         conn_t *conn = server->connlist;
         while(conn)
         {
             if(conn->fd < 0)
                 continue;
 
-            FD_SET(conn->fd, &fds);
+            /* one feeding a job's stdin may be waiting for it to drain */
+            int fd = feed_waitfd(conn);
+            if(fd >= 0)
+                FD_SET(fd, &wfds);
+            else
+                FD_SET(conn->fd, &fds);
             if(conn->fd > nfds)
                 nfds = conn->fd;
+            if(fd > nfds)
+                nfds = fd;
             conn = conn->next;
         }
 
+        /* and the pipes of jobs whose output is captured */
+        nfds = output_fds(&fds, nfds);
+
         /* who's got stuff for us to read? */
-        n = pselect(nfds+1, &fds, NULL, NULL, NULL, &o_mask);
+        struct timespec *timeout = gc_timeout(&ts);
+        if(cgroup_timeout(&cgts) && (!timeout || cgts.tv_sec < timeout->tv_sec))
+            timeout = &cgts;
+        if(search_timeout(&srts))
+            timeout = &srts;
+
+        n = pselect(nfds+1, &fds, &wfds, NULL, timeout, &o_mask);
         sigprocmask(SIG_SETMASK, &o_mask, NULL);
 
         if(n < 0)
@@ -210,12 +461,27 @@ server_main_accept:
             server_register_conn(connfd);
         }
 
+        /* has the launcher started any jobs? */
+        if(lfd >= 0 && FD_ISSET(lfd, &fds))
+        {
+            sigprocmask(SIG_BLOCK, &mask, &o_mask);
+            launcher_poll();
+            sigprocmask(SIG_SETMASK, &o_mask, NULL);
+        }
+
+        /* have any jobs written something? */
+        sigprocmask(SIG_BLOCK, &mask, &o_mask);
+        output_poll(&fds);
+        sigprocmask(SIG_SETMASK, &o_mask, NULL);
+
         /* do any of the clients need to be serviced? */
         conn_t *c = server->connlist;
         while(c)
         {
             conn_t *cn = c->next; /* in case we end up being dico'd/freed */
-            if(c->fd > 0 && FD_ISSET(c->fd, &fds))
+            int fd = feed_waitfd(c);
+            if((c->fd > 0 && FD_ISSET(c->fd, &fds)) ||
+               (fd >= 0 && FD_ISSET(fd, &wfds)))
             {
                 debug("client has data on %d", c->fd);
                 sigprocmask(SIG_BLOCK, &mask, &o_mask);
@@ -0,0 +1,193 @@
+/**
+ * @file spawn.c
+ * @author Daniel Calabria
+ *
+ * Process creation for jobs.
+ *
+ * fork() has to copy the page tables of the server (and mark all of its memory
+ * copy-on-write), which takes longer the more job records the server holds,
+ * and all of it happens on the main loop for every job started. spawn()
+ * starts the child with clone(CLONE_VM | CLONE_VFORK) instead: the child runs
+ * within the server's memory, on a stack of its own, and the server is
+ * suspended until the child has called exec() or exited, so nothing is copied.
+ *
+ * As the child shares the server's memory, the function it runs must not
+ * allocate, write to stdio buffers or change any of the server's data, and
+ * must end in exec() or _exit(). It also starts out with the server's signal
+ * handlers, which spawn_signals() resets before unblocking signals for exec().
+ * Should clone() fail, spawn() falls back to fork(), unless the caller asked for
+ * clone flags which fork() cannot honour.
+ *
+ * A child which has to carry on after starting others, such as the one which
+ * runs the stages of a pipeline, needs memory of its own. spawn_copy() makes
+ * such a child, paying for the copy.
+ **/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "common.h"
+#include "debug.h"
+#include "spawn.h"
+
+/* stack for the children, only ever used by one at a time */
+static void *spawn_stack = NULL;
+
+/**
+ * int spawn_map()
+ *
+ * @brief  Maps the children's stack, if it is not mapped yet.
+ *
+ * @return  1 if the stack is mapped, 0 otherwise.
+ **/
+static int spawn_map()
+{
+    if(!spawn_stack)
+    {
+        void *stack = mmap(NULL, SPAWN_STACK, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+        if(stack != MAP_FAILED)
+            spawn_stack = stack;
+    }
+
+    return spawn_stack != NULL;
+}
+
+/**
+ * pid_t spawn(int (*)(void *), void *, int)
+ *
+ * @brief  Runs fn(arg) in a new child process which shares the caller's
+ *         memory until it execs or exits. The caller is suspended until then.
+ *
+ * @param fn  The function the child runs; its return value is the child's
+ *            exit status if it does not exec
+ * @param arg  The argument to pass to fn
+ * @param flags  Additional clone flags, such as CLONE_PARENT, or 0
+ *
+ * @return  The pid of the child, or -errno on failure.
+ **/
+pid_t spawn(int (*fn)(void *), void *arg, int flags)
+{
+    debug("spawn() - ENTER");
+    pid_t retval = 0;
+
+    /* the stack grows down from its end on every architecture we run on */
+    if(spawn_map())
+    {
+        retval = clone(fn, (char *)spawn_stack + SPAWN_STACK,
+                CLONE_VM | CLONE_VFORK | flags | SIGCHLD, arg);
+        if(retval > 0)
+            goto spawn_end;
+        retval = -errno;
+        debug("clone() failed: %s", strerror(-retval));
+    }
+    else
+        retval = -ENOMEM;
+
+    /* fork() cannot give the child any of the extra flags */
+    if(flags)
+        goto spawn_end;
+
+    retval = fork();
+    if(retval == 0)
+        _exit(fn(arg));
+    if(retval < 0)
+        retval = -errno;
+
+spawn_end:
+    debug("spawn() - EXIT [%d]", retval);
+    return retval;
+}
+
+/**
+ * pid_t spawn_copy(int (*)(void *), void *, int)
+ *
+ * @brief  Runs fn(arg) in a new child process with a copy of the caller's
+ *         memory, as fork() would. The caller carries on at once.
+ *
+ * @param fn  The function the child runs; its return value is the child's
+ *            exit status
+ * @param arg  The argument to pass to fn
+ * @param flags  Additional clone flags, such as CLONE_PARENT, or 0
+ *
+ * @return  The pid of the child, or -errno on failure.
+ **/
+pid_t spawn_copy(int (*fn)(void *), void *arg, int flags)
+{
+    debug("spawn_copy() - ENTER");
+    pid_t retval = 0;
+
+    if(flags)
+    {
+        /* the child runs on its own copy of the stack */
+        if(!spawn_map())
+        {
+            retval = -ENOMEM;
+            goto spawn_copy_end;
+        }
+        retval = clone(fn, (char *)spawn_stack + SPAWN_STACK, flags | SIGCHLD,
+                arg);
+    }
+    else
+    {
+        retval = fork();
+        if(retval == 0)
+            _exit(fn(arg));
+    }
+    if(retval < 0)
+        retval = -errno;
+
+spawn_copy_end:
+    debug("spawn_copy() - EXIT [%d]", retval);
+    return retval;
+}
+
+/**
+ * void spawn_signals()
+ *
+ * @brief  Called in a child before it execs: puts every signal the server
+ *         handles back to its default action, then unblocks all signals.
+ *         Signals the server ignores stay ignored, as they would across
+ *         fork() and exec().
+ **/
+void spawn_signals()
+{
+    struct sigaction sa;
+    sigset_t mask;
+
+    for(int sig = 1; sig < NSIG; sig++)
+    {
+        if(sig == SIGKILL || sig == SIGSTOP)
+            continue;
+        if(sigaction(sig, NULL, &sa) < 0)
+            continue;
+        if(sa.sa_handler == SIG_DFL || sa.sa_handler == SIG_IGN)
+            continue;
+
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = SIG_DFL;
+        sigaction(sig, &sa, NULL);
+    }
+
+    sigemptyset(&mask);
+    sigprocmask(SIG_SETMASK, &mask, NULL);
+}
+
+/**
+ * void spawn_free()
+ *
+ * @brief  Releases the children's stack.
+ **/
+void spawn_free()
+{
+    if(spawn_stack)
+        munmap(spawn_stack, SPAWN_STACK);
+    spawn_stack = NULL;
+}
@@ -0,0 +1,395 @@
+/**
+ * @file spool.c
+ * @author Daniel Calabria
+ *
+ * Where the output files of jobs are kept.
+ *
+ * By default, output files are created in the server's working directory. A
+ * server started with -o keeps them within one or more spool roots instead,
+ * each file at
+ *
+ *   root/username/xx/username_timeofsubmission.ext
+ *
+ * where xx is one of SPOOL_SHARDS directories, picked by hashing the time of
+ * submission, so that no directory grows large however many jobs are kept.
+ * The same hash picks the root, striping the jobs (though never the two files
+ * of one job) over all of them. Since the path follows from the owner and the
+ * time of submission alone, see jobs_output_path(), nothing has to be stored
+ * to find a file again.
+ *
+ * The server keeps nothing across restarts, so whatever a previous run left
+ * in the spool roots is removed at startup. The walk only follows the layout
+ * above, into directories named like users and shards, and only removes
+ * regular files named like the server names them, so that pointing -o at a
+ * directory holding anything else leaves that alone.
+ **/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "common.h"
+#include "debug.h"
+#include "server.h"
+#include "cache.h"
+#include "spool.h"
+
+/* the spool roots, none if output files go into the working directory */
+static char *spool_roots[SPOOL_MAXROOTS];
+static int spool_count = 0;
+
+#define SPOOL_DIGITS    "0123456789"
+#define SPOOL_HEX       "0123456789abcdef"
+#define SPOOL_USERCHARS "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ" \
+                        SPOOL_DIGITS "._-"
+
+/**
+ * int spool_isfile(const char *, const char *, size_t, const char *)
+ *
+ * @brief  Checks whether a name is a prefix, then some characters of a set,
+ *         then .out or .err.
+ *
+ * @param name  The name
+ * @param set  The characters which may follow the prefix
+ * @param len  How many of them must, or 0 for at least one
+ * @param prefix  The prefix
+ *
+ * @return  1 if it is, 0 if not.
+ **/
+static int spool_isfile(const char *name, const char *set, size_t len,
+        const char *prefix)
+{
+    size_t plen = strlen(prefix);
+    if(strncmp(name, prefix, plen) != 0)
+        return 0;
+
+    size_t n = strspn(name + plen, set);
+    if(n == 0 || (len > 0 && n != len))
+        return 0;
+
+    const char *ext = name + plen + n;
+    return (strcmp(ext, ".out") == 0 || strcmp(ext, ".err") == 0);
+}
+
+/**
+ * int spool_iscache(const char *)
+ *
+ * @brief  Checks whether a file within a spool root is a kept cache result,
+ *         named CACHE_PREFIX, the 16 hex digits of its key, _ and a number.
+ *
+ * @param name  The name of the file
+ *
+ * @return  1 if it is, 0 if not.
+ **/
+static int spool_iscache(const char *name)
+{
+    size_t plen = strlen(CACHE_PREFIX);
+    if(strncmp(name, CACHE_PREFIX, plen) != 0 ||
+       strspn(name + plen, SPOOL_HEX) != 16 || name[plen + 16] != '_')
+        return 0;
+
+    return spool_isfile(name + plen + 17, SPOOL_DIGITS, 0, "");
+}
+
+/**
+ * long spool_sweep(int, int, const char *)
+ *
+ * @brief  Removes what a previous run of the server left within a directory
+ *         of a spool root: kept cache results within the root itself, and
+ *         output files within the shards of each user.
+ *
+ * @param fd  The directory, which is closed
+ * @param depth  0 for a root, 1 for a user's directory, 2 for a shard
+ * @param user  The user the directory belongs to, for depths 1 and 2
+ *
+ * @return  The number of files removed.
+ **/
+static long spool_sweep(int fd, int depth, const char *user)
+{
+    long removed = 0;
+    DIR *d = fdopendir(fd);
+
+    if(!d)
+    {
+        close(fd);
+        return 0;
+    }
+
+    struct dirent *e;
+    while((e = readdir(d)) != NULL)
+    {
+        if(strcmp(e->d_name, ".") == 0 || strcmp(e->d_name, "..") == 0)
+            continue;
+
+        int isdir = (e->d_type == DT_DIR), isreg = (e->d_type == DT_REG);
+        if(e->d_type == DT_UNKNOWN)
+        {
+            struct stat st;
+            if(fstatat(dirfd(d), e->d_name, &st, AT_SYMLINK_NOFOLLOW) == 0)
+            {
+                isdir = S_ISDIR(st.st_mode);
+                isreg = S_ISREG(st.st_mode);
+            }
+        }
+
+        const char *name = e->d_name;
+        int descend = 0, remove = 0;
+        switch(depth)
+        {
+            /* users' directories, and cache results */
+            case 0:
+                descend = (isdir && name[0] != '.' && name[0] != '-' &&
+                        strspn(name, SPOOL_USERCHARS) == strlen(name));
+                remove = (isreg && spool_iscache(name));
+                break;
+
+            /* shards, 00 to ff */
+            case 1:
+                descend = (isdir && strlen(name) == 2 &&
+                        strspn(name, SPOOL_HEX) == 2);
+                break;
+
+            /* the user's output files, user_timeofsubmission.ext */
+            case 2:
+            {
+                char prefix[NAME_MAX + 2];
+                snprintf(prefix, sizeof(prefix), "%s_", user);
+                remove = (isreg && spool_isfile(name, SPOOL_DIGITS, 0, prefix));
+                break;
+            }
+        }
+
+        if(descend)
+        {
+            int sub = openat(dirfd(d), name,
+                    O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+            if(sub >= 0)
+                removed += spool_sweep(sub, depth + 1,
+                        (depth == 0 ? name : user));
+        }
+        else if(remove && unlinkat(dirfd(d), name, 0) == 0)
+            removed++;
+    }
+
+    closedir(d);
+    return removed;
+}
+
+/**
+ * int spool_init(char *)
+ *
+ * @brief  Sets up the spool roots, creating them if need be, and removes
+ *         whatever was left within them.
+ *
+ * @param roots  A comma separated list of directories
+ *
+ * @return  0 on success, -errno on failure
+ **/
+int spool_init(char *roots)
+{
+    debug("spool_init() - ENTER [%s]", roots);
+    int retval = 0;
+    char *saveptr = NULL;
+    long removed = 0;
+
+    VALIDATE(roots, "roots must be non NULL", -EINVAL, spool_init_end);
+
+    for(char *r = strtok_r(roots, ",", &saveptr); r;
+            r = strtok_r(NULL, ",", &saveptr))
+    {
+        VALIDATE(spool_count < SPOOL_MAXROOTS, "too many spool roots", -E2BIG,
+                spool_init_end);
+
+        if(mkdir(r, S_IRWXU) < 0 && errno != EEXIST)
+        {
+            retval = -errno;
+            goto spool_init_end;
+        }
+
+        int fd = open(r, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        VALIDATE(fd >= 0, "spool root is not a directory", -errno,
+                spool_init_end);
+        removed += spool_sweep(fd, 0, NULL);
+
+        spool_roots[spool_count++] = strdup(r);
+    }
+
+    VALIDATE(spool_count > 0, "no spool roots", -EINVAL, spool_init_end);
+    if(removed > 0)
+        printf("Removed %ld stale output files from the spool.\n", removed);
+
+spool_init_end:
+    debug("spool_init() - EXIT [%d]", retval);
+    return retval;
+}
+
+/**
+ * uint32_t spool_hash(const struct timeval *)
+ *
+ * @brief  Hashes the time a job was submitted, which picks the spool root and
+ *         shard of its output files.
+ *
+ * @param stamp  The time of submission
+ *
+ * @return  The hash.
+ **/
+uint32_t spool_hash(const struct timeval *stamp)
+{
+    uint64_t h = ((uint64_t)stamp->tv_sec * 1000000 + stamp->tv_usec) *
+                 0x9e3779b97f4a7c15ULL;
+
+    return (uint32_t)(h >> 32);
+}
+
+/**
+ * const char* spool_root(uint32_t)
+ *
+ * @brief  Finds the spool root output files with the given hash are kept in.
+ *
+ * @param hash  The hash, see spool_hash()
+ *
+ * @return  The root, or NULL if output files go into the working directory.
+ **/
+const char* spool_root(uint32_t hash)
+{
+    if(spool_count == 0)
+        return NULL;
+
+    return spool_roots[(hash / SPOOL_SHARDS) % spool_count];
+}
+
+/**
+ * int spool_prepare(client_t *, const struct timeval *)
+ *
+ * @brief  Makes sure the directory the output files of a job go into exists.
+ *         Each client remembers which of its directories were made, so that
+ *         this only takes system calls the first time around.
+ *
+ * @param c  The client owning the job
+ * @param stamp  The time the job was submitted
+ *
+ * @return  0 on success, -errno on failure
+ **/
+int spool_prepare(client_t *c, const struct timeval *stamp)
+{
+    int retval = 0;
+    char path[PATH_MAX];
+
+    if(spool_count == 0)
+        goto spool_prepare_end;
+
+    uint32_t hash = spool_hash(stamp);
+    uint32_t bit = ((hash / SPOOL_SHARDS) % spool_count) * SPOOL_SHARDS +
+                   hash % SPOOL_SHARDS;
+    if(!c->spooldirs)
+        MALLOC(c->spooldirs, spool_count * SPOOL_SHARDS / 8);
+    if(c->spooldirs[bit / 8] & (1 << (bit % 8)))
+        goto spool_prepare_end;
+
+    const char *root = spool_root(hash);
+    int n = snprintf(path, sizeof(path), "%s/%s", root, c->name);
+    VALIDATE(n > 0 && n < sizeof(path), "spool path is too long",
+            -ENAMETOOLONG, spool_prepare_end);
+    VALIDATE(mkdir(path, S_IRWXU) == 0 || errno == EEXIST,
+            "failed to make user's spool directory", -errno,
+            spool_prepare_end);
+
+    n = snprintf(path, sizeof(path), "%s/%s/%02x", root, c->name,
+            hash % SPOOL_SHARDS);
+    VALIDATE(n > 0 && n < sizeof(path), "spool path is too long",
+            -ENAMETOOLONG, spool_prepare_end);
+    VALIDATE(mkdir(path, S_IRWXU) == 0 || errno == EEXIST,
+            "failed to make spool shard", -errno, spool_prepare_end);
+
+    c->spooldirs[bit / 8] |= (1 << (bit % 8));
+
+spool_prepare_end:
+    return retval;
+}
+
+/**
+ * int spool_copy(const char *, const char *)
+ *
+ * @brief  Copies a file, for when it cannot be linked to because the two
+ *         names are in spool roots on different filesystems.
+ *
+ * @param from  The existing file
+ * @param to  The name of the copy, which must not exist
+ *
+ * @return  0 on success, -errno on failure
+ **/
+int spool_copy(const char *from, const char *to)
+{
+    int retval = 0;
+    int in = -1, out = -1;
+
+    VALIDATE((in = open(from, O_RDONLY | O_CLOEXEC)) >= 0,
+            "failed to open file to copy", -errno, spool_copy_end);
+    VALIDATE((out = open(to, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC,
+                    S_IRUSR | S_IWUSR)) >= 0,
+            "failed to create copy", -errno, spool_copy_end);
+
+    ssize_t n;
+    while((n = copy_file_range(in, NULL, out, NULL, SSIZE_MAX, 0)) > 0)
+        ;
+
+    /* not every filesystem can, the rest goes through a buffer */
+    if(n < 0 && (errno == EXDEV || errno == EINVAL || errno == ENOSYS ||
+                 errno == EOPNOTSUPP))
+    {
+        char buf[16 * 1024];
+        while((n = read(in, buf, sizeof(buf))) > 0)
+        {
+            for(ssize_t off = 0; off < n; )
+            {
+                ssize_t w = write(out, buf + off, n - off);
+                if(w < 0 && errno == EINTR)
+                    continue;
+                if(w <= 0)
+                {
+                    /* write() says nothing about why it wrote nothing */
+                    if(w == 0)
+                        errno = EIO;
+                    n = -1;
+                    break;
+                }
+                off += w;
+            }
+            if(n < 0)
+                break;
+        }
+    }
+
+    if(n < 0)
+    {
+        retval = -errno;
+        unlink(to);
+    }
+
+spool_copy_end:
+    if(in >= 0)
+        close(in);
+    if(out >= 0)
+        close(out);
+    return retval;
+}
+
+/**
+ * void spool_free()
+ *
+ * @brief  Forgets the spool roots. The directories within them are left for
+ *         the next run of the server.
+ **/
+void spool_free()
+{
+    for(int i = 0; i < spool_count; i++)
+        FREE(spool_roots[i]);
+    spool_count = 0;
+}
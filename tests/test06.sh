@@ -0,0 +1,42 @@
+#!/bin/sh
+#
+# Demonstrates job dependencies
+echo
+echo "************************************ TEST 6 ************************************"
+
+echo
+echo "*** Starting server..."
+rm -f .smash.socket
+./bin/server 1>/dev/null 2>/dev/null &
+SERVERPID=$!
+sleep 1
+
+echo
+echo "*** Client submitting a job which takes a while..."
+./bin/client -u asdf -c "submit 10 123123123 0 sleep 3"
+echo
+echo "*** Client submitting a job to run once job 0 succeeds..."
+./bin/client -u asdf -c "submit after=0 10 123123123 0 echo step two"
+echo
+echo "*** Client submitting a job which fails once job 1 succeeds..."
+./bin/client -u asdf -c "submit after=1 10 123123123 0 false"
+echo
+echo "*** Client submitting a job to run once job 2 succeeds (it won't)..."
+./bin/client -u asdf -c "submit after=2 10 123123123 0 echo never"
+echo
+echo "*** Client submitting a job to run once job 2 finishes, however it does..."
+./bin/client -u asdf -c "submit afterany=2 10 123123123 0 echo cleanup"
+echo
+echo "*** Status listing of asdf's jobs..."
+./bin/client -u asdf -c "list"
+
+echo
+echo "*** Waiting..."
+sleep 4
+echo
+echo "*** Status listing of asdf's jobs..."
+./bin/client -u asdf -c "list"
+
+echo
+echo "*** Shutting down server..."
+/bin/kill -INT $SERVERPID
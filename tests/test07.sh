@@ -0,0 +1,39 @@
+#!/bin/sh
+#
+# Demonstrates job arrays
+echo
+echo "************************************ TEST 7 ************************************"
+
+echo
+echo "*** Starting server..."
+rm -f .smash.socket
+./bin/server 1>/dev/null 2>/dev/null &
+SERVERPID=$!
+sleep 1
+
+echo
+echo "*** Client submitting an array of 6 tasks, 2 at a time..."
+./bin/client -u asdf -c "submit array=1-6%2 10 123123123 0 sleep 1"
+echo
+echo "*** Client submitting an array of 3 tasks printing their index..."
+./bin/client -u asdf -c "submit array=10-12 10 123123123 0 printenv SMASH_ARRAY_TASK_ID"
+echo
+echo "*** Status of the first array..."
+./bin/client -u asdf -c "status 0"
+echo
+echo "*** Status listing of asdf's jobs..."
+./bin/client -u asdf -c "list"
+
+echo
+echo "*** Waiting..."
+sleep 4
+echo
+echo "*** Status listing of asdf's jobs..."
+./bin/client -u asdf -c "list"
+echo
+echo "*** Output of the last task of the second array..."
+./bin/client -u asdf -c "stdout 10"
+
+echo
+echo "*** Shutting down server..."
+/bin/kill -INT $SERVERPID
@@ -0,0 +1,45 @@
+#!/bin/sh
+#
+# Demonstrates cacheable jobs
+echo
+echo "************************************ TEST 8 ************************************"
+
+echo
+echo "*** Starting server..."
+rm -f .smash.socket
+./bin/server 1>/dev/null 2>/dev/null &
+SERVERPID=$!
+sleep 1
+
+echo
+echo "*** Client submitting the same cacheable job twice..."
+./bin/client -u asdf -c "submit cache=v1 10 123123123 0 sleep 1"
+sleep 0.1
+./bin/client -u asdf -c "submit cache=v1 10 123123123 0 sleep 1"
+echo
+echo "*** Status listing of asdf's jobs, the second waits for the first..."
+./bin/client -u asdf -c "list"
+
+echo
+echo "*** Waiting..."
+sleep 2
+echo
+echo "*** Client submitting it a third time, answered without running..."
+./bin/client -u asdf -c "submit cache=v1 10 123123123 0 sleep 1"
+sleep 0.1
+echo
+echo "*** Status listing of asdf's jobs..."
+./bin/client -u asdf -c "list"
+
+echo
+echo "*** Client submitting it once more, after another job, answered once that one is done..."
+./bin/client -u asdf -c "submit 10 123123123 0 sleep 1"
+./bin/client -u asdf -c "submit after=3 cache=v1 10 123123123 0 sleep 1"
+sleep 1.5
+echo
+echo "*** Status listing of asdf's jobs..."
+./bin/client -u asdf -c "list"
+
+echo
+echo "*** Shutting down server..."
+/bin/kill -INT $SERVERPID
@@ -0,0 +1,39 @@
+#!/bin/sh
+#
+# Demonstrates pipelines
+echo
+echo "************************************ TEST 9 ************************************"
+
+echo
+echo "*** Starting server..."
+rm -f .smash.socket
+./bin/server 1>/dev/null 2>/dev/null &
+SERVERPID=$!
+sleep 1
+
+echo
+echo "*** Client submitting pipelines..."
+./bin/client -u asdf -c "submit 10 123123123 0 ls -l | sort -k 9 | head -5"
+sleep 0.1
+./bin/client -u asdf -c "submit 10 123123123 0 yes | head -3"
+sleep 0.1
+./bin/client -u asdf -c "submit 10 123123123 0 sleep 10 | cat"
+sleep 0.5
+echo
+echo "*** Status listing of asdf's jobs..."
+./bin/client -u asdf -c "list"
+
+echo
+echo "*** Killing the last pipeline, which kills all of it..."
+./bin/client -u asdf -c "kill 2"
+sleep 0.5
+echo
+echo "*** Status listing of asdf's jobs..."
+./bin/client -u asdf -c "list"
+echo
+echo "*** Output of the first pipeline..."
+./bin/client -u asdf -c "stdout 0"
+
+echo
+echo "*** Shutting down server..."
+/bin/kill -INT $SERVERPID
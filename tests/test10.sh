@@ -0,0 +1,39 @@
+#!/bin/sh
+#
+# Demonstrates feeding a job's stdin
+echo
+echo "************************************ TEST 10 ***********************************"
+
+echo
+echo "*** Starting server..."
+rm -f .smash.socket
+./bin/server 1>/dev/null 2>/dev/null &
+SERVERPID=$!
+sleep 1
+
+echo
+echo "*** Client submitting jobs which read their stdin..."
+./bin/client -u asdf -c "submit stdin=pipe 10 123123123 0 sort -r"
+sleep 0.1
+./bin/client -u asdf -c "submit stdin=pipe 10 123123123 0 wc -c"
+sleep 0.1
+echo
+echo "*** Status listing of asdf's jobs, both wait for input..."
+./bin/client -u asdf -c "list"
+
+echo
+echo "*** Client sending them input..."
+./bin/client -u asdf -c "input 0 Makefile"
+sleep 0.1
+head -c 1000000 /dev/zero | ./bin/client -u asdf -c "input 1 -"
+sleep 0.5
+echo
+echo "*** Status listing of asdf's jobs..."
+./bin/client -u asdf -c "list"
+echo
+echo "*** Output of the second job..."
+./bin/client -u asdf -c "stdout 1"
+
+echo
+echo "*** Shutting down server..."
+/bin/kill -INT $SERVERPID
@@ -0,0 +1,48 @@
+#!/bin/sh
+#
+# Demonstrates capturing job output in memory, spilling and discarding it
+echo
+echo "************************************ TEST 11 ***********************************"
+
+echo
+echo "*** Starting server, keeping up to 4096 bytes of each stream in memory..."
+rm -f .smash.socket
+./bin/server -t 4096 1>/dev/null 2>/dev/null &
+SERVERPID=$!
+sleep 1
+
+echo
+echo "*** Client submitting jobs with small, large and discarded output..."
+./bin/client -u asdf -c "submit 10 123123123 0 echo captured"
+sleep 0.1
+./bin/client -u asdf -c "submit 10 123123123 0 true"
+sleep 0.1
+./bin/client -u asdf -c "submit 10 123123123 0 seq 10000"
+sleep 0.1
+./bin/client -u asdf -c "submit output=discard 10 123123123 0 seq 10000"
+sleep 0.1
+./bin/client -u asdf -c "submit output=files 10 123123123 0 echo filed"
+sleep 0.5
+
+echo
+echo "*** Status listing of asdf's jobs..."
+./bin/client -u asdf -c "list"
+
+echo
+echo "*** Output files, only for the spilled and the files job..."
+ls asdf_*
+
+echo
+echo "*** Output of the first job, served from memory..."
+./bin/client -u asdf -c "stdout 0"
+echo
+echo "*** The second and fourth jobs have no output..."
+./bin/client -u asdf -c "stdout 1"
+./bin/client -u asdf -c "stdout 3"
+echo
+echo "*** Last lines of the third job's output, which spilled..."
+./bin/client -u asdf -c "stdout 2" | tail -n 3
+
+echo
+echo "*** Shutting down server..."
+/bin/kill -INT $SERVERPID
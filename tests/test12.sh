@@ -0,0 +1,41 @@
+#!/bin/sh
+#
+# Demonstrates keeping output files in sharded spool directories
+echo
+echo "************************************ TEST 12 ***********************************"
+
+echo
+echo "*** Starting server, spooling output into two directories..."
+rm -f .smash.socket
+rm -rf spool1 spool2
+mkdir -p spool1/asdf/00
+touch spool1/asdf/00/asdf_1.out
+./bin/server -o spool1,spool2 1>/dev/null 2>/dev/null &
+SERVERPID=$!
+sleep 1
+
+echo
+echo "*** The file a previous run left behind is gone..."
+ls spool1/asdf/00
+
+echo
+echo "*** Client submitting jobs..."
+for i in 1 2 3 4 5 6; do
+    ./bin/client -u asdf -c "submit 10 123123123 0 echo job $i"
+    sleep 0.1
+done
+sleep 0.5
+
+echo
+echo "*** Output files, spread over the shards of both directories..."
+find spool1 spool2 -type f | sort
+
+echo
+echo "*** Output of the last job..."
+./bin/client -u asdf -c "stdout 5"
+
+echo
+echo "*** Shutting down server..."
+/bin/kill -INT $SERVERPID
+sleep 0.5
+rm -rf spool1 spool2
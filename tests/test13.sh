@@ -0,0 +1,47 @@
+#!/bin/sh
+#
+# Demonstrates limits on the output of jobs, and the per client output quota
+echo
+echo "************************************ TEST 13 ***********************************"
+
+echo
+echo "*** Starting server, capturing output and with a quota of 2048 bytes..."
+rm -f .smash.socket
+./bin/server -t 1024 -q 2048 1>/dev/null 2>/dev/null &
+SERVERPID=$!
+sleep 1
+
+echo
+echo "*** Client submitting jobs writing more and less than their maxout..."
+./bin/client -u asdf -c "submit maxout=100 10 123123123 0 seq 10"
+sleep 0.1
+./bin/client -u asdf -c "submit maxout=100 10 123123123 0 yes"
+sleep 0.1
+./bin/client -u asdf -c "submit maxout=3000 output=files 10 123123123 0 seq 10000"
+sleep 0.5
+
+echo
+echo "*** Status listing of asdf's jobs..."
+./bin/client -u asdf -c "list"
+
+echo
+echo "*** The killed job's output stops at its limit..."
+./bin/client -u asdf -c "stdout 1" | wc -c
+ls -l asdf_*.out | awk '{ print $5 }'
+
+echo
+echo "*** asdf is over its quota now, so its next job does not run..."
+./bin/client -u asdf -c "submit 10 123123123 0 echo hello"
+sleep 0.1
+./bin/client -u asdf -c "status 3"
+
+echo
+echo "*** ...until it expunges the job holding its output..."
+./bin/client -u asdf -c "expunge 2"
+./bin/client -u asdf -c "submit 10 123123123 0 echo hello"
+sleep 0.1
+./bin/client -u asdf -c "status 4"
+
+echo
+echo "*** Shutting down server..."
+/bin/kill -INT $SERVERPID
@@ -0,0 +1,39 @@
+#!/bin/sh
+#
+# Demonstrates getting ranges of lines of the output of jobs
+echo
+echo "************************************ TEST 14 ***********************************"
+
+echo
+echo "*** Starting server..."
+rm -f .smash.socket
+./bin/server 1>/dev/null 2>/dev/null &
+SERVERPID=$!
+sleep 1
+
+echo
+echo "*** Client submitting jobs with long output..."
+./bin/client -u asdf -c "submit 10 123123123 0 seq 100000"
+sleep 0.1
+./bin/client -u asdf -c "submit 10 123123123 0 ls /nonexistent"
+sleep 0.5
+
+echo
+echo "*** Lines 1000 to 1004 of the first job's output..."
+./bin/client -u asdf -c "lines 0 1000 5"
+
+echo
+echo "*** The last 3 lines of its output..."
+./bin/client -u asdf -c "tail 0 3"
+
+echo
+echo "*** The last line of the second job's error output..."
+./bin/client -u asdf -c "tail 1 1 err"
+
+echo
+echo "*** Lines past the end of the output..."
+./bin/client -u asdf -c "lines 0 100001 5"
+
+echo
+echo "*** Shutting down server..."
+/bin/kill -INT $SERVERPID
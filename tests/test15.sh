@@ -0,0 +1,39 @@
+#!/bin/sh
+#
+# Demonstrates searching the output of jobs on the server
+echo
+echo "************************************ TEST 15 ***********************************"
+
+echo
+echo "*** Starting server..."
+rm -f .smash.socket
+./bin/server 1>/dev/null 2>/dev/null &
+SERVERPID=$!
+sleep 1
+
+echo
+echo "*** Client submitting jobs with long output..."
+./bin/client -u asdf -c "submit 10 123123123 0 seq 100000"
+sleep 0.1
+./bin/client -u asdf -c "submit 10 123123123 0 ls /nonexistent"
+sleep 0.5
+
+echo
+echo "*** Lines of the first job's output containing 77777..."
+./bin/client -u asdf -c "grep 0 77777"
+
+echo
+echo "*** The first 2 lines matching a regular expression, with context..."
+./bin/client -u asdf -c "grep 0 -E -C 1 -m 2 ^5+$"
+
+echo
+echo "*** Searching the second job's error output, ignoring case..."
+./bin/client -u asdf -c "grep 1 -2 -i CANNOT ACCESS"
+
+echo
+echo "*** A pattern which is nowhere in the output..."
+./bin/client -u asdf -c "grep 0 hello"
+
+echo
+echo "*** Shutting down server..."
+/bin/kill -INT $SERVERPID
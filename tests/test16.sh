@@ -0,0 +1,41 @@
+#!/bin/sh
+#
+# Demonstrates searching the output of all of a client's jobs, with an index
+echo
+echo "************************************ TEST 16 ***********************************"
+
+echo
+echo "*** Starting server, indexing job output..."
+rm -f .smash.socket
+./bin/server -I 1>/dev/null 2>/dev/null &
+SERVERPID=$!
+sleep 1
+
+echo
+echo "*** Client submitting jobs with long output..."
+./bin/client -u asdf -c "submit 10 123123123 0 seq 100000"
+sleep 0.1
+./bin/client -u asdf -c "submit 10 123123123 0 seq 50000 150000"
+sleep 0.1
+./bin/client -u asdf -c "submit 10 123123123 0 ls /nonexistent"
+sleep 0.5
+
+echo
+echo "*** Where 77777 is in the output of all jobs..."
+./bin/client -u asdf -c "search 77777"
+
+echo
+echo "*** The first 3 places 12345 is..."
+./bin/client -u asdf -c "search -m 3 12345"
+
+echo
+echo "*** Searching error output too..."
+./bin/client -u asdf -c "search cannot access"
+
+echo
+echo "*** A string which is nowhere in the output..."
+./bin/client -u asdf -c "search hello"
+
+echo
+echo "*** Shutting down server..."
+/bin/kill -INT $SERVERPID
@@ -0,0 +1,43 @@
+#!/bin/sh
+#
+# Demonstrates preemption of less urgent jobs
+echo
+echo "************************************ TEST 17 ***********************************"
+
+echo
+echo "*** Starting server, running 1 job at a time, with preemption..."
+rm -f .smash.socket
+./bin/server -n 1 -P 1>/dev/null 2>/dev/null &
+SERVERPID=$!
+sleep 1
+
+echo
+echo "*** Client submitting a low priority job, then an urgent one..."
+./bin/client -u asdf -c "submit 10 123123123 19 sleep 4"
+sleep 0.5
+./bin/client -u asdf -c "submit 10 123123123 0 sleep 1"
+sleep 0.5
+
+echo
+echo "*** Status listing of asdf's jobs, the low priority one is suspended..."
+./bin/client -u asdf -c "list"
+
+echo
+echo "*** Waiting for the urgent job..."
+sleep 1.5
+
+echo
+echo "*** Status listing of asdf's jobs, the low priority one was resumed..."
+./bin/client -u asdf -c "list"
+
+echo
+echo "*** Waiting..."
+sleep 2
+
+echo
+echo "*** Status listing of asdf's jobs..."
+./bin/client -u asdf -c "list"
+
+echo
+echo "*** Shutting down server..."
+/bin/kill -INT $SERVERPID
@@ -0,0 +1,42 @@
+#!/bin/sh
+#
+# Demonstrates backfilling around a job which does not fit yet
+echo
+echo "************************************ TEST 18 ***********************************"
+
+echo
+echo "*** Starting server, with 2 cores and backfill..."
+rm -f .smash.socket
+./bin/server -c 2 -B 1>/dev/null 2>/dev/null &
+SERVERPID=$!
+sleep 1
+
+echo
+echo "*** Client submitting a job on 1 core for 3 seconds, then one needing both..."
+./bin/client -u asdf -c "submit walltime=3 10 123123123 0 sleep 3"
+./bin/client -u asdf -c "submit cores=2 walltime=1 10 123123123 0 sleep 1"
+
+echo
+echo "*** A short job, which finishes before both cores are free..."
+./bin/client -u asdf -c "submit walltime=1 10 123123123 0 sleep 1"
+
+echo
+echo "*** A long job, which would delay the job needing both cores..."
+./bin/client -u asdf -c "submit walltime=10 10 123123123 0 sleep 1"
+sleep 0.5
+
+echo
+echo "*** Status listing of asdf's jobs, only the short job went ahead..."
+./bin/client -u asdf -c "list"
+
+echo
+echo "*** Waiting..."
+sleep 5
+
+echo
+echo "*** Status listing of asdf's jobs..."
+./bin/client -u asdf -c "list"
+
+echo
+echo "*** Shutting down server..."
+/bin/kill -INT $SERVERPID
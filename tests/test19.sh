@@ -0,0 +1,63 @@
+#!/bin/sh
+#
+# Demonstrates starting jobs from the launcher, and without it
+echo
+echo "************************************ TEST 19 ***********************************"
+
+echo
+echo "*** Starting server, capturing job output..."
+rm -f .smash.socket
+./bin/server -t 65536 1>/dev/null 2>/dev/null &
+SERVERPID=$!
+sleep 1
+
+echo
+echo "*** The launcher is the server's only child before any job runs..."
+LAUNCHERPID=$(ps -o pid= --ppid $SERVERPID | tr -d ' ')
+echo "server has $(echo $LAUNCHERPID | wc -w) child process(es)"
+
+echo
+echo "*** Client submitting a job, a pipeline and a job reading its stdin..."
+./bin/client -u asdf -c "submit 10 123123123 0 echo launched"
+./bin/client -u asdf -c "submit 10 123123123 0 seq 10 | sort -rn | head -3"
+./bin/client -u asdf -c "submit stdin=pipe 10 123123123 0 tr a-z A-Z"
+printf 'fed through the launcher\n' | ./bin/client -u asdf -c "input 2 -"
+sleep 0.5
+
+echo
+echo "*** Status listing of asdf's jobs..."
+./bin/client -u asdf -c "list"
+
+echo
+echo "*** Their output..."
+./bin/client -u asdf -c "stdout 0"
+./bin/client -u asdf -c "stdout 1"
+./bin/client -u asdf -c "stdout 2"
+
+echo
+echo "*** Killing the launcher, the server starts jobs itself from now on..."
+kill -KILL $LAUNCHERPID
+sleep 0.5
+echo "server has $(ps -o pid= --ppid $SERVERPID | wc -l) child process(es)"
+
+echo
+echo "*** Client submitting the same jobs again..."
+./bin/client -u asdf -c "submit 10 123123123 0 echo spawned"
+./bin/client -u asdf -c "submit 10 123123123 0 seq 10 | sort -rn | head -3"
+./bin/client -u asdf -c "submit stdin=pipe 10 123123123 0 tr a-z A-Z"
+printf 'fed without the launcher\n' | ./bin/client -u asdf -c "input 5 -"
+sleep 0.5
+
+echo
+echo "*** Status listing of asdf's jobs..."
+./bin/client -u asdf -c "list"
+
+echo
+echo "*** Their output..."
+./bin/client -u asdf -c "stdout 3"
+./bin/client -u asdf -c "stdout 4"
+./bin/client -u asdf -c "stdout 5"
+
+echo
+echo "*** Shutting down server..."
+/bin/kill -INT $SERVERPID
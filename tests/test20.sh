@@ -0,0 +1,92 @@
+#!/bin/sh
+#
+# Demonstrates fair-share scheduling of queued jobs between clients
+echo
+echo "************************************ TEST 20 ***********************************"
+
+echo
+echo "*** Starting server, running 1 job at a time, sharing it fairly..."
+rm -f .smash.socket
+./bin/server -n 1 -s fair 1>/dev/null 2>/dev/null &
+SERVERPID=$!
+sleep 1
+
+echo
+echo "*** asdf submitting 3 jobs using a second of cpu each (timeout stops them)..."
+./bin/client -u asdf -c "submit 10 123123123 0 timeout 1 md5sum /dev/zero"
+./bin/client -u asdf -c "submit 10 123123123 0 timeout 1 md5sum /dev/zero"
+./bin/client -u asdf -c "submit 10 123123123 0 timeout 1 md5sum /dev/zero"
+echo
+echo "*** bob submitting 2 jobs using next to no cpu..."
+./bin/client -u bob -c "submit 10 123123123 0 sleep 1"
+./bin/client -u bob -c "submit 10 123123123 0 sleep 1"
+sleep 1.5
+
+echo
+echo "*** asdf used more cpu, so bob's jobs run ahead of asdf's queued ones..."
+echo "asdf:"
+./bin/client -u asdf -c "list"
+echo "bob:"
+./bin/client -u bob -c "list"
+sleep 1
+
+echo
+echo "asdf:"
+./bin/client -u asdf -c "list"
+echo "bob:"
+./bin/client -u bob -c "list"
+
+echo
+echo "*** Waiting..."
+sleep 3
+
+echo
+echo "*** Status listing of asdf's and bob's jobs..."
+echo "asdf:"
+./bin/client -u asdf -c "list"
+echo "bob:"
+./bin/client -u bob -c "list"
+
+echo
+echo "*** Shutting down server..."
+/bin/kill -INT $SERVERPID
+sleep 1
+
+echo
+echo "*** Starting server, running 1 job at a time, bob weighing 3 times as much..."
+rm -f .smash.socket
+./bin/server -n 1 -s fair -w bob=3 1>/dev/null 2>/dev/null &
+SERVERPID=$!
+sleep 1
+
+echo
+echo "*** asdf and bob each submitting 3 jobs using a second of cpu each..."
+./bin/client -u asdf -c "submit 10 123123123 0 timeout 1 md5sum /dev/zero"
+./bin/client -u asdf -c "submit 10 123123123 0 timeout 1 md5sum /dev/zero"
+./bin/client -u asdf -c "submit 10 123123123 0 timeout 1 md5sum /dev/zero"
+./bin/client -u bob -c "submit 10 123123123 0 timeout 1 md5sum /dev/zero"
+./bin/client -u bob -c "submit 10 123123123 0 timeout 1 md5sum /dev/zero"
+./bin/client -u bob -c "submit 10 123123123 0 timeout 1 md5sum /dev/zero"
+sleep 3.5
+
+echo
+echo "*** bob is owed 3 seconds of cpu for each of asdf's, so bob's jobs ran before asdf's next one..."
+echo "asdf:"
+./bin/client -u asdf -c "list"
+echo "bob:"
+./bin/client -u bob -c "list"
+
+echo
+echo "*** Waiting..."
+sleep 3
+
+echo
+echo "*** Status listing of asdf's and bob's jobs..."
+echo "asdf:"
+./bin/client -u asdf -c "list"
+echo "bob:"
+./bin/client -u bob -c "list"
+
+echo
+echo "*** Shutting down server..."
+/bin/kill -INT $SERVERPID
@@ -0,0 +1,80 @@
+#!/bin/sh
+#
+# Demonstrates the priority-ordered admission queue, with aging
+echo
+echo "************************************ TEST 21 ***********************************"
+
+echo
+echo "*** Starting server, running 1 job at a time, by priority..."
+rm -f .smash.socket
+./bin/server -n 1 -s priority 1>/dev/null 2>/dev/null &
+SERVERPID=$!
+sleep 1
+
+echo
+echo "*** Client submitting a job, then 3 more at priorities 15, 10 and 5..."
+./bin/client -u asdf -c "submit 10 123123123 0 sleep 1"
+./bin/client -u asdf -c "submit 10 123123123 15 sleep 1"
+./bin/client -u asdf -c "submit 10 123123123 10 sleep 1"
+./bin/client -u asdf -c "submit 10 123123123 5 sleep 1"
+
+echo
+echo "*** Client raising the priority of queued job 1 to 0..."
+./bin/client -u asdf -c "pri 1 0"
+sleep 1.5
+
+echo
+echo "*** Status listing of asdf's jobs, job 1 went first..."
+./bin/client -u asdf -c "list"
+sleep 1
+
+echo
+echo "*** Status listing of asdf's jobs, then the most urgent of the others..."
+./bin/client -u asdf -c "list"
+
+echo
+echo "*** Waiting..."
+sleep 2
+
+echo
+echo "*** Status listing of asdf's jobs..."
+./bin/client -u asdf -c "list"
+
+echo
+echo "*** Shutting down server..."
+/bin/kill -INT $SERVERPID
+sleep 1
+
+echo
+echo "*** Starting server, by priority, a queued job gaining a level every second..."
+rm -f .smash.socket
+./bin/server -n 1 -s priority -g 1 1>/dev/null 2>/dev/null &
+SERVERPID=$!
+sleep 1
+
+echo
+echo "*** Client submitting a job, then one at priority 15..."
+./bin/client -u asdf -c "submit 10 123123123 0 sleep 4"
+./bin/client -u asdf -c "submit 10 123123123 15 sleep 1"
+sleep 3
+
+echo
+echo "*** ...and 3 seconds later, one at priority 13..."
+./bin/client -u asdf -c "submit 10 123123123 13 sleep 1"
+sleep 1.5
+
+echo
+echo "*** Status listing of asdf's jobs, job 1 waited long enough to go first..."
+./bin/client -u asdf -c "list"
+
+echo
+echo "*** Waiting..."
+sleep 1.5
+
+echo
+echo "*** Status listing of asdf's jobs..."
+./bin/client -u asdf -c "list"
+
+echo
+echo "*** Shutting down server..."
+/bin/kill -INT $SERVERPID
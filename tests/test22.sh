@@ -0,0 +1,64 @@
+#!/bin/sh
+#
+# Demonstrates admitting jobs against memory and core budgets
+echo
+echo "************************************ TEST 22 ***********************************"
+
+echo
+echo "*** Starting server, with 4 cores and 400000000 bytes of memory to share..."
+rm -f .smash.socket
+./bin/server -c 4 -m 400000000 1>/dev/null 2>/dev/null &
+SERVERPID=$!
+sleep 1
+
+echo
+echo "*** Client submitting a job on 2 cores, then one needing all 4..."
+./bin/client -u asdf -c "submit cores=2 10 100000000 0 sleep 2"
+./bin/client -u asdf -c "submit cores=4 10 100000000 0 sleep 1"
+
+echo
+echo "*** Small jobs fill the gap left around the big one..."
+./bin/client -u asdf -c "submit 10 100000000 0 sleep 1"
+./bin/client -u asdf -c "submit 10 100000000 0 sleep 1"
+
+echo
+echo "*** ...as long as there is memory left for them..."
+./bin/client -u asdf -c "submit 10 300000000 0 sleep 1"
+
+echo
+echo "*** Jobs which would not fit even on an idle server are refused..."
+./bin/client -u asdf -c "submit cores=8 10 100000000 0 sleep 1"
+./bin/client -u asdf -c "submit 10 500000000 0 sleep 1"
+sleep 0.5
+
+echo
+echo "*** Status listing of asdf's jobs..."
+./bin/client -u asdf -c "list"
+
+echo
+echo "*** Waiting for the small jobs..."
+sleep 1
+
+echo
+echo "*** Status listing of asdf's jobs, job 4 took the memory they held..."
+./bin/client -u asdf -c "list"
+
+echo
+echo "*** Waiting for job 0..."
+sleep 1
+
+echo
+echo "*** Status listing of asdf's jobs, the big job got its turn..."
+./bin/client -u asdf -c "list"
+
+echo
+echo "*** Waiting..."
+sleep 1.5
+
+echo
+echo "*** Status listing of asdf's jobs..."
+./bin/client -u asdf -c "list"
+
+echo
+echo "*** Shutting down server..."
+/bin/kill -INT $SERVERPID
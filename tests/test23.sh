@@ -0,0 +1,54 @@
+#!/bin/sh
+#
+# Demonstrates pinning jobs to cpus of their own, and to a NUMA node
+echo
+echo "************************************ TEST 23 ***********************************"
+
+echo
+echo "*** Starting server, pinning each running job to cpus of its own..."
+rm -f .smash.socket
+./bin/server -A 1>/dev/null 2>/dev/null &
+SERVERPID=$!
+sleep 1
+
+echo
+echo "*** Client submitting a job, then one printing the cpus it may run on..."
+./bin/client -u asdf -c "submit 10 123123123 0 sleep 1"
+./bin/client -u asdf -c "submit 10 123123123 0 grep Cpus_allowed_list /proc/self/status"
+sleep 0.5
+
+echo
+echo "*** Status of job 0, with its cpus and the node they are on (node 0 on a"
+echo "*** machine without NUMA nodes)..."
+./bin/client -u asdf -c "status 0"
+
+echo
+echo "*** A job needing more cores than there are cpus is refused..."
+./bin/client -u asdf -c "submit cores=4096 10 123123123 0 sleep 1"
+sleep 1
+
+echo
+echo "*** Job 1 ran on other cpus than job 0, or after it if there were none..."
+./bin/client -u asdf -c "stdout 1"
+
+echo
+echo "*** Shutting down server..."
+/bin/kill -INT $SERVERPID
+sleep 1
+
+echo
+echo "*** Starting server, also binding the memory of jobs to their node..."
+rm -f .smash.socket
+./bin/server -N 1>/dev/null 2>/dev/null &
+SERVERPID=$!
+sleep 1
+
+echo
+echo "*** Client submitting a job printing the cpus and memory nodes it may use..."
+./bin/client -u asdf -c "submit 10 123123123 0 grep _allowed_list /proc/self/status"
+sleep 0.5
+./bin/client -u asdf -c "stdout 0"
+
+echo
+echo "*** Shutting down server..."
+/bin/kill -INT $SERVERPID
@@ -0,0 +1,31 @@
+#!/bin/sh
+#
+# Demonstrates the cgroup backend falling back to rlimits when it cannot be used
+echo
+echo "************************************ TEST 24 ***********************************"
+
+echo
+echo "*** Starting server, with cgroups under /tmp, which is not a cgroup v2 mount..."
+rm -f .smash.socket
+SERVERLOG=$(mktemp)
+./bin/server -G /tmp 1>$SERVERLOG 2>/dev/null &
+SERVERPID=$!
+sleep 1
+head -n 1 $SERVERLOG
+
+echo
+echo "*** Client submitting a job, and one running past its 1 second cpu limit..."
+./bin/client -u asdf -c "submit 10 123123123 0 echo hello"
+sleep 0.5
+./bin/client -u asdf -c "submit 1 123123123 0 md5sum /dev/zero"
+sleep 2
+
+echo
+echo "*** Status of both jobs, the second one stopped by RLIMIT_CPU..."
+./bin/client -u asdf -c "status 0"
+./bin/client -u asdf -c "status 1"
+
+echo
+echo "*** Shutting down server..."
+/bin/kill -INT $SERVERPID
+rm -f $SERVERLOG
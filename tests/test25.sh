@@ -0,0 +1,44 @@
+#!/bin/sh
+#
+# Demonstrates preemption of a running job whose priority was changed
+echo
+echo "************************************ TEST 25 ***********************************"
+
+echo
+echo "*** Starting server, running 2 jobs at a time, with preemption..."
+rm -f .smash.socket
+./bin/server -n 2 -P 1>/dev/null 2>/dev/null &
+SERVERPID=$!
+sleep 1
+
+echo
+echo "*** Client submitting a job at priority 5 and one at priority 10..."
+./bin/client -u asdf -c "submit 10 123123123 5 sleep 5"
+./bin/client -u asdf -c "submit 10 123123123 10 sleep 5"
+sleep 0.5
+
+echo
+echo "*** Changing priority of job 0 from 5 to 15..."
+./bin/client -u asdf -c "pri 0 15"
+./bin/client -u asdf -c "status 0"
+
+echo
+echo "*** Client submitting an urgent job..."
+./bin/client -u asdf -c "submit 10 123123123 0 sleep 1"
+sleep 0.5
+
+echo
+echo "*** Status listing of asdf's jobs, job 0 is now the one suspended..."
+./bin/client -u asdf -c "list"
+
+echo
+echo "*** Waiting for the urgent job..."
+sleep 1.5
+
+echo
+echo "*** Status listing of asdf's jobs, job 0 was resumed..."
+./bin/client -u asdf -c "list"
+
+echo
+echo "*** Shutting down server..."
+/bin/kill -INT $SERVERPID
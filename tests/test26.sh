@@ -0,0 +1,60 @@
+#!/bin/sh
+#
+# Demonstrates finished jobs being expunged by the retention limits
+echo
+echo "************************************ TEST 26 ***********************************"
+
+echo
+echo "*** Starting server, keeping 3 finished jobs per client for 5 seconds..."
+rm -f .smash.socket
+./bin/server -k 3 -a 5 1>/dev/null 2>/dev/null &
+SERVERPID=$!
+sleep 1
+
+echo
+echo "*** Client submitting 6 jobs..."
+for i in 0 1 2 3 4 5; do
+    ./bin/client -u asdf -c "submit 10 123123123 0 echo $i"
+    sleep 0.2
+done
+sleep 2
+
+echo
+echo "*** Status listing of asdf's jobs, the 3 oldest were expunged..."
+./bin/client -u asdf -c "list"
+
+echo
+echo "*** Waiting past the maximum age..."
+sleep 5
+
+echo
+echo "*** Status listing of asdf's jobs, all of them were expunged..."
+./bin/client -u asdf -c "list"
+
+echo
+echo "*** Shutting down server..."
+/bin/kill -INT $SERVERPID
+sleep 1
+
+echo
+echo "*** Starting server, keeping at most 4000 bytes of job output..."
+rm -f .smash.socket
+./bin/server -b 4000 1>/dev/null 2>/dev/null &
+SERVERPID=$!
+sleep 1
+
+echo
+echo "*** Client submitting 4 jobs writing 1500 bytes each..."
+for i in 0 1 2 3; do
+    ./bin/client -u asdf -c "submit 10 123123123 0 head -c 1500 /dev/zero"
+    sleep 0.2
+done
+sleep 2
+
+echo
+echo "*** Status listing of asdf's jobs, the 2 oldest were expunged..."
+./bin/client -u asdf -c "list"
+
+echo
+echo "*** Shutting down server..."
+/bin/kill -INT $SERVERPID